@@ -1,8 +1,14 @@
 
-float4x4    gWorldViewProj  : WorldViewProjection;
+float4x4    gViewProj       : ViewProjection;
 float4x4    gWorldMatrix    : WORLD;
 float3      gCameraPosition : CAMERA;
 
+// Compact vertices: positions are unorm inside the mesh bounds, normals and tangents octahedral,
+// the tangent sign is stored in the position w
+bool        gCompactVertices : COMPACTVERTICES;
+float3      gPositionOffset  : POSITIONOFFSET;
+float3      gPositionScale   : POSITIONSCALE;
+
 Texture2D   gDiffuseMap     : DiffuseMap;
 Texture2D   gNormalMap      : NormalMap;
 Texture2D   gSpecularMap    : SpecularMap;
@@ -15,10 +21,14 @@ static const float  PI              = float(3.1415926f);
 
 struct VS_INPUT
 {
-    float3 Position : POSITION;
+    float4 Position : POSITION;
     float2 UV : TEXCOORD;
     float3 Normal : NORMAL;
-    float3 Tangent : TANGENT;
+    float4 Tangent : TANGENT;
+    float4 Instance0 : INSTANCE0;   // instance matrix rows
+    float4 Instance1 : INSTANCE1;
+    float4 Instance2 : INSTANCE2;
+    float4 Instance3 : INSTANCE3;
 };
 
 struct VS_OUTPUT
@@ -27,17 +37,40 @@ struct VS_OUTPUT
     float4 WorldPosition : WORLD;
     float2 UV : TEXCOORD;
     float3 Normal : NORMAL;
-    float3 Tangent : TANGENT;
+    float4 Tangent : TANGENT;   // w: bitangent sign
 };
 
+float3 OctDecode(float2 encoded)
+{
+    float3 normal = float3(encoded, 1.0f - abs(encoded.x) - abs(encoded.y));
+    float fold = saturate(-normal.z);
+    normal.xy += (normal.xy >= 0.0f) ? -fold : fold;
+    return normalize(normal);
+}
+
 VS_OUTPUT VS(VS_INPUT input)
 {
+    float3 position = input.Position.xyz;
+    float3 normal = input.Normal;
+    float3 tangent = input.Tangent.xyz;
+    float tangentSign = input.Tangent.w;
+    if (gCompactVertices)
+    {
+        position = gPositionOffset + position * gPositionScale;
+        normal = OctDecode(input.Normal.xy);
+        tangent = OctDecode(input.Tangent.xy);
+        tangentSign = input.Position.w * 2.0f - 1.0f;
+    }
+
+    // Instances move the mesh in world space, after its own world matrix
+    float4x4 world = mul(gWorldMatrix, float4x4(input.Instance0, input.Instance1, input.Instance2, input.Instance3));
+
     VS_OUTPUT output = (VS_OUTPUT) 0;
-    output.Position = mul(float4(input.Position, 1.0f), gWorldViewProj);
-    output.WorldPosition = mul(float4(input.Position, 1.0f), gWorldMatrix);
+    output.WorldPosition = mul(float4(position, 1.0f), world);
+    output.Position = mul(output.WorldPosition, gViewProj);
     output.UV = input.UV;
-    output.Normal = mul(normalize(input.Normal), (float3x3) gWorldMatrix);
-    output.Tangent = mul(normalize(input.Tangent), (float3x3) gWorldMatrix);
+    output.Normal = mul(normalize(normal), (float3x3) world);
+    output.Tangent = float4(mul(normalize(tangent), (float3x3) world), tangentSign);
     return output;
 }
 
@@ -83,9 +116,9 @@ float4 SampleTexture(VS_OUTPUT input, Texture2D textureToSample, SamplerState sa
 
 float4 PS_Point(VS_OUTPUT input) : SV_TARGET
 {
-    float3 binormal = normalize(cross(input.Normal, input.Tangent));
+    float3 binormal = normalize(cross(input.Normal, input.Tangent.xyz)) * input.Tangent.w;
     float3x3 tangentToWorldMatrix = float3x3(
-        normalize(input.Tangent),
+        normalize(input.Tangent.xyz),
         binormal,
         normalize(input.Normal)
     );
@@ -115,8 +148,8 @@ float4 PS_Point(VS_OUTPUT input) : SV_TARGET
 
 float4 PS_Linear(VS_OUTPUT input) : SV_TARGET
 {
-    float3 binormal = normalize(cross(input.Normal, input.Tangent));
-    float3x3 tangentToWorldMatrix = float3x3(normalize(input.Tangent),binormal,normalize(input.Normal));
+    float3 binormal = normalize(cross(input.Normal, input.Tangent.xyz)) * input.Tangent.w;
+    float3x3 tangentToWorldMatrix = float3x3(normalize(input.Tangent.xyz),binormal,normalize(input.Normal));
 	
     float3 normalMapColour = saturate(SampleTexture(input, gNormalMap, samLinear).rgb);
     float3 sampledNormal = 2.0f * normalMapColour - float3(1.0f, 1.0f, 1.0f);
@@ -141,8 +174,8 @@ float4 PS_Linear(VS_OUTPUT input) : SV_TARGET
 
 float4 PS_Anisotropic(VS_OUTPUT input) : SV_TARGET
 {
-    float3 binormal = normalize(cross(input.Normal, input.Tangent));
-    float3x3 tangentToWorldMatrix = float3x3(normalize(input.Tangent),binormal,normalize(input.Normal));
+    float3 binormal = normalize(cross(input.Normal, input.Tangent.xyz)) * input.Tangent.w;
+    float3x3 tangentToWorldMatrix = float3x3(normalize(input.Tangent.xyz),binormal,normalize(input.Normal));
 	
     float3 normalMapColour = saturate(SampleTexture(input, gNormalMap, samAnisotropic).rgb);
     float3 sampledNormal = 2.0f * normalMapColour - float3(1.0f, 1.0f, 1.0f);
@@ -4,6 +4,10 @@ struct VS_INPUT
     float2 UV : TEXCOORD;
     float3 Normal : NORMAL;
     float3 Tangent : TANGENT;
+    float4 Instance0 : INSTANCE0;   // instance matrix rows
+    float4 Instance1 : INSTANCE1;
+    float4 Instance2 : INSTANCE2;
+    float4 Instance3 : INSTANCE3;
 };
 
 struct VS_OUTPUT
@@ -14,9 +18,15 @@ struct VS_OUTPUT
     float3 Tangent : TANGENT;
 };
 
-float4x4 gWorldViewProj : WorldViewProjection;
+float4x4 gViewProj : ViewProjection;
+float4x4 gWorldMatrix : WORLD;
 Texture2D gDiffuseMap : DiffuseMap;
 
+// Compact vertices: positions are unorm inside the mesh bounds, normals and tangents octahedral
+bool        gCompactVertices : COMPACTVERTICES;
+float3      gPositionOffset  : POSITIONOFFSET;
+float3      gPositionScale   : POSITIONSCALE;
+
 RasterizerState gRasterizerState
 {
     Cullmode = none;
@@ -65,13 +75,34 @@ SamplerState samAnisotropic
     AddressV = Wrap;
 };
 
+float3 OctDecode(float2 encoded)
+{
+    float3 normal = float3(encoded, 1.0f - abs(encoded.x) - abs(encoded.y));
+    float fold = saturate(-normal.z);
+    normal.xy += (normal.xy >= 0.0f) ? -fold : fold;
+    return normalize(normal);
+}
+
 VS_OUTPUT VS(VS_INPUT input)
 {
+    float3 position = input.Position;
+    float3 normal = input.Normal;
+    float3 tangent = input.Tangent;
+    if (gCompactVertices)
+    {
+        position = gPositionOffset + position * gPositionScale;
+        normal = OctDecode(input.Normal.xy);
+        tangent = OctDecode(input.Tangent.xy);
+    }
+
+    // Instances move the mesh in world space, after its own world matrix
+    float4x4 world = mul(gWorldMatrix, float4x4(input.Instance0, input.Instance1, input.Instance2, input.Instance3));
+
     VS_OUTPUT output = (VS_OUTPUT) 0;
-    output.Position = mul(float4(input.Position, 1.0f), gWorldViewProj);
+    output.Position = mul(mul(float4(position, 1.0f), world), gViewProj);
     output.UV = input.UV;
-    output.Normal = normalize(input.Normal);
-    output.Tangent = normalize(input.Tangent);
+    output.Normal = normalize(normal);
+    output.Tangent = normalize(tangent);
     return output;
 }
 
@@ -0,0 +1,270 @@
+#include "AssetFormat.h"
+#include <filesystem>
+#include <fstream>
+#include <cstring>
+#include <algorithm>
+#include <SDL.h>
+#include <SDL_image.h>
+
+namespace dae
+{
+	namespace
+	{
+		struct FileHeader
+		{
+			char magic[4]{};
+			uint32_t version{};
+			uint32_t counts[3]{};
+			uint64_t sourceTime{};
+		};
+
+		// A source time of 0 has nothing to compare against
+		bool IsCurrentHeader(const FileHeader& header, uint64_t sourceTime)
+		{
+			return header.version == AssetFormat::Version && (sourceTime == 0 || header.sourceTime == sourceTime);
+		}
+
+		bool ReadHeader(std::ifstream& file, const char* magic, uint64_t sourceTime, FileHeader& header)
+		{
+			file.read(reinterpret_cast<char*>(&header), sizeof(FileHeader));
+			return file && std::memcmp(header.magic, magic, 4) == 0 && IsCurrentHeader(header, sourceTime);
+		}
+
+		template<typename T>
+		bool ReadArray(std::ifstream& file, std::vector<T>& values, uint32_t count)
+		{
+			values.resize(count);
+			file.read(reinterpret_cast<char*>(values.data()), static_cast<std::streamsize>(sizeof(T) * count));
+			return static_cast<bool>(file);
+		}
+
+		template<typename T>
+		void WriteArray(std::ofstream& file, const std::vector<T>& values)
+		{
+			file.write(reinterpret_cast<const char*>(values.data()), static_cast<std::streamsize>(sizeof(T) * values.size()));
+		}
+
+		// Length prefixed, no terminator
+		bool ReadString(std::ifstream& file, std::string& value)
+		{
+			uint32_t length{};
+			file.read(reinterpret_cast<char*>(&length), sizeof(uint32_t));
+			value.resize(file ? length : 0);
+			file.read(value.data(), static_cast<std::streamsize>(value.size()));
+			return static_cast<bool>(file);
+		}
+
+		void WriteString(std::ofstream& file, const std::string& value)
+		{
+			const uint32_t length{ static_cast<uint32_t>(value.size()) };
+			file.write(reinterpret_cast<const char*>(&length), sizeof(uint32_t));
+			file.write(value.data(), static_cast<std::streamsize>(value.size()));
+		}
+	}
+
+	std::string AssetFormat::GetCookedPath(const std::string& sourcePath)
+	{
+		const std::filesystem::path source{ sourcePath };
+		const std::string extension{ source.extension() == ".obj" ? ".mesh" : ".tex" };
+		return (source.parent_path() / "cooked" / (source.filename().string() + extension)).string();
+	}
+
+	std::string AssetFormat::GetClusteredPath(const std::string& sourcePath)
+	{
+		const std::filesystem::path source{ sourcePath };
+		return (source.parent_path() / "cooked" / (source.filename().string() + ".clusters")).string();
+	}
+
+	std::string AssetFormat::GetObjectNormalMapPath(const std::string& sourcePath, const std::string& materialName)
+	{
+		const std::filesystem::path source{ sourcePath };
+		return (source.parent_path() / (source.filename().string() + "." + materialName + ".objectnormal")).string();
+	}
+
+	uint64_t AssetFormat::GetSourceTime(const std::string& sourcePath)
+	{
+		std::error_code error{};
+		const std::filesystem::file_time_type time{ std::filesystem::last_write_time(sourcePath, error) };
+		return error ? 0 : static_cast<uint64_t>(time.time_since_epoch().count());
+	}
+
+	bool AssetFormat::IsCurrent(const std::string& path, uint64_t sourceTime)
+	{
+		std::ifstream file{ path, std::ios::binary };
+		FileHeader header{};
+		file.read(reinterpret_cast<char*>(&header), sizeof(FileHeader));
+		return file && IsCurrentHeader(header, sourceTime);
+	}
+
+	bool AssetFormat::ReadMesh(const std::string& path, uint64_t sourceTime, MeshAsset& mesh)
+	{
+		std::ifstream file{ path, std::ios::binary };
+		FileHeader header{};
+		if (!file || !ReadHeader(file, "MESH", sourceTime, header))
+			return false;
+
+		if (!ReadArray(file, mesh.vertices, header.counts[0])
+			|| !ReadArray(file, mesh.indices, header.counts[1])
+			|| !ReadArray(file, mesh.lods, header.counts[2]))
+			return false;
+
+		// Materials, then every submesh as its material index followed by one range per LOD
+		uint32_t counts[2]{};
+		file.read(reinterpret_cast<char*>(counts), sizeof(counts));
+		mesh.materials.resize(file ? counts[0] : 0);
+		for (MaterialDesc& material : mesh.materials)
+		{
+			ReadString(file, material.name);
+			ReadString(file, material.diffuseMap);
+			ReadString(file, material.normalMap);
+			ReadString(file, material.specularMap);
+			ReadString(file, material.glossinessMap);
+			ReadString(file, material.objectNormalMap);
+		}
+
+		mesh.subMeshes.resize(file ? counts[1] : 0);
+		for (SubMesh& subMesh : mesh.subMeshes)
+		{
+			file.read(reinterpret_cast<char*>(&subMesh.material), sizeof(uint32_t));
+			ReadArray(file, subMesh.lods, header.counts[2]);
+		}
+		return static_cast<bool>(file);
+	}
+
+	bool AssetFormat::WriteMesh(const std::string& path, uint64_t sourceTime, const MeshAsset& mesh)
+	{
+		std::ofstream file{ path, std::ios::binary | std::ios::trunc };
+		if (!file)
+			return false;
+
+		FileHeader header{ { 'M', 'E', 'S', 'H' }, Version,
+			{ static_cast<uint32_t>(mesh.vertices.size()), static_cast<uint32_t>(mesh.indices.size()), static_cast<uint32_t>(mesh.lods.size()) }, sourceTime };
+		file.write(reinterpret_cast<const char*>(&header), sizeof(FileHeader));
+		WriteArray(file, mesh.vertices);
+		WriteArray(file, mesh.indices);
+		WriteArray(file, mesh.lods);
+
+		const uint32_t counts[2]{ static_cast<uint32_t>(mesh.materials.size()), static_cast<uint32_t>(mesh.subMeshes.size()) };
+		file.write(reinterpret_cast<const char*>(counts), sizeof(counts));
+		for (const MaterialDesc& material : mesh.materials)
+		{
+			WriteString(file, material.name);
+			WriteString(file, material.diffuseMap);
+			WriteString(file, material.normalMap);
+			WriteString(file, material.specularMap);
+			WriteString(file, material.glossinessMap);
+			WriteString(file, material.objectNormalMap);
+		}
+
+		for (const SubMesh& subMesh : mesh.subMeshes)
+		{
+			file.write(reinterpret_cast<const char*>(&subMesh.material), sizeof(uint32_t));
+			WriteArray(file, subMesh.lods);
+		}
+		return static_cast<bool>(file);
+	}
+
+	bool AssetFormat::WriteClusters(const std::string& path, uint64_t sourceTime, const std::vector<ClusterData>& clusters)
+	{
+		std::ofstream file{ path, std::ios::binary | std::ios::trunc };
+		if (!file)
+			return false;
+
+		// Each data block starts 4 byte aligned, odd index counts get padded
+		std::vector<ClusterInfo> table{};
+		uint64_t offset{ sizeof(FileHeader) + sizeof(ClusterInfo) * clusters.size() };
+		for (const ClusterData& cluster : clusters)
+		{
+			ClusterInfo info{ cluster.info };
+			info.vertexCount = static_cast<uint32_t>(cluster.vertices.size());
+			info.indexCount = static_cast<uint32_t>(cluster.indices.size());
+			info.dataOffset = offset;
+			table.push_back(info);
+
+			offset += sizeof(Vertex_In) * cluster.vertices.size() + sizeof(uint16_t) * ((cluster.indices.size() + 1) & ~size_t{ 1 });
+		}
+
+		FileHeader header{ { 'C', 'L', 'S', 'T' }, Version, { static_cast<uint32_t>(table.size()), 0, 0 }, sourceTime };
+		file.write(reinterpret_cast<const char*>(&header), sizeof(FileHeader));
+		WriteArray(file, table);
+		for (const ClusterData& cluster : clusters)
+		{
+			WriteArray(file, cluster.vertices);
+			WriteArray(file, cluster.indices);
+			if (cluster.indices.size() % 2 != 0)
+			{
+				const uint16_t padding{ 0 };
+				file.write(reinterpret_cast<const char*>(&padding), sizeof(uint16_t));
+			}
+		}
+		return static_cast<bool>(file);
+	}
+
+	bool AssetFormat::ReadClusterTable(const std::string& path, uint64_t sourceTime, std::vector<ClusterInfo>& clusters)
+	{
+		std::ifstream file{ path, std::ios::binary };
+		FileHeader header{};
+		if (!file || !ReadHeader(file, "CLST", sourceTime, header))
+			return false;
+
+		return ReadArray(file, clusters, header.counts[0]);
+	}
+
+	bool AssetFormat::ReadTexture(const std::string& path, uint64_t sourceTime, TextureData& texture)
+	{
+		std::ifstream file{ path, std::ios::binary };
+		FileHeader header{};
+		if (!file || !ReadHeader(file, "TEX ", sourceTime, header))
+			return false;
+
+		texture.width = header.counts[0];
+		texture.height = header.counts[1];
+		texture.mipCount = header.counts[2];
+
+		uint32_t texelCount{ 0 };
+		for (uint32_t mip{ 0 }; mip < texture.mipCount; ++mip)
+		{
+			texelCount += std::max(texture.width >> mip, 1u) * std::max(texture.height >> mip, 1u);
+		}
+		return ReadArray(file, texture.texels, texelCount);
+	}
+
+	bool AssetFormat::WriteTexture(const std::string& path, uint64_t sourceTime, const TextureData& texture)
+	{
+		std::ofstream file{ path, std::ios::binary | std::ios::trunc };
+		if (!file)
+			return false;
+
+		FileHeader header{ { 'T', 'E', 'X', ' ' }, Version, { texture.width, texture.height, texture.mipCount }, sourceTime };
+		file.write(reinterpret_cast<const char*>(&header), sizeof(FileHeader));
+		WriteArray(file, texture.texels);
+		return static_cast<bool>(file);
+	}
+
+	bool AssetFormat::DecodeImage(const std::string& path, TextureData& texture)
+	{
+		SDL_Surface* pLoaded{ IMG_Load(path.c_str()) };
+		if (pLoaded == nullptr)
+			return false;
+
+		// Whatever the png stored (rgb, palette, ...), the texel layout is always RGBA8
+		SDL_Surface* pSurface{ SDL_ConvertSurfaceFormat(pLoaded, SDL_PIXELFORMAT_RGBA32, 0) };
+		SDL_FreeSurface(pLoaded);
+		if (pSurface == nullptr)
+			return false;
+
+		texture.width = static_cast<uint32_t>(pSurface->w);
+		texture.height = static_cast<uint32_t>(pSurface->h);
+		texture.mipCount = 1;
+		texture.texels.resize(static_cast<size_t>(texture.width) * texture.height);
+
+		for (uint32_t y{ 0 }; y < texture.height; ++y)
+		{
+			const uint8_t* pRow{ static_cast<const uint8_t*>(pSurface->pixels) + static_cast<size_t>(y) * pSurface->pitch };
+			std::memcpy(&texture.texels[static_cast<size_t>(y) * texture.width], pRow, sizeof(uint32_t) * texture.width);
+		}
+
+		SDL_FreeSurface(pSurface);
+		return true;
+	}
+}
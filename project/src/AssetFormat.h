@@ -0,0 +1,95 @@
+#pragma once
+#include <string>
+#include <vector>
+#include <cstdint>
+#include "DataTypes.h"
+#include "MeshSimplifier.h"
+
+namespace dae
+{
+	// Texture references of one MTL material, paths are relative to the working directory
+	// and left empty for maps the material does not have
+	struct MaterialDesc
+	{
+		std::string name{};
+		std::string diffuseMap{};
+		std::string normalMap{};
+		std::string specularMap{};
+		std::string glossinessMap{};
+		std::string objectNormalMap{};	// only baked by the AssetCooker, see NormalMapBaker
+	};
+
+	// CPU side mesh data, ready to be uploaded
+	struct MeshAsset
+	{
+		std::vector<Vertex_In> vertices{};
+		std::vector<uint32_t> indices{};
+		std::vector<MeshLod> lods{};
+		std::vector<MaterialDesc> materials{};
+		std::vector<SubMesh> subMeshes{};	// material ranges inside every LOD, sorted by material
+	};
+
+	// RGBA8 texels, mip levels stored back to back starting with the full size level
+	struct TextureData
+	{
+		uint32_t width{};
+		uint32_t height{};
+		uint32_t mipCount{};
+		std::vector<uint32_t> texels{};
+	};
+
+	// Spatial chunk of one LOD level inside a ".clusters" file, indices are local to the cluster
+	struct ClusterInfo
+	{
+		BoundingBox bounds{};
+		BoundingSphere sphere{};
+		float geometricError{};
+		uint32_t lod{};
+		uint32_t material{};
+		uint32_t vertexCount{};
+		uint32_t indexCount{};
+		uint64_t dataOffset{};		// Vertex_In[vertexCount] followed by uint16_t[indexCount]
+	};
+
+	struct ClusterData
+	{
+		ClusterInfo info{};
+		std::vector<Vertex_In> vertices{};
+		std::vector<uint16_t> indices{};
+	};
+
+	// Binary formats written by the AssetCooker tool and read by the runtime.
+	// Only depends on SDL_image, so both can share it.
+	namespace AssetFormat
+	{
+		// Bump whenever Vertex_In or one of the layouts below changes, forces a full re-cook
+		inline constexpr uint32_t Version{ 6 };
+
+		// "resources/vehicle.obj" -> "resources/cooked/vehicle.obj.mesh"
+		std::string GetCookedPath(const std::string& sourcePath);
+		// "resources/vehicle.obj" -> "resources/cooked/vehicle.obj.clusters"
+		std::string GetClusteredPath(const std::string& sourcePath);
+		// "resources/vehicle.obj", "vehicle" -> "resources/vehicle.obj.vehicle.objectnormal", a texture that only exists cooked
+		std::string GetObjectNormalMapPath(const std::string& sourcePath, const std::string& materialName);
+
+		// Last write time of the source, 0 when there is none (shipped cooked only, or baked by the cooker).
+		// Every cooked file stores the time of the source it was cooked from, the readers reject the file
+		// when the source changed since, so a stale cook is never loaded.
+		uint64_t GetSourceTime(const std::string& sourcePath);
+		// Header only, the same version and source time check the readers below start with
+		bool IsCurrent(const std::string& path, uint64_t sourceTime);
+
+		bool ReadMesh(const std::string& path, uint64_t sourceTime, MeshAsset& mesh);
+		bool WriteMesh(const std::string& path, uint64_t sourceTime, const MeshAsset& mesh);
+
+		// Header and cluster table up front, cluster data is meant to be mapped in on demand
+		bool WriteClusters(const std::string& path, uint64_t sourceTime, const std::vector<ClusterData>& clusters);
+		bool ReadClusterTable(const std::string& path, uint64_t sourceTime, std::vector<ClusterInfo>& clusters);
+
+		bool ReadTexture(const std::string& path, uint64_t sourceTime, TextureData& texture);
+		bool WriteTexture(const std::string& path, uint64_t sourceTime, const TextureData& texture);
+
+		// Decodes any image SDL_image understands into a single RGBA8 level
+		bool DecodeImage(const std::string& path, TextureData& texture);
+	}
+}
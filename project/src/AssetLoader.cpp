@@ -0,0 +1,225 @@
+#include "pch.h"
+#include "AssetLoader.h"
+#include "Utils.h"
+#include "TangentSpace.h"
+#include "Effect.h"
+#include <filesystem>
+
+namespace dae
+{
+	AssetLoader::AssetLoader() :
+		m_StartTime{ Clock::now() }
+	{
+		// Initialize the png decoder once, before the workers start using it
+		IMG_Init(IMG_INIT_PNG);
+	}
+
+	MeshRequest AssetLoader::LoadMesh(const std::string& path)
+	{
+		std::promise<BoundingBox> boundsPromise{};
+		std::promise<std::vector<MaterialDesc>> materialsPromise{};
+		MeshRequest request{};
+		request.bounds = boundsPromise.get_future().share();
+		request.materials = materialsPromise.get_future().share();
+
+		request.asset = std::async(std::launch::async, [this, path, bounds = std::move(boundsPromise), materials = std::move(materialsPromise)]() mutable
+			{
+				// Waiters on bounds or materials get the loader's exception, not a broken promise
+				bool isMaterialsSet{ false };
+				bool isBoundsSet{ false };
+				try
+				{
+					const Clock::time_point start{ Clock::now() };
+
+					// Cooked meshes are already welded, sorted by material and carry their LODs
+					const std::string cookedPath{ AssetFormat::GetCookedPath(path) };
+					MeshAsset asset{};
+					std::vector<uint32_t> vertexMaterials{};
+					const bool isCooked{ AssetFormat::ReadMesh(cookedPath, AssetFormat::GetSourceTime(path), asset) };
+					if (!isCooked && std::filesystem::exists(cookedPath))
+					{
+						std::cout << cookedPath << " is out of date, loading " << path << " instead (run the AssetCooker)" << std::endl;
+					}
+					if (!isCooked && !Utils::ParseOBJ(path, asset.vertices, asset.indices, vertexMaterials, asset.materials))
+					{
+						std::cout << "Failed to parse " << path << std::endl;
+					}
+
+					// Lets the caller start decoding textures while welding and LOD generation run
+					materials.set_value(asset.materials);
+					isMaterialsSet = true;
+
+					BoundingBox box{};
+					if (!asset.vertices.empty())
+					{
+						box = BoundingBox{ asset.vertices[0].position, asset.vertices[0].position };
+						for (const Vertex_In& vertex : asset.vertices)
+						{
+							box.Grow(vertex.position);
+						}
+					}
+					bounds.set_value(box);
+					isBoundsSet = true;
+
+					if (!isCooked)
+					{
+						MeshSimplifier::WeldVertices(asset.vertices, asset.indices, vertexMaterials);
+						for (const uint32_t source : TangentSpace::Generate(asset.vertices, asset.indices))
+						{
+							vertexMaterials.push_back(vertexMaterials[source]);
+						}
+						asset.lods = MeshSimplifier::BuildLods(asset.vertices, asset.indices);
+						asset.subMeshes = MeshSimplifier::SortByMaterial(vertexMaterials, static_cast<uint32_t>(asset.materials.size()), asset.indices, asset.lods);
+					}
+
+					RecordJob(isCooked ? cookedPath : path, start);
+					return asset;
+				}
+				catch (...)
+				{
+					if (!isMaterialsSet) materials.set_exception(std::current_exception());
+					if (!isBoundsSet) bounds.set_exception(std::current_exception());
+					throw;
+				}
+			});
+
+		return request;
+	}
+
+	std::shared_future<TextureData> AssetLoader::DecodeTexture(const std::string& path)
+	{
+		std::lock_guard lock{ m_TextureMutex };
+		if (const auto request{ m_TextureRequests.find(path) }; request != m_TextureRequests.end())
+			return request->second;
+
+		return m_TextureRequests[path] = std::async(std::launch::async, [this, path]()
+			{
+				const Clock::time_point start{ Clock::now() };
+
+				// Cooked textures come with their mip chain, sources only have the top level
+				const std::string cookedPath{ AssetFormat::GetCookedPath(path) };
+				TextureData texture{};
+				const bool isCooked{ AssetFormat::ReadTexture(cookedPath, AssetFormat::GetSourceTime(path), texture) };
+				if (!isCooked && std::filesystem::exists(cookedPath))
+				{
+					std::cout << cookedPath << " is out of date, loading " << path << " instead (run the AssetCooker)" << std::endl;
+				}
+				if (!isCooked && !AssetFormat::DecodeImage(path, texture))
+				{
+					std::cout << "Failed to decode " << path << std::endl;
+				}
+
+				RecordJob(isCooked ? cookedPath : path, start);
+				return texture;
+			}).share();
+	}
+
+	void AssetLoader::ClearTextureRequests()
+	{
+		std::lock_guard lock{ m_TextureMutex };
+		m_TextureRequests.clear();
+	}
+
+	std::shared_future<ID3DBlob*> AssetLoader::CompileEffect(const std::wstring& path)
+	{
+		return std::async(std::launch::async, [this, path]()
+			{
+				const Clock::time_point start{ Clock::now() };
+
+				ID3DBlob* pBlob{ Effect::CompileEffect(path) };
+
+				RecordJob(std::string(path.begin(), path.end()), start);
+				return pBlob;
+			}).share();
+	}
+
+	void AssetLoader::PrintTimings() const
+	{
+		const float totalMs{ std::chrono::duration<float, std::milli>(Clock::now() - m_StartTime).count() };
+
+		std::lock_guard lock{ m_TimingMutex };
+
+		HANDLE hConsole = GetStdHandle(STD_OUTPUT_HANDLE);
+		SetConsoleTextAttribute(hConsole, 3);
+		std::cout << "[Asset loading]" << std::endl;
+		for (const auto& [name, ms] : m_JobTimings)
+		{
+			std::cout << "  " << name << ": " << ms << " ms" << std::endl;
+		}
+		std::cout << "  All assets resident after " << totalMs << " ms" << std::endl;
+		std::cout << std::endl;
+		SetConsoleTextAttribute(hConsole, 15);
+	}
+
+	MeshAsset AssetLoader::CreateProxy(const BoundingBox& bounds)
+	{
+		const Vector3 center{ (bounds.min + bounds.max) * 0.5f };
+		const Vector3 extent{ (bounds.max - bounds.min) * 0.5f };
+		const Vector3 axes[3]{ Vector3::UnitX, Vector3::UnitY, Vector3::UnitZ };
+
+		MeshAsset proxy{};
+		for (int axis{ 0 }; axis < 3; ++axis)
+		{
+			for (const float side : { -1.f, 1.f })
+			{
+				// b = t x n keeps every face clockwise seen from outside
+				const Vector3 normal{ axes[axis] * side };
+				const Vector3 tangent{ axes[(axis + 1) % 3] };
+				const Vector3 bitangent{ Vector3::Cross(tangent, normal) };
+
+				const uint32_t first{ static_cast<uint32_t>(proxy.vertices.size()) };
+				const Vector2 corners[4]{ { -1.f, -1.f }, { -1.f, 1.f }, { 1.f, 1.f }, { 1.f, -1.f } };
+				for (const Vector2& corner : corners)
+				{
+					const Vector3 offset{ normal + tangent * corner.x + bitangent * corner.y };
+
+					Vertex_In vertex{};
+					vertex.position = center + Vector3{ offset.x * extent.x, offset.y * extent.y, offset.z * extent.z };
+					vertex.uv = { (corner.x + 1.f) * 0.5f, (1.f - corner.y) * 0.5f };
+					vertex.normal = normal;
+					vertex.tangent = tangent;
+					proxy.vertices.push_back(vertex);
+				}
+
+				proxy.indices.insert(proxy.indices.end(), { first, first + 1, first + 2, first, first + 2, first + 3 });
+			}
+		}
+
+		return proxy;
+	}
+
+	Material AssetLoader::CreatePlaceholders(ID3D11Device* pDevice, TextureCache& textures)
+	{
+		// Keys no source path can collide with
+		Material placeholders{};
+		placeholders.pDiffuseMap = (textures["<placeholder diffuse>"] = Texture::CreateSolid(128, 128, 128, pDevice)).get();
+		placeholders.pNormalMap = (textures["<placeholder normal>"] = Texture::CreateSolid(128, 128, 255, pDevice)).get();
+		placeholders.pSpecularMap = (textures["<placeholder specular>"] = Texture::CreateSolid(0, 0, 0, pDevice)).get();
+		placeholders.pGlossinessMap = (textures["<placeholder glossiness>"] = Texture::CreateSolid(0, 0, 0, pDevice)).get();
+		return placeholders;
+	}
+
+	Material AssetLoader::ResolveMaterial(const MaterialDesc& desc, const TextureCache& textures, const Material& fallback)
+	{
+		const auto find = [&textures](const std::string& path, const Texture* pFallback) -> const Texture*
+			{
+				const auto texture{ textures.find(path) };
+				return texture != textures.end() && texture->second ? texture->second.get() : pFallback;
+			};
+
+		return Material{
+			find(desc.diffuseMap, fallback.pDiffuseMap),
+			find(desc.normalMap, fallback.pNormalMap),
+			find(desc.specularMap, fallback.pSpecularMap),
+			find(desc.glossinessMap, fallback.pGlossinessMap),
+			find(desc.objectNormalMap, fallback.pObjectNormalMap) };
+	}
+
+	void AssetLoader::RecordJob(const std::string& name, Clock::time_point start)
+	{
+		const float ms{ std::chrono::duration<float, std::milli>(Clock::now() - start).count() };
+
+		std::lock_guard lock{ m_TimingMutex };
+		m_JobTimings.emplace_back(name, ms);
+	}
+}
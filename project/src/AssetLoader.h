@@ -0,0 +1,79 @@
+#pragma once
+#include <future>
+#include <mutex>
+#include <string>
+#include <vector>
+#include <unordered_map>
+#include <chrono>
+#include <d3d11.h>
+#include <d3dcompiler.h>
+#include "DataTypes.h"
+#include "MeshSimplifier.h"
+#include "AssetFormat.h"
+#include "Texture.h"
+
+namespace dae
+{
+	struct MeshRequest
+	{
+		// Published as soon as the OBJ is parsed, well before welding and LOD generation are done
+		std::shared_future<BoundingBox> bounds{};
+		std::shared_future<std::vector<MaterialDesc>> materials{};
+		// Not shared, so the one consumer can move the arrays out instead of copying them
+		std::future<MeshAsset> asset{};
+	};
+
+	// Device textures by source path, shared by every material referencing the same file
+	using TextureCache = std::unordered_map<std::string, std::unique_ptr<Texture>>;
+
+	// Runs mesh parsing, png decoding and effect compilation on worker threads.
+	// Outputs of the AssetCooker tool are used instead of the sources when present.
+	// Uploading the results to the device is left to the caller (one thread),
+	// which polls the futures with IsReady so it never blocks a frame.
+	class AssetLoader final
+	{
+	public:
+		AssetLoader();
+		~AssetLoader() = default;
+
+		AssetLoader(const AssetLoader&) = delete;
+		AssetLoader(AssetLoader&&) noexcept = delete;
+		AssetLoader& operator=(const AssetLoader&) = delete;
+		AssetLoader& operator=(AssetLoader&&) noexcept = delete;
+
+		MeshRequest LoadMesh(const std::string& path);
+		// Requests for a path that is already decoding (or decoded) share the same job
+		std::shared_future<TextureData> DecodeTexture(const std::string& path);
+		// Drops the decoded texels held for sharing, once every request got uploaded
+		void ClearTextureRequests();
+		std::shared_future<ID3DBlob*> CompileEffect(const std::wstring& path);
+
+		void PrintTimings() const;
+
+		template<typename Future>
+		static bool IsReady(const Future& future)
+		{
+			return future.valid() && future.wait_for(std::chrono::seconds(0)) == std::future_status::ready;
+		}
+
+		// Stand-ins drawn until the real asset arrives, the placeholder maps are added to the cache
+		static MeshAsset CreateProxy(const BoundingBox& bounds);
+		static Material CreatePlaceholders(ID3D11Device* pDevice, TextureCache& textures);
+
+		// Maps the material uses that are not in the cache (yet) come from the fallback
+		static Material ResolveMaterial(const MaterialDesc& desc, const TextureCache& textures, const Material& fallback);
+
+	private:
+		using Clock = std::chrono::steady_clock;
+
+		void RecordJob(const std::string& name, Clock::time_point start);
+
+		Clock::time_point m_StartTime{};
+
+		std::mutex m_TextureMutex{};
+		std::unordered_map<std::string, std::shared_future<TextureData>> m_TextureRequests{};
+
+		mutable std::mutex m_TimingMutex{};
+		std::vector<std::pair<std::string, float>> m_JobTimings{};
+	};
+}
@@ -0,0 +1,202 @@
+#include "pch.h"
+#include "ClusteredMesh.h"
+#include "Camera.h"
+
+namespace dae
+{
+	ClusteredMesh::ClusteredMesh(const std::string& path, uint64_t sourceTime, size_t memoryBudget) :
+		m_MemoryBudget{ memoryBudget }
+	{
+		if (!AssetFormat::ReadClusterTable(path, sourceTime, m_Clusters) || m_Clusters.empty())
+			return;
+
+		const HANDLE file{ CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr) };
+		if (file == INVALID_HANDLE_VALUE)
+			return;
+
+		m_File = file;
+		m_Mapping = CreateFileMappingA(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+		if (m_Mapping == nullptr)
+			return;
+
+		// Views have to start on an allocation granularity boundary
+		SYSTEM_INFO systemInfo{};
+		GetSystemInfo(&systemInfo);
+		m_AllocationGranularity = systemInfo.dwAllocationGranularity;
+
+		m_States.resize(m_Clusters.size());
+
+		// LOD0 clusters cover the whole mesh, their union gives the sphere used for LOD selection
+		BoundingBox bounds{ m_Clusters[0].bounds };
+		for (const ClusterInfo& cluster : m_Clusters)
+		{
+			if (cluster.lod == 0)
+			{
+				bounds.Grow(cluster.bounds.min);
+				bounds.Grow(cluster.bounds.max);
+			}
+
+			if (cluster.lod >= m_LodErrors.size())
+			{
+				m_LodErrors.resize(cluster.lod + 1, 0.f);
+			}
+			m_LodErrors[cluster.lod] = cluster.geometricError;
+		}
+
+		m_LocalSphere.center = (bounds.min + bounds.max) * 0.5f;
+		m_LocalSphere.radius = (bounds.max - bounds.min).Magnitude() * 0.5f;
+	}
+
+	ClusteredMesh::~ClusteredMesh()
+	{
+		for (uint32_t cluster{ 0 }; cluster < m_States.size(); ++cluster)
+		{
+			UnmapCluster(cluster);
+		}
+
+		if (m_Mapping) CloseHandle(m_Mapping);
+		if (m_File) CloseHandle(m_File);
+	}
+
+	bool ClusteredMesh::IsOpen() const
+	{
+		return m_Mapping != nullptr;
+	}
+
+	void ClusteredMesh::GatherClusters(const Frustum& frustum, const Camera& camera, const Matrix& worldMatrix, float screenHeight, std::vector<ResidentCluster>& clusters, const OcclusionBuffer* pOcclusion)
+	{
+		clusters.clear();
+		if (!IsOpen())
+			return;
+
+		++m_Frame;
+		m_Stats.visibleClusters = 0;
+		m_Stats.pagedIn = 0;
+		m_Stats.evicted = 0;
+		m_Stats.skipped = 0;
+		m_Stats.occluded = 0;
+
+		float maxScale{ 0.f };
+		for (int axis{ 0 }; axis < 3; ++axis)
+		{
+			maxScale = std::max(maxScale, Vector3{ worldMatrix[axis] }.Magnitude());
+		}
+
+		// Coarsest LOD whose error still projects to less than m_LodPixelError pixels
+		const Vector3 meshCenter{ worldMatrix.TransformPoint(m_LocalSphere.center) };
+		const float distance{ std::max((meshCenter - camera.origin).Magnitude() - m_LocalSphere.radius * maxScale, 0.0001f) };
+		const float pixelsPerUnit{ screenHeight / (2.f * camera.fov * distance) };
+
+		uint32_t lod{ 0 };
+		while (lod + 1 < m_LodErrors.size() && m_LodErrors[lod + 1] * maxScale * pixelsPerUnit <= m_LodPixelError)
+		{
+			++lod;
+		}
+
+		// Visible clusters of that LOD, nearest first so they win when the budget runs out
+		std::vector<std::pair<float, uint32_t>> visible{};
+		for (uint32_t cluster{ 0 }; cluster < m_Clusters.size(); ++cluster)
+		{
+			const ClusterInfo& info{ m_Clusters[cluster] };
+			if (info.lod != lod)
+				continue;
+
+			const BoundingSphere worldSphere{ worldMatrix.TransformPoint(info.sphere.center), info.sphere.radius * maxScale };
+			if (!frustum.IntersectsSphere(worldSphere))
+				continue;
+
+			if (pOcclusion && !pOcclusion->IsVisible(worldSphere))
+			{
+				++m_Stats.occluded;
+				continue;
+			}
+
+			visible.emplace_back((worldSphere.center - camera.origin).SqrMagnitude(), cluster);
+		}
+		std::sort(visible.begin(), visible.end());
+		m_Stats.visibleClusters = static_cast<uint32_t>(visible.size());
+
+		for (const auto& [sqrDistance, cluster] : visible)
+		{
+			ClusterState& state{ m_States[cluster] };
+			if (state.pData == nullptr && !MapCluster(cluster))
+			{
+				++m_Stats.skipped;
+				continue;
+			}
+
+			state.lastUsedFrame = m_Frame;
+			m_Lru.splice(m_Lru.begin(), m_Lru, state.lruPosition);
+
+			const ClusterInfo& info{ m_Clusters[cluster] };
+			ResidentCluster resident{};
+			resident.pVertices = reinterpret_cast<const Vertex_In*>(state.pData);
+			resident.pIndices = reinterpret_cast<const uint16_t*>(state.pData + sizeof(Vertex_In) * info.vertexCount);
+			resident.indexCount = info.indexCount;
+			resident.material = info.material;
+			clusters.push_back(resident);
+		}
+	}
+
+	const ClusteredMesh::Stats& ClusteredMesh::GetStats() const
+	{
+		return m_Stats;
+	}
+
+	bool ClusteredMesh::MapCluster(uint32_t cluster)
+	{
+		const ClusterInfo& info{ m_Clusters[cluster] };
+		const size_t dataBytes{ sizeof(Vertex_In) * info.vertexCount + sizeof(uint16_t) * info.indexCount };
+
+		const uint64_t viewOffset{ info.dataOffset - info.dataOffset % m_AllocationGranularity };
+		const size_t mappedBytes{ static_cast<size_t>(info.dataOffset - viewOffset) + dataBytes };
+		if (!MakeRoom(mappedBytes))
+			return false;
+
+		void* pView{ MapViewOfFile(m_Mapping, FILE_MAP_READ, static_cast<DWORD>(viewOffset >> 32), static_cast<DWORD>(viewOffset & 0xFFFFFFFF), mappedBytes) };
+		if (pView == nullptr)
+			return false;
+
+		ClusterState& state{ m_States[cluster] };
+		state.pView = pView;
+		state.pData = static_cast<const uint8_t*>(pView) + (info.dataOffset - viewOffset);
+		state.mappedBytes = mappedBytes;
+		state.lruPosition = m_Lru.insert(m_Lru.begin(), cluster);
+
+		m_Stats.residentBytes += mappedBytes;
+		++m_Stats.residentClusters;
+		++m_Stats.pagedIn;
+		return true;
+	}
+
+	void ClusteredMesh::UnmapCluster(uint32_t cluster)
+	{
+		ClusterState& state{ m_States[cluster] };
+		if (state.pView == nullptr)
+			return;
+
+		UnmapViewOfFile(state.pView);
+		m_Lru.erase(state.lruPosition);
+
+		m_Stats.residentBytes -= state.mappedBytes;
+		--m_Stats.residentClusters;
+
+		state = ClusterState{};
+	}
+
+	bool ClusteredMesh::MakeRoom(size_t bytes)
+	{
+		// Clusters used this frame are still referenced by the caller and cannot go
+		while (m_Stats.residentBytes + bytes > m_MemoryBudget && !m_Lru.empty())
+		{
+			const uint32_t leastRecent{ m_Lru.back() };
+			if (m_States[leastRecent].lastUsedFrame == m_Frame)
+				return false;
+
+			UnmapCluster(leastRecent);
+			++m_Stats.evicted;
+		}
+
+		return m_Stats.residentBytes + bytes <= m_MemoryBudget;
+	}
+}
@@ -0,0 +1,90 @@
+#pragma once
+#include <list>
+#include <string>
+#include <vector>
+#include <cstdint>
+#include "DataTypes.h"
+#include "AssetFormat.h"
+#include "OcclusionBuffer.h"
+
+namespace dae
+{
+	class Camera;
+
+	// Triangles of one mapped cluster, valid until the next GatherClusters call
+	struct ResidentCluster
+	{
+		const Vertex_In* pVertices{};
+		const uint16_t* pIndices{};
+		uint32_t indexCount{};
+		uint32_t material{};
+	};
+
+	// Out-of-core mesh for the software renderer. Only the cluster table is loaded, cluster data
+	// is memory mapped when a cluster becomes visible and unmapped again in least recently used
+	// order whenever the mapped size would exceed the memory budget.
+	class ClusteredMesh final
+	{
+	public:
+		struct Stats
+		{
+			size_t residentBytes{};
+			uint32_t residentClusters{};
+			uint32_t visibleClusters{};
+			uint32_t pagedIn{};
+			uint32_t evicted{};
+			uint32_t skipped{};		// visible, but no room left under the budget this frame
+			uint32_t occluded{};	// inside the frustum, but hidden behind the occluders
+		};
+
+		// Stays closed when the file was cooked from an older source, see AssetFormat::GetSourceTime
+		ClusteredMesh(const std::string& path, uint64_t sourceTime, size_t memoryBudget);
+		~ClusteredMesh();
+
+		ClusteredMesh(const ClusteredMesh&) = delete;
+		ClusteredMesh(ClusteredMesh&&) noexcept = delete;
+		ClusteredMesh& operator=(const ClusteredMesh&) = delete;
+		ClusteredMesh& operator=(ClusteredMesh&&) noexcept = delete;
+
+		bool IsOpen() const;
+
+		// Picks one LOD for the whole mesh (same rule as Mesh::UpdateLod), then pages in its
+		// visible clusters nearest first. Clusters that do not fit the budget are skipped, occluded ones
+		// are never paged in.
+		void GatherClusters(const Frustum& frustum, const Camera& camera, const Matrix& worldMatrix, float screenHeight, std::vector<ResidentCluster>& clusters, const OcclusionBuffer* pOcclusion = nullptr);
+
+		const Stats& GetStats() const;
+
+	private:
+		struct ClusterState
+		{
+			void* pView{ nullptr };
+			const uint8_t* pData{ nullptr };
+			size_t mappedBytes{};
+			uint64_t lastUsedFrame{};
+			std::list<uint32_t>::iterator lruPosition{};
+		};
+
+		bool MapCluster(uint32_t cluster);
+		void UnmapCluster(uint32_t cluster);
+		bool MakeRoom(size_t bytes);
+
+		std::vector<ClusterInfo> m_Clusters{};
+		std::vector<ClusterState> m_States{};
+		std::vector<float> m_LodErrors{};
+
+		// Most recently used in front
+		std::list<uint32_t> m_Lru{};
+
+		BoundingSphere m_LocalSphere{};
+		const float m_LodPixelError{ 1.f };
+		const size_t m_MemoryBudget;
+		uint32_t m_AllocationGranularity{ 65536 };
+		uint64_t m_Frame{ 0 };
+		Stats m_Stats{};
+
+		// Win32 file and file mapping HANDLEs
+		void* m_File{ nullptr };
+		void* m_Mapping{ nullptr };
+	};
+}
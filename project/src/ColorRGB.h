@@ -2,16 +2,20 @@
 #include "MathHelpers.h"
 #include <windows.h>
 #include <algorithm>
+#include <type_traits>
 
 #undef max
 
 namespace dae
 {
-	struct ColorRGB
+	// Padded to 16 bytes so the component-wise operators run on all channels in one SSE instruction.
+	// The padding lane stays 0 and is never read.
+	struct alignas(16) ColorRGB
 	{
 		float r{};
 		float g{};
 		float b{};
+		float padding{};
 
 		void MaxToOne()
 		{
@@ -26,50 +30,68 @@ namespace dae
 			return { Lerpf(c1.r, c2.r, factor), Lerpf(c1.g, c2.g, factor), Lerpf(c1.b, c2.b, factor) };
 		}
 
-		#pragma region ColorRGB (Member) Operators
-		const ColorRGB& operator+=(const ColorRGB& c)
+#if DAE_MATH_SSE
+		static ColorRGB FromRegister(__m128 c)
+		{
+			ColorRGB result;
+			_mm_store_ps(&result.r, c);
+			return result;
+		}
+
+		__m128 Load() const
 		{
-			r += c.r;
-			g += c.g;
-			b += c.b;
+			return _mm_load_ps(&r);
+		}
+#endif
 
+		#pragma region ColorRGB (Member) Operators
+		constexpr const ColorRGB& operator+=(const ColorRGB& c)
+		{
+			*this = *this + c;
 			return *this;
 		}
 
-		ColorRGB operator+(const ColorRGB& c) const
+		constexpr ColorRGB operator+(const ColorRGB& c) const
 		{
+#if DAE_MATH_SSE
+			if (!std::is_constant_evaluated())
+				return FromRegister(_mm_add_ps(Load(), c.Load()));
+#endif
 			return { r + c.r, g + c.g, b + c.b };
 		}
 
-		const ColorRGB& operator-=(const ColorRGB& c)
+		constexpr const ColorRGB& operator-=(const ColorRGB& c)
 		{
-			r -= c.r;
-			g -= c.g;
-			b -= c.b;
-
+			*this = *this - c;
 			return *this;
 		}
 
-		ColorRGB operator-(const ColorRGB& c) const
+		constexpr ColorRGB operator-(const ColorRGB& c) const
 		{
+#if DAE_MATH_SSE
+			if (!std::is_constant_evaluated())
+				return FromRegister(_mm_sub_ps(Load(), c.Load()));
+#endif
 			return { r - c.r, g - c.g, b - c.b };
 		}
 
-		const ColorRGB& operator*=(const ColorRGB& c)
+		constexpr const ColorRGB& operator*=(const ColorRGB& c)
 		{
-			r *= c.r;
-			g *= c.g;
-			b *= c.b;
-
+			*this = *this * c;
 			return *this;
 		}
 
-		ColorRGB operator*(const ColorRGB& c) const
+		constexpr ColorRGB operator*(const ColorRGB& c) const
 		{
+#if DAE_MATH_SSE
+			if (!std::is_constant_evaluated())
+				return FromRegister(_mm_mul_ps(Load(), c.Load()));
+#endif
 			return { r * c.r, g * c.g, b * c.b };
 		}
 
-		const ColorRGB& operator/=(const ColorRGB& c)
+		// Scalar on purpose, the padding lanes would divide 0 by 0
+		constexpr const ColorRGB& operator/=(const ColorRGB& c)
 		{
 			r /= c.r;
 			g /= c.g;
@@ -78,38 +100,40 @@ namespace dae
 			return *this;
 		}
 
-		const ColorRGB& operator*=(float s)
+		constexpr const ColorRGB& operator*=(float s)
 		{
-			r *= s;
-			g *= s;
-			b *= s;
-
+			*this = *this * s;
 			return *this;
 		}
 
-		ColorRGB operator*(float s) const
+		constexpr ColorRGB operator*(float s) const
 		{
+#if DAE_MATH_SSE
+			if (!std::is_constant_evaluated())
+				return FromRegister(_mm_mul_ps(Load(), _mm_set1_ps(s)));
+#endif
 			return { r * s, g * s,b * s };
 		}
 
-		const ColorRGB& operator/=(float s)
+		constexpr const ColorRGB& operator/=(float s)
 		{
-			r /= s;
-			g /= s;
-			b /= s;
-
+			*this = *this / s;
 			return *this;
 		}
 
-		ColorRGB operator/(float s) const
+		constexpr ColorRGB operator/(float s) const
 		{
+#if DAE_MATH_SSE
+			if (!std::is_constant_evaluated())
+				return FromRegister(_mm_div_ps(Load(), _mm_set1_ps(s)));
+#endif
 			return { r / s, g / s,b / s };
 		}
 		#pragma endregion
 	};
 
 	//ColorRGB (Global) Operators
-	inline ColorRGB operator*(float s, const ColorRGB& c)
+	constexpr ColorRGB operator*(float s, const ColorRGB& c)
 	{
 		return c * s;
 	}
@@ -126,4 +150,4 @@ namespace dae
 		static ColorRGB Black{ 0,0,0 };
 		static ColorRGB Gray{ 0.5f,0.5f,0.5f };
 	}
-}
\ No newline at end of file
+}
@@ -1,6 +1,10 @@
 #pragma once
 #include "Maths.h"
 #include <vector>
+#include <array>
+#include <cstdint>
+#include <algorithm>
+#include <compare>
 
 namespace dae
 {
@@ -12,6 +16,33 @@ namespace dae
 		float  distance = 0.f;
 	};
 
+	struct BoundingBox
+	{
+		Vector3 min{};
+		Vector3 max{};
+
+		void Grow(const Vector3& point)
+		{
+			min = { std::min(min.x, point.x), std::min(min.y, point.y), std::min(min.z, point.z) };
+			max = { std::max(max.x, point.x), std::max(max.y, point.y), std::max(max.z, point.z) };
+		}
+	};
+
+	struct BoundingSphere
+	{
+		Vector3 center{};
+		float radius{};
+	};
+
+	// Pixels [minX, maxX) x [minY, maxY)
+	struct PixelRect
+	{
+		int minX{};
+		int minY{};
+		int maxX{};
+		int maxY{};
+	};
+
 	struct Vertex_PosCol
 	{
 		dae::Vector3 position{ };
@@ -31,35 +62,50 @@ namespace dae
 		Plane farFace;
 		Plane nearFace;
 
-		bool IsInsideFrustum(const Vector4& transformedPosition) const
+		// Member order the tests walk through, near and far first since they reject the most
+		static constexpr std::array<Plane Frustum::*, 6> Planes{ &Frustum::nearFace, &Frustum::farFace,
+																 &Frustum::leftFace, &Frustum::rightFace,
+																 &Frustum::topFace, &Frustum::bottomFace };
+
+		// Expects a position in the space the planes were extracted in
+		bool IsInsideFrustum(const Vector3& position) const
 		{
-			if (transformedPosition.x < -1.0f || transformedPosition.x > 1.0f ||
-				transformedPosition.y < -1.0f || transformedPosition.y > 1.0f ||
-				transformedPosition.z < 0.0f || transformedPosition.z > 1.0f)
+			for (Plane Frustum::* pPlane : Planes)
 			{
-				return false; // Outside frustum
+				const Plane& plane{ this->*pPlane };
+
+				// Outside any plane means outside the frustum
+				if (Vector3::Dot(plane.normal, position) + plane.distance < 0.0f)
+				{
+					return false;
+				}
 			}
 
-			// Loop through all six planes of the frustum
-			for (const Plane& plane : { nearFace, farFace,
-										leftFace, rightFace,
-										topFace, bottomFace })
+			return true;
+		}
+
+		bool IntersectsSphere(const BoundingSphere& sphere) const
+		{
+			for (Plane Frustum::* pPlane : Planes)
 			{
-				// Compute the distance of the point from the plane
-				float distance = Vector3::Dot(plane.normal, Vector3(transformedPosition.x,
-					transformedPosition.y,
-					transformedPosition.z)) + plane.distance;
+				const Plane& plane{ this->*pPlane };
 
-				 //If the point is outside any plane, it's outside the frustum
-				if (distance < 0.0f)
+				// Completely behind one plane means completely outside
+				if (Vector3::Dot(plane.normal, sphere.center) + plane.distance < -sphere.radius)
 				{
 					return false;
 				}
 			}
 
-			// The point is inside all planes of the frustum
 			return true;
+		}
 
+		// Expects a position after the perspective divide
+		static bool IsInsideClipSpace(const Vector4& ndcPosition)
+		{
+			return !(ndcPosition.x < -1.0f || ndcPosition.x > 1.0f ||
+				ndcPosition.y < -1.0f || ndcPosition.y > 1.0f ||
+				ndcPosition.z < 0.0f || ndcPosition.z > 1.0f);
 		}
 	};
 
@@ -69,6 +115,38 @@ namespace dae
 		dae::Vector2 uv{ };
 		dae::Vector3 normal{ };
 		dae::Vector3 tangent{ };
+		float tangentSign{ 1.f };	// -1 on mirrored uvs, bitangent = tangentSign * cross(normal, tangent)
+	};
+
+	class Texture;
+
+	// Maps the software shading samples, independent of where the triangles come from
+	struct Material
+	{
+		const Texture* pDiffuseMap{ nullptr };
+		const Texture* pNormalMap{ nullptr };
+		const Texture* pSpecularMap{ nullptr };
+		const Texture* pGlossinessMap{ nullptr };
+		const Texture* pObjectNormalMap{ nullptr };	// software only, baked for the triangles that can use it
+
+		// Orders by texture identity, used to batch draws sharing their maps
+		auto operator<=>(const Material&) const = default;
+	};
+
+	// 20 byte encoding of Vertex_In, see VertexCompression.h
+	struct Vertex_Compact
+	{
+		uint16_t position[4]{};		// unorm16 inside the mesh bounds, w is the tangent sign (0 or 65535)
+		uint16_t uv[2]{};			// half floats
+		int16_t normal[2]{};		// octahedral, snorm16
+		int16_t tangent[2]{};		// octahedral, snorm16
+	};
+
+	// Maps unorm positions back to object space: offset + position * scale
+	struct VertexQuantization
+	{
+		Vector3 offset{};
+		Vector3 scale{ 1.f, 1.f, 1.f };
 	};
 
 	struct Vertex_Out
@@ -77,7 +155,11 @@ namespace dae
 		Vector2 uv{};
 		Vector3 normal{};
 		Vector3 tangent{};
+		float tangentSign{ 1.f };
 		Vector3 viewDirection{};
+		Vector3 worldPosition{};
+		ColorRGB irradiance{};		// per-vertex shading tier only
+		ColorRGB specular{};
 	};
 
 	enum class PrimitiveTopology
@@ -86,6 +168,12 @@ namespace dae
 		TriangleStrip
 	};
 
+	enum class VertexFormat
+	{
+		Full,
+		Compact
+	};
+
 	enum RenderMethod
 	{
 		DirectX,
@@ -107,8 +195,25 @@ namespace dae
 		Specular
 	};
 
+	// Where the software renderer evaluates the lights
+	enum class ShadingTier
+	{
+		PerPixel,		// normal mapped Phong
+		PerVertex,		// Gouraud, only the diffuse map is sampled per pixel
+		ByScreenSize	// setting only, every mesh gets one of the two above
+	};
+
+	// Where the software renderer takes the per-pixel normal from
+	enum class NormalMapMode
+	{
+		Off,			// interpolated vertex normal
+		TangentSpace,	// tangent frame built per pixel
+		ObjectSpace		// baked map, rotated by the world matrix of the batch
+	};
+
 	struct Triangle
 	{
-		std::vector<Vertex_Out> vertices;
+		std::array<Vertex_Out, 3> vertices;
+		std::array<uint32_t, 3> indices{};	// vertex of each corner, unique within its batch
 	};
 }
\ No newline at end of file
@@ -8,11 +8,10 @@
 
 
 
-ID3DX11Effect* Effect::LoadEffect(ID3D11Device* pDevice, const std::wstring& assetFile)
+ID3DBlob* Effect::CompileEffect(const std::wstring& assetFile)
 {
-	HRESULT result;
-	ID3D10Blob* pErrorBlob{ nullptr };
-	ID3DX11Effect* pEffect;
+	ID3DBlob* pErrorBlob{ nullptr };
+	ID3DBlob* pCompiledEffect{ nullptr };
 
 	DWORD shaderFlags = 0;
 
@@ -21,105 +20,156 @@ ID3DX11Effect* Effect::LoadEffect(ID3D11Device* pDevice, const std::wstring& ass
 	shaderFlags |= D3DCOMPILE_SKIP_OPTIMIZATION;
 #endif
 
-	result = D3DX11CompileEffectFromFile(assetFile.c_str(),
+	const HRESULT result = D3DCompileFromFile(assetFile.c_str(),
 		nullptr,
+		D3D_COMPILE_STANDARD_FILE_INCLUDE,
 		nullptr,
+		"fx_5_0",
 		shaderFlags,
 		0,
-		pDevice,
-		&pEffect,
+		&pCompiledEffect,
 		&pErrorBlob);
 
 	if (FAILED(result))
 	{
+		std::wstringstream ss;
 		if (pErrorBlob != nullptr)
 		{
 			const char* pErros = static_cast<char*>(pErrorBlob->GetBufferPointer());
-
-			std::wstringstream ss;
 			for (unsigned int index{ 0 }; index < pErrorBlob->GetBufferSize(); ++index)
 				ss << pErros[index];
-
-			OutputDebugStringW(ss.str().c_str());
-			pErrorBlob->Release();
-			pErrorBlob = nullptr;
-
-			std::wcout << ss.str() << std::endl;
 		}
 		else
 		{
-			std::wstringstream ss;
-			ss << "Effectloaded : Failed to CreateEffectFromFile!\nPath: " << assetFile;
-			std::wcout << ss.str() << std::endl;
+			ss << "Effectloaded : Failed to compile effect!\nPath: " << assetFile;
 		}
+
+		OutputDebugStringW(ss.str().c_str());
+		std::wcout << ss.str() << std::endl;
 	}
 
-	return pEffect;
-}
+	if (pErrorBlob != nullptr)
+		pErrorBlob->Release();
 
-OpaqueEffect::OpaqueEffect(ID3DX11Effect* pEffect, ID3D11Device* pDevice, const std::vector<dae::Vertex_In>& vertices, const std::vector<uint32_t>& indice):
-	m_pEffect						{ pEffect},
-	m_pCameraPosition				{ pEffect->GetVariableByName("gCameraPosition")->AsVector() },
-	m_pWorldMatrix					{ pEffect->GetVariableByName("gWorldMatrix")->AsMatrix() },
-	m_pWorldViewProjectionMatrix	{ pEffect->GetVariableByName("gWorldViewProj")->AsMatrix() },
-	m_pDiffuseMapVariable			{ pEffect->GetVariableByName("gDiffuseMap")->AsShaderResource() },
-	m_pNormalMapVariable			{ pEffect->GetVariableByName("gNormalMap")->AsShaderResource() },
-	m_pSpecularMapVariable			{ pEffect->GetVariableByName("gSpecularMap")->AsShaderResource() },
-	m_pGlossinessMapVariable		{ pEffect->GetVariableByName("gGlossinessMap")->AsShaderResource() },
-	m_PointTechnique				{ pEffect->GetTechniqueByName("PointTechnique") },
-	m_LinearTechnique				{ pEffect->GetTechniqueByName("LinearTechnique") },
-	m_AnisotropicTechnique			{ pEffect->GetTechniqueByName("AnisotropicTechnique") }
+	return pCompiledEffect;
+}
 
+ID3DX11Effect* Effect::CreateEffect(ID3D11Device* pDevice, ID3DBlob* pCompiledEffect)
 {
-	m_pTechnique = m_PointTechnique;
+	if (pCompiledEffect == nullptr)
+		return nullptr;
 
-	if (!m_pTechnique->IsValid())
+	ID3DX11Effect* pEffect{ nullptr };
+	const HRESULT result = D3DX11CreateEffectFromMemory(pCompiledEffect->GetBufferPointer(), pCompiledEffect->GetBufferSize(), 0, pDevice, &pEffect);
+	pCompiledEffect->Release();
+
+	if (FAILED(result))
 	{
-		std::cout << "Failed!";
+		std::wcout << L"Effectloaded : Failed to create effect from compiled blob!" << std::endl;
+		return nullptr;
 	}
 
-	// Create Vertex Layout
-	static constexpr uint32_t numElements{ 4 };
+	return pEffect;
+}
+
+ID3D11InputLayout* Effect::CreateInputLayout(ID3D11Device* pDevice, ID3DX11EffectTechnique* pTechnique, dae::VertexFormat format)
+{
+	// Compact vertices feed the same shader inputs, the input assembler expands them to floats
+	const bool isCompact{ format == dae::VertexFormat::Compact };
+
+	static constexpr uint32_t numElements{ 8 };
 	D3D11_INPUT_ELEMENT_DESC vertexDesc[numElements]{};
 
 	vertexDesc[0].SemanticName = "Position";
-	vertexDesc[0].Format = DXGI_FORMAT_R32G32B32_FLOAT;
+	vertexDesc[0].Format = isCompact ? DXGI_FORMAT_R16G16B16A16_UNORM : DXGI_FORMAT_R32G32B32_FLOAT;
 	vertexDesc[0].AlignedByteOffset = 0;
 	vertexDesc[0].InputSlotClass = D3D11_INPUT_PER_VERTEX_DATA;
 
 	vertexDesc[1].SemanticName = "TEXCOORD";
-	vertexDesc[1].Format = DXGI_FORMAT_R32G32_FLOAT;
-	vertexDesc[1].AlignedByteOffset = 12;
+	vertexDesc[1].Format = isCompact ? DXGI_FORMAT_R16G16_FLOAT : DXGI_FORMAT_R32G32_FLOAT;
+	vertexDesc[1].AlignedByteOffset = isCompact ? 8 : 12;
 	vertexDesc[1].InputSlotClass = D3D11_INPUT_PER_VERTEX_DATA;
 
 	vertexDesc[2].SemanticName = "Normal";
-	vertexDesc[2].Format = DXGI_FORMAT_R32G32B32_FLOAT;
-	vertexDesc[2].AlignedByteOffset = 20;
+	vertexDesc[2].Format = isCompact ? DXGI_FORMAT_R16G16_SNORM : DXGI_FORMAT_R32G32B32_FLOAT;
+	vertexDesc[2].AlignedByteOffset = isCompact ? 12 : 20;
 	vertexDesc[2].InputSlotClass = D3D11_INPUT_PER_VERTEX_DATA;
 
 	vertexDesc[3].SemanticName = "Tangent";
-	vertexDesc[3].Format = DXGI_FORMAT_R32G32B32_FLOAT;
-	vertexDesc[3].AlignedByteOffset = 32;
+	// Full vertices carry the tangent sign in w, compact ones in the position w
+	vertexDesc[3].Format = isCompact ? DXGI_FORMAT_R16G16_SNORM : DXGI_FORMAT_R32G32B32A32_FLOAT;
+	vertexDesc[3].AlignedByteOffset = isCompact ? 16 : 32;
 	vertexDesc[3].InputSlotClass = D3D11_INPUT_PER_VERTEX_DATA;
 
-	// Create Input Layout
+	// Instance matrix rows from the second buffer, advancing once per instance
+	for (uint32_t row{ 0 }; row < 4; ++row)
+	{
+		D3D11_INPUT_ELEMENT_DESC& element{ vertexDesc[4 + row] };
+		element.SemanticName = "INSTANCE";
+		element.SemanticIndex = row;
+		element.Format = DXGI_FORMAT_R32G32B32A32_FLOAT;
+		element.InputSlot = 1;
+		element.AlignedByteOffset = row * sizeof(dae::Vector4);
+		element.InputSlotClass = D3D11_INPUT_PER_INSTANCE_DATA;
+		element.InstanceDataStepRate = 1;
+	}
+
 	D3DX11_PASS_DESC passDesc{};
-	m_pTechnique->GetPassByIndex(0)->GetDesc(&passDesc);
-	HRESULT result = pDevice->CreateInputLayout(
+	pTechnique->GetPassByIndex(0)->GetDesc(&passDesc);
+
+	ID3D11InputLayout* pInputLayout{ nullptr };
+	const HRESULT result = pDevice->CreateInputLayout(
 		vertexDesc,
 		numElements,
 		passDesc.pIAInputSignature,
 		passDesc.IAInputSignatureSize,
-		&m_pInputLayout);
+		&pInputLayout);
 
 	if (FAILED(result))
+	{
+		std::wcout << L"Input layout creation failed!" << std::endl;
+		return nullptr;
+	}
+
+	return pInputLayout;
+}
+
+OpaqueEffect::OpaqueEffect(ID3DX11Effect* pEffect, ID3D11Device* pDevice):
+	m_pEffect						{ pEffect},
+	m_pCameraPosition				{ pEffect->GetVariableByName("gCameraPosition")->AsVector() },
+	m_pWorldMatrix					{ pEffect->GetVariableByName("gWorldMatrix")->AsMatrix() },
+	m_pViewProjectionMatrix			{ pEffect->GetVariableByName("gViewProj")->AsMatrix() },
+	m_pDiffuseMapVariable			{ pEffect->GetVariableByName("gDiffuseMap")->AsShaderResource() },
+	m_pNormalMapVariable			{ pEffect->GetVariableByName("gNormalMap")->AsShaderResource() },
+	m_pSpecularMapVariable			{ pEffect->GetVariableByName("gSpecularMap")->AsShaderResource() },
+	m_pGlossinessMapVariable		{ pEffect->GetVariableByName("gGlossinessMap")->AsShaderResource() },
+	m_pCompactVerticesVariable		{ pEffect->GetVariableByName("gCompactVertices")->AsScalar() },
+	m_pPositionOffsetVariable		{ pEffect->GetVariableByName("gPositionOffset")->AsVector() },
+	m_pPositionScaleVariable		{ pEffect->GetVariableByName("gPositionScale")->AsVector() },
+	m_PointTechnique				{ pEffect->GetTechniqueByName("PointTechnique") },
+	m_LinearTechnique				{ pEffect->GetTechniqueByName("LinearTechnique") },
+	m_AnisotropicTechnique			{ pEffect->GetTechniqueByName("AnisotropicTechnique") }
+
+{
+	m_pTechnique = m_PointTechnique;
+
+	if (!m_pTechnique->IsValid())
+	{
+		std::cout << "Failed!";
+	}
+
+	// Create Input Layouts, one per vertex format
+	m_pInputLayout = CreateInputLayout(pDevice, m_pTechnique, dae::VertexFormat::Full);
+	m_pCompactInputLayout = CreateInputLayout(pDevice, m_pTechnique, dae::VertexFormat::Compact);
+
+	if (!m_pInputLayout || !m_pCompactInputLayout)
 	{
 		return;
 	}
 
-	if (!m_pWorldViewProjectionMatrix->IsValid())
+	if (!m_pViewProjectionMatrix->IsValid())
 	{
-		std::wcout << L"WorldViewProjection matrix not valid" << std::endl;
+		std::wcout << L"ViewProjection matrix not valid" << std::endl;
 	}
 
 	if (!m_pDiffuseMapVariable->IsValid())
@@ -170,9 +220,14 @@ OpaqueEffect::~OpaqueEffect()
 
 	m_pCameraPosition->Release();
 	m_pWorldMatrix->Release();
-	m_pWorldViewProjectionMatrix->Release();
+	m_pViewProjectionMatrix->Release();
+
+	m_pCompactVerticesVariable->Release();
+	m_pPositionOffsetVariable->Release();
+	m_pPositionScaleVariable->Release();
 
 	m_pInputLayout->Release();
+	m_pCompactInputLayout->Release();
 	m_pEffect->Release();
 }
 
@@ -246,9 +301,9 @@ void OpaqueEffect::SetGlossinessMap(const dae::Texture* pGlossMapTexture) const
 	}
 }
 
-void OpaqueEffect::SetMatricis(const dae::Matrix& worldProjectionMatrix, const dae::Matrix& worldMatrix, const dae::Vector3& cameraOrigin)
+void OpaqueEffect::SetMatricis(const dae::Matrix& viewProjectionMatrix, const dae::Matrix& worldMatrix, const dae::Vector3& cameraOrigin)
 {
-	m_pWorldViewProjectionMatrix->SetMatrix(reinterpret_cast<const float*>(&worldProjectionMatrix));
+	m_pViewProjectionMatrix->SetMatrix(reinterpret_cast<const float*>(&viewProjectionMatrix));
 	m_pWorldMatrix->SetMatrix(reinterpret_cast<const float*>(&worldMatrix));
 	m_pCameraPosition->AsVector()->SetFloatVector(reinterpret_cast<const float*>(&cameraOrigin));
 }
@@ -258,14 +313,22 @@ ID3DX11EffectTechnique* OpaqueEffect::GetTechnique() const
 	return m_pTechnique;
 }
 
-ID3D11InputLayout* OpaqueEffect::GetInputLayout() const
+void OpaqueEffect::SetVertexDecode(bool isCompact, const dae::VertexQuantization& quantization)
 {
-	return m_pInputLayout;
+	m_pCompactVerticesVariable->SetBool(isCompact);
+	m_pPositionOffsetVariable->SetFloatVector(reinterpret_cast<const float*>(&quantization.offset));
+	m_pPositionScaleVariable->SetFloatVector(reinterpret_cast<const float*>(&quantization.scale));
 }
 
-TransparentEffect::TransparentEffect(ID3DX11Effect* pEffect, ID3D11Device* pDevice, const std::vector<dae::Vertex_In>& vertices, const std::vector<uint32_t>& indice):
+ID3D11InputLayout* OpaqueEffect::GetInputLayout(dae::VertexFormat format) const
+{
+	return format == dae::VertexFormat::Compact ? m_pCompactInputLayout : m_pInputLayout;
+}
+
+TransparentEffect::TransparentEffect(ID3DX11Effect* pEffect, ID3D11Device* pDevice):
 	m_pEffect{pEffect},
-	m_pWorldViewProjectionMatrix{nullptr},
+	m_pWorldMatrix{nullptr},
+	m_pViewProjectionMatrix{nullptr},
 	m_PointTechnique{ pEffect->GetTechniqueByName("PointTechnique") },
 	m_LinearTechnique{ pEffect->GetTechniqueByName("LinearTechnique") },
 	m_AnisotropicTechnique{ pEffect->GetTechniqueByName("AnisotropicTechnique") }
@@ -277,44 +340,20 @@ TransparentEffect::TransparentEffect(ID3DX11Effect* pEffect, ID3D11Device* pDevi
 		std::cout << "Failed!";
 	}
 
-	// Create Vertex Layout
-	static constexpr uint32_t numElements{ 4 };
-	D3D11_INPUT_ELEMENT_DESC vertexDesc[numElements]{};
-
-	vertexDesc[0].SemanticName = "Position";
-	vertexDesc[0].Format = DXGI_FORMAT_R32G32B32_FLOAT;
-	vertexDesc[0].AlignedByteOffset = 0;
-	vertexDesc[0].InputSlotClass = D3D11_INPUT_PER_VERTEX_DATA;
-
-	vertexDesc[1].SemanticName = "TEXCOORD";
-	vertexDesc[1].Format = DXGI_FORMAT_R32G32_FLOAT;
-	vertexDesc[1].AlignedByteOffset = 12;
-	vertexDesc[1].InputSlotClass = D3D11_INPUT_PER_VERTEX_DATA;
-
-	vertexDesc[2].SemanticName = "Normal";
-	vertexDesc[2].Format = DXGI_FORMAT_R32G32B32_FLOAT;
-	vertexDesc[2].AlignedByteOffset = 20;
-	vertexDesc[2].InputSlotClass = D3D11_INPUT_PER_VERTEX_DATA;
-
-	vertexDesc[3].SemanticName = "Tangent";
-	vertexDesc[3].Format = DXGI_FORMAT_R32G32B32_FLOAT;
-	vertexDesc[3].AlignedByteOffset = 32;
-	vertexDesc[3].InputSlotClass = D3D11_INPUT_PER_VERTEX_DATA;
+	// Create Input Layouts, one per vertex format
+	m_pInputLayout = CreateInputLayout(pDevice, m_pTechnique, dae::VertexFormat::Full);
+	m_pCompactInputLayout = CreateInputLayout(pDevice, m_pTechnique, dae::VertexFormat::Compact);
 
-	// Create Input Layout
-	D3DX11_PASS_DESC passDesc{};
-	m_pTechnique->GetPassByIndex(0)->GetDesc(&passDesc);
-	HRESULT result = pDevice->CreateInputLayout(
-		vertexDesc,
-		numElements,
-		passDesc.pIAInputSignature,
-		passDesc.IAInputSignatureSize,
-		&m_pInputLayout);
+	m_pWorldMatrix = m_pEffect->GetVariableByName("gWorldMatrix")->AsMatrix();
+	if (!m_pWorldMatrix->IsValid())
+	{
+		std::wcout << L"WorldMatrix not valid!" << std::endl;
+	}
 
-	m_pWorldViewProjectionMatrix = m_pEffect->GetVariableByName("gWorldViewProj")->AsMatrix();
-	if (!m_pWorldViewProjectionMatrix->IsValid())
+	m_pViewProjectionMatrix = m_pEffect->GetVariableByName("gViewProj")->AsMatrix();
+	if (!m_pViewProjectionMatrix->IsValid())
 	{
-		std::wcout << L"WorldViewProjection matrix not valid" << std::endl;
+		std::wcout << L"ViewProjection matrix not valid" << std::endl;
 	}
 
 	m_pDiffuseMapVariable = m_pEffect->GetVariableByName("gDiffuseMap")->AsShaderResource();
@@ -324,10 +363,9 @@ TransparentEffect::TransparentEffect(ID3DX11Effect* pEffect, ID3D11Device* pDevi
 		std::wcout << L"DiffuseMap variable not valid\n";
 	}
 
-	if (FAILED(result))
-	{
-		return;
-	}
+	m_pCompactVerticesVariable = m_pEffect->GetVariableByName("gCompactVertices")->AsScalar();
+	m_pPositionOffsetVariable = m_pEffect->GetVariableByName("gPositionOffset")->AsVector();
+	m_pPositionScaleVariable = m_pEffect->GetVariableByName("gPositionScale")->AsVector();
 }
 
 TransparentEffect::~TransparentEffect()
@@ -338,9 +376,15 @@ TransparentEffect::~TransparentEffect()
 
 	m_pDiffuseMapVariable->Release();
 
-	m_pWorldViewProjectionMatrix->Release();
+	m_pWorldMatrix->Release();
+	m_pViewProjectionMatrix->Release();
+
+	m_pCompactVerticesVariable->Release();
+	m_pPositionOffsetVariable->Release();
+	m_pPositionScaleVariable->Release();
 
 	m_pInputLayout->Release();
+	m_pCompactInputLayout->Release();
 	m_pEffect->Release();
 }
 
@@ -390,9 +434,10 @@ void TransparentEffect::SetGlossinessMap(const dae::Texture* pGlossMapTexture) c
 	return;
 }
 
-void TransparentEffect::SetMatricis(const dae::Matrix& worldProjectionMatrix, const dae::Matrix& worldMatrix, const dae::Vector3& cameraOrigin)
+void TransparentEffect::SetMatricis(const dae::Matrix& viewProjectionMatrix, const dae::Matrix& worldMatrix, const dae::Vector3& cameraOrigin)
 {
-	m_pWorldViewProjectionMatrix->SetMatrix(reinterpret_cast<const float*>(&worldProjectionMatrix));
+	m_pWorldMatrix->SetMatrix(reinterpret_cast<const float*>(&worldMatrix));
+	m_pViewProjectionMatrix->SetMatrix(reinterpret_cast<const float*>(&viewProjectionMatrix));
 }
 
 ID3DX11EffectTechnique* TransparentEffect::GetTechnique() const
@@ -400,7 +445,14 @@ ID3DX11EffectTechnique* TransparentEffect::GetTechnique() const
 	return m_pTechnique;
 }
 
-ID3D11InputLayout* TransparentEffect::GetInputLayout() const
+void TransparentEffect::SetVertexDecode(bool isCompact, const dae::VertexQuantization& quantization)
+{
+	m_pCompactVerticesVariable->SetBool(isCompact);
+	m_pPositionOffsetVariable->SetFloatVector(reinterpret_cast<const float*>(&quantization.offset));
+	m_pPositionScaleVariable->SetFloatVector(reinterpret_cast<const float*>(&quantization.scale));
+}
+
+ID3D11InputLayout* TransparentEffect::GetInputLayout(dae::VertexFormat format) const
 {
-	return m_pInputLayout;
+	return format == dae::VertexFormat::Compact ? m_pCompactInputLayout : m_pInputLayout;
 }
@@ -32,19 +32,27 @@ public:
 	virtual void SetSpecularMap(const dae::Texture* pSpecularMapTexture) const = 0;
 	virtual void SetGlossinessMap(const dae::Texture* pGlossMapTexture) const = 0;
 
-	virtual void SetMatricis(const dae::Matrix& worldProjectionMatrix, const dae::Matrix& worldMatrix, const dae::Vector3& cameraOrigin) = 0;
+	// Instances are applied in between: position * world * instance * viewProjection
+	virtual void SetMatricis(const dae::Matrix& viewProjectionMatrix, const dae::Matrix& worldMatrix, const dae::Vector3& cameraOrigin) = 0;
+
+	// Compact meshes decode positions with offset + position * scale, normals are octahedral
+	virtual void SetVertexDecode(bool isCompact, const dae::VertexQuantization& quantization) = 0;
 
 	virtual ID3DX11EffectTechnique* GetTechnique() const = 0;
-	virtual ID3D11InputLayout* GetInputLayout() const = 0;
+	virtual ID3D11InputLayout* GetInputLayout(dae::VertexFormat format) const = 0;
 
-	static ID3DX11Effect* LoadEffect(ID3D11Device* pDevice, const std::wstring& asset1ile);
+	// Compiling does not need the device and runs on a worker, creating does
+	static ID3DBlob* CompileEffect(const std::wstring& assetFile);
+	static ID3DX11Effect* CreateEffect(ID3D11Device* pDevice, ID3DBlob* pCompiledEffect);
 
+protected:
+	static ID3D11InputLayout* CreateInputLayout(ID3D11Device* pDevice, ID3DX11EffectTechnique* pTechnique, dae::VertexFormat format);
 };
 
 class OpaqueEffect : public Effect
 {
 public:
-	OpaqueEffect(ID3DX11Effect* pEffect, ID3D11Device* pDevice, const std::vector<dae::Vertex_In>& vertices, const std::vector<uint32_t>& indices);
+	OpaqueEffect(ID3DX11Effect* pEffect, ID3D11Device* pDevice);
 	virtual ~OpaqueEffect();
 
 	void SetTechnique(SampleState technique) override;
@@ -54,14 +62,17 @@ public:
 	void SetSpecularMap(const dae::Texture* pSpecularMapTexture) const override;
 	void SetGlossinessMap(const dae::Texture* pGlossMapTexture) const override;
 
-	void SetMatricis(const dae::Matrix& worldProjectionMatrix, const dae::Matrix& worldMatrix, const dae::Vector3& cameraOrigin) override;
+	void SetMatricis(const dae::Matrix& viewProjectionMatrix, const dae::Matrix& worldMatrix, const dae::Vector3& cameraOrigin) override;
+
+	void SetVertexDecode(bool isCompact, const dae::VertexQuantization& quantization) override;
 
 	ID3DX11EffectTechnique* GetTechnique() const override;
-	ID3D11InputLayout* GetInputLayout() const override;
+	ID3D11InputLayout* GetInputLayout(dae::VertexFormat format) const override;
 
 private:
 	ID3DX11Effect* m_pEffect;
 	ID3D11InputLayout* m_pInputLayout;
+	ID3D11InputLayout* m_pCompactInputLayout;
 	ID3DX11EffectTechnique* m_pTechnique;
 
 	ID3DX11EffectTechnique* m_PointTechnique;
@@ -75,14 +86,18 @@ private:
 
 	ID3DX11EffectVariable* m_pCameraPosition;
 	ID3DX11EffectMatrixVariable* m_pWorldMatrix;
-	ID3DX11EffectMatrixVariable* m_pWorldViewProjectionMatrix;
+	ID3DX11EffectMatrixVariable* m_pViewProjectionMatrix;
+
+	ID3DX11EffectScalarVariable* m_pCompactVerticesVariable;
+	ID3DX11EffectVectorVariable* m_pPositionOffsetVariable;
+	ID3DX11EffectVectorVariable* m_pPositionScaleVariable;
 };
 
 
 class TransparentEffect : public Effect
 {
 public:
-	TransparentEffect(ID3DX11Effect* pEffect, ID3D11Device* pDevice, const std::vector<dae::Vertex_In>& vertices, const std::vector<uint32_t>& indice);
+	TransparentEffect(ID3DX11Effect* pEffect, ID3D11Device* pDevice);
 	virtual ~TransparentEffect();
 
 	void SetTechnique(SampleState technique) override;
@@ -93,14 +108,17 @@ public:
 	void SetGlossinessMap(const dae::Texture* pGlossMapTexture) const override;
 
 
-	void SetMatricis(const dae::Matrix& worldProjectionMatrix, const dae::Matrix& worldMatrix, const dae::Vector3& cameraOrigin) override;
+	void SetMatricis(const dae::Matrix& viewProjectionMatrix, const dae::Matrix& worldMatrix, const dae::Vector3& cameraOrigin) override;
+
+	void SetVertexDecode(bool isCompact, const dae::VertexQuantization& quantization) override;
 
 	ID3DX11EffectTechnique* GetTechnique() const override;
-	ID3D11InputLayout* GetInputLayout() const override;
+	ID3D11InputLayout* GetInputLayout(dae::VertexFormat format) const override;
 
 private:
 	ID3DX11Effect* m_pEffect;
 	ID3D11InputLayout* m_pInputLayout;
+	ID3D11InputLayout* m_pCompactInputLayout;
 	ID3DX11EffectTechnique* m_pTechnique;
 
 	ID3DX11EffectTechnique* m_PointTechnique;
@@ -108,5 +126,10 @@ private:
 	ID3DX11EffectTechnique* m_AnisotropicTechnique;
 
 	ID3DX11EffectShaderResourceVariable* m_pDiffuseMapVariable;
-	ID3DX11EffectMatrixVariable* m_pWorldViewProjectionMatrix;
+	ID3DX11EffectMatrixVariable* m_pWorldMatrix;
+	ID3DX11EffectMatrixVariable* m_pViewProjectionMatrix;
+
+	ID3DX11EffectScalarVariable* m_pCompactVerticesVariable;
+	ID3DX11EffectVectorVariable* m_pPositionOffsetVariable;
+	ID3DX11EffectVectorVariable* m_pPositionScaleVariable;
 };
@@ -0,0 +1,159 @@
+#include "pch.h"
+#include "FrustumCulling.h"
+#include <immintrin.h>
+#include <bit>
+#include <array>
+#include <cfloat>
+
+namespace dae
+{
+	namespace
+	{
+		// Radius of the padding spheres, every plane test rejects them
+		constexpr float PaddingRadius{ -FLT_MAX };
+
+		// The six planes with every component splatted across a register
+		template<typename Register, Register(*Splat)(float)>
+		struct SplatPlanes
+		{
+			std::array<Register, 6> normalX{};
+			std::array<Register, 6> normalY{};
+			std::array<Register, 6> normalZ{};
+			std::array<Register, 6> distance{};
+
+			explicit SplatPlanes(const Frustum& frustum)
+			{
+				for (size_t index{ 0 }; index < Frustum::Planes.size(); ++index)
+				{
+					const Plane& plane{ frustum.*Frustum::Planes[index] };
+					normalX[index] = Splat(plane.normal.x);
+					normalY[index] = Splat(plane.normal.y);
+					normalZ[index] = Splat(plane.normal.z);
+					distance[index] = Splat(plane.distance);
+				}
+			}
+		};
+
+#if defined(__AVX__)
+		__m256 Splat8(float value) { return _mm256_set1_ps(value); }
+
+		// Bit n is set when sphere first + n is inside or touching all planes
+		uint32_t CullBatch(const SplatPlanes<__m256, Splat8>& planes, const SphereArray& spheres, uint32_t first)
+		{
+			const __m256 x{ _mm256_loadu_ps(spheres.GetCenterX() + first) };
+			const __m256 y{ _mm256_loadu_ps(spheres.GetCenterY() + first) };
+			const __m256 z{ _mm256_loadu_ps(spheres.GetCenterZ() + first) };
+			const __m256 negativeRadius{ _mm256_sub_ps(_mm256_setzero_ps(), _mm256_loadu_ps(spheres.GetRadius() + first)) };
+
+			__m256 outside{ _mm256_setzero_ps() };
+			for (size_t plane{ 0 }; plane < Frustum::Planes.size(); ++plane)
+			{
+				__m256 distance{ _mm256_add_ps(_mm256_mul_ps(planes.normalX[plane], x), planes.distance[plane]) };
+				distance = _mm256_add_ps(distance, _mm256_mul_ps(planes.normalY[plane], y));
+				distance = _mm256_add_ps(distance, _mm256_mul_ps(planes.normalZ[plane], z));
+				outside = _mm256_or_ps(outside, _mm256_cmp_ps(distance, negativeRadius, _CMP_LT_OQ));
+			}
+
+			return ~static_cast<uint32_t>(_mm256_movemask_ps(outside)) & 0xFFu;
+		}
+#else
+		__m128 Splat4(float value) { return _mm_set1_ps(value); }
+
+		// Two SSE halves of 4 spheres each, bit n is set when sphere first + n is inside or touching all planes
+		uint32_t CullBatch(const SplatPlanes<__m128, Splat4>& planes, const SphereArray& spheres, uint32_t first)
+		{
+			uint32_t visible{ 0 };
+			for (uint32_t half{ 0 }; half < 2; ++half)
+			{
+				const uint32_t offset{ first + half * 4 };
+				const __m128 x{ _mm_loadu_ps(spheres.GetCenterX() + offset) };
+				const __m128 y{ _mm_loadu_ps(spheres.GetCenterY() + offset) };
+				const __m128 z{ _mm_loadu_ps(spheres.GetCenterZ() + offset) };
+				const __m128 negativeRadius{ _mm_sub_ps(_mm_setzero_ps(), _mm_loadu_ps(spheres.GetRadius() + offset)) };
+
+				__m128 outside{ _mm_setzero_ps() };
+				for (size_t plane{ 0 }; plane < Frustum::Planes.size(); ++plane)
+				{
+					__m128 distance{ _mm_add_ps(_mm_mul_ps(planes.normalX[plane], x), planes.distance[plane]) };
+					distance = _mm_add_ps(distance, _mm_mul_ps(planes.normalY[plane], y));
+					distance = _mm_add_ps(distance, _mm_mul_ps(planes.normalZ[plane], z));
+					outside = _mm_or_ps(outside, _mm_cmplt_ps(distance, negativeRadius));
+				}
+
+				visible |= (~static_cast<uint32_t>(_mm_movemask_ps(outside)) & 0xFu) << (half * 4);
+			}
+
+			return visible;
+		}
+#endif
+	}
+
+	void SphereArray::Resize(uint32_t count)
+	{
+		const uint32_t paddedCount{ (count + BatchSize - 1) / BatchSize * BatchSize };
+
+		m_CenterX.resize(paddedCount);
+		m_CenterY.resize(paddedCount);
+		m_CenterZ.resize(paddedCount);
+		m_Radius.resize(paddedCount);
+		std::fill(m_Radius.begin() + count, m_Radius.end(), PaddingRadius);
+
+		m_Count = count;
+	}
+
+	uint32_t SphereArray::Size() const
+	{
+		return m_Count;
+	}
+
+	void SphereArray::Set(uint32_t index, const BoundingSphere& sphere)
+	{
+		m_CenterX[index] = sphere.center.x;
+		m_CenterY[index] = sphere.center.y;
+		m_CenterZ[index] = sphere.center.z;
+		m_Radius[index] = sphere.radius;
+	}
+
+	BoundingSphere SphereArray::Get(uint32_t index) const
+	{
+		return BoundingSphere{ { m_CenterX[index], m_CenterY[index], m_CenterZ[index] }, m_Radius[index] };
+	}
+
+	void FrustumCulling::CullSpheres(const Frustum& frustum, const SphereArray& spheres, std::vector<uint64_t>& visibility)
+	{
+		constexpr uint32_t BatchesPerWord{ 64 / SphereArray::BatchSize };
+
+#if defined(__AVX__)
+		const SplatPlanes<__m256, Splat8> planes{ frustum };
+#else
+		const SplatPlanes<__m128, Splat4> planes{ frustum };
+#endif
+
+		// Padding spheres always fail, so the bits past Size() come out cleared
+		const uint32_t batchCount{ spheres.GetPaddedSize() / SphereArray::BatchSize };
+		visibility.assign((batchCount + BatchesPerWord - 1) / BatchesPerWord, 0);
+
+		for (uint32_t batch{ 0 }; batch < batchCount; ++batch)
+		{
+			const uint64_t visible{ CullBatch(planes, spheres, batch * SphereArray::BatchSize) };
+			visibility[batch / BatchesPerWord] |= visible << (batch % BatchesPerWord * SphereArray::BatchSize);
+		}
+	}
+
+	void FrustumCulling::GetVisibleIndices(const std::vector<uint64_t>& visibility, uint32_t count, std::vector<uint32_t>& indices)
+	{
+		for (uint32_t word{ 0 }; word < visibility.size(); ++word)
+		{
+			uint64_t bits{ visibility[word] };
+			while (bits)
+			{
+				const uint32_t index{ word * 64 + static_cast<uint32_t>(std::countr_zero(bits)) };
+				if (index >= count)
+					return;
+
+				indices.push_back(index);
+				bits &= bits - 1;
+			}
+		}
+	}
+}
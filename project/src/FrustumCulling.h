@@ -0,0 +1,44 @@
+#pragma once
+#include <vector>
+#include <cstdint>
+#include "DataTypes.h"
+
+namespace dae
+{
+	// Bounding spheres in structure of arrays layout, so several can be tested per instruction.
+	// Storage is padded to a whole number of batches with spheres that never pass.
+	class SphereArray final
+	{
+	public:
+		static constexpr uint32_t BatchSize{ 8 };
+
+		void Resize(uint32_t count);
+		uint32_t Size() const;
+
+		void Set(uint32_t index, const BoundingSphere& sphere);
+		BoundingSphere Get(uint32_t index) const;
+
+		const float* GetCenterX() const { return m_CenterX.data(); }
+		const float* GetCenterY() const { return m_CenterY.data(); }
+		const float* GetCenterZ() const { return m_CenterZ.data(); }
+		const float* GetRadius() const { return m_Radius.data(); }
+		uint32_t GetPaddedSize() const { return static_cast<uint32_t>(m_Radius.size()); }
+
+	private:
+		std::vector<float> m_CenterX{};
+		std::vector<float> m_CenterY{};
+		std::vector<float> m_CenterZ{};
+		std::vector<float> m_Radius{};
+		uint32_t m_Count{ 0 };
+	};
+
+	namespace FrustumCulling
+	{
+		// Tests all spheres against the six planes, 8 at a time with AVX and 4 at a time with SSE.
+		// Bit i of visibility (bit i % 64 of word i / 64) is set when sphere i touches the frustum.
+		void CullSpheres(const Frustum& frustum, const SphereArray& spheres, std::vector<uint64_t>& visibility);
+
+		// Appends the index of every set bit below count
+		void GetVisibleIndices(const std::vector<uint64_t>& visibility, uint32_t count, std::vector<uint32_t>& indices);
+	}
+}
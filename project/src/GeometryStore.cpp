@@ -0,0 +1,74 @@
+#include "GeometryStore.h"
+
+namespace dae
+{
+	GeometryHandle GeometryStore::Add(const std::string& name, MeshAsset&& asset, VertexFormat format)
+	{
+		std::lock_guard lock{ m_Mutex };
+
+		std::weak_ptr<const MeshGeometry>& entry{ m_Geometry[name] };
+		if (GeometryHandle existing{ entry.lock() })
+			return existing;
+
+		GeometryHandle geometry{ Create(std::move(asset), format) };
+		entry = geometry;
+		return geometry;
+	}
+
+	GeometryHandle GeometryStore::Find(const std::string& name) const
+	{
+		std::lock_guard lock{ m_Mutex };
+
+		const auto entry{ m_Geometry.find(name) };
+		return entry != m_Geometry.end() ? entry->second.lock() : nullptr;
+	}
+
+	GeometryHandle GeometryStore::Create(MeshAsset&& asset, VertexFormat format)
+	{
+		auto geometry{ std::make_shared<MeshGeometry>() };
+		geometry->vertexFormat = format;
+		geometry->vertices = std::move(asset.vertices);
+		geometry->indices = std::move(asset.indices);
+		geometry->lods = std::move(asset.lods);
+		geometry->subMeshes = std::move(asset.subMeshes);
+
+		// Without a prebuilt LOD chain there is only LOD0, without materials a single submesh
+		if (geometry->lods.empty())
+		{
+			geometry->lods.push_back(MeshLod{ 0, static_cast<uint32_t>(geometry->indices.size()), 0.f });
+		}
+		if (geometry->subMeshes.empty())
+		{
+			geometry->subMeshes.push_back(SubMesh{ 0, geometry->lods });
+		}
+
+		if (!geometry->vertices.empty())
+		{
+			BoundingBox& bounds{ geometry->localBounds };
+			bounds = BoundingBox{ geometry->vertices[0].position, geometry->vertices[0].position };
+			for (const Vertex_In& vertex : geometry->vertices)
+			{
+				bounds.Grow(vertex.position);
+			}
+
+			// Centered on the box, sized by the farthest vertex (tighter than the box diagonal)
+			geometry->localSphere.center = (bounds.min + bounds.max) * 0.5f;
+			float maxSqrDistance{ 0.f };
+			for (const Vertex_In& vertex : geometry->vertices)
+			{
+				maxSqrDistance = std::max(maxSqrDistance, (vertex.position - geometry->localSphere.center).SqrMagnitude());
+			}
+			geometry->localSphere.radius = std::sqrt(maxSqrDistance);
+		}
+
+		// The full precision vertices are dropped once encoded
+		if (format == VertexFormat::Compact)
+		{
+			geometry->quantization = VertexCompression::GetQuantization(geometry->localBounds);
+			VertexCompression::Encode(geometry->vertices, geometry->quantization, geometry->compactVertices);
+			geometry->vertices = std::vector<Vertex_In>{};
+		}
+
+		return geometry;
+	}
+}
@@ -0,0 +1,79 @@
+#pragma once
+#include <memory>
+#include <mutex>
+#include <span>
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include <cstdint>
+#include "DataTypes.h"
+#include "MeshSimplifier.h"
+#include "AssetFormat.h"
+#include "VertexCompression.h"
+
+namespace dae
+{
+	// Vertex and index data of one mesh. Never modified after creation, so meshes, effects
+	// and both render paths can all read the same arrays without copies or locking.
+	struct MeshGeometry
+	{
+		VertexFormat vertexFormat{ VertexFormat::Full };
+
+		// Only one of the two vertex streams is ever filled
+		std::vector<Vertex_In> vertices{};
+		std::vector<Vertex_Compact> compactVertices{};
+		VertexQuantization quantization{};
+
+		// LODs index into indices, all of them share the vertices
+		std::vector<uint32_t> indices{};
+		std::vector<MeshLod> lods{};
+		std::vector<SubMesh> subMeshes{};
+
+		BoundingBox localBounds{};
+		BoundingSphere localSphere{};
+
+		uint32_t GetVertexCount() const
+		{
+			return static_cast<uint32_t>(vertexFormat == VertexFormat::Compact ? compactVertices.size() : vertices.size());
+		}
+
+		// Decodes on the fly for compact geometry
+		Vertex_In GetVertex(uint32_t index) const
+		{
+			return vertexFormat == VertexFormat::Compact ? VertexCompression::Decode(compactVertices[index], quantization) : vertices[index];
+		}
+
+		std::span<const uint32_t> GetIndices(const MeshLod& range) const
+		{
+			return std::span<const uint32_t>{ indices }.subspan(range.startIndex, range.indexCount);
+		}
+	};
+
+	// Shared, read-only reference to geometry, it is freed once the last holder lets go
+	using GeometryHandle = std::shared_ptr<const MeshGeometry>;
+
+	// Hands out one geometry per name, however many meshes ask for it
+	class GeometryStore final
+	{
+	public:
+		GeometryStore() = default;
+		~GeometryStore() = default;
+
+		GeometryStore(const GeometryStore&) = delete;
+		GeometryStore(GeometryStore&&) noexcept = delete;
+		GeometryStore& operator=(const GeometryStore&) = delete;
+		GeometryStore& operator=(GeometryStore&&) noexcept = delete;
+
+		// Takes the asset's arrays over without copying them. A name that is still alive
+		// in the store returns the existing geometry and drops the asset.
+		GeometryHandle Add(const std::string& name, MeshAsset&& asset, VertexFormat format);
+		GeometryHandle Find(const std::string& name) const;
+
+		// Unnamed geometry nobody else can look up (proxies)
+		static GeometryHandle Create(MeshAsset&& asset, VertexFormat format);
+
+	private:
+		mutable std::mutex m_Mutex{};
+		std::unordered_map<std::string, std::weak_ptr<const MeshGeometry>> m_Geometry{};
+	};
+}
@@ -1,6 +1,14 @@
 #pragma once
 #include <cmath>
 
+// Vector4, Matrix and ColorRGB use SSE unless the build asks for the plain scalar versions (DAE_MATH_SCALAR)
+#if !defined(DAE_MATH_SCALAR) && (defined(_M_X64) || defined(__SSE2__))
+#define DAE_MATH_SSE 1
+#include <immintrin.h>
+#else
+#define DAE_MATH_SSE 0
+#endif
+
 namespace dae
 {
 	/* --- HELPER STRUCTS --- */
@@ -1,62 +1,365 @@
 #pragma once
+#include <cassert>
+#include <cmath>
+#include "MathHelpers.h"
 #include "Vector3.h"
 #include "Vector4.h"
 
 namespace dae {
+	// Header only so transforms inline into the vertex and pixel loops. The rows are
+	// Vector4s, products and transforms work on whole rows at once with SSE.
 	struct Matrix
 	{
 		Matrix() = default;
-		Matrix(
+		constexpr Matrix(
 			const Vector3& xAxis,
 			const Vector3& yAxis,
 			const Vector3& zAxis,
-			const Vector3& t);
+			const Vector3& t) :
+			Matrix({ xAxis, 0 }, { yAxis, 0 }, { zAxis, 0 }, { t, 1 })
+		{
+		}
 
-		Matrix(
+		constexpr Matrix(
 			const Vector4& xAxis,
 			const Vector4& yAxis,
 			const Vector4& zAxis,
-			const Vector4& t);
-
-		Matrix(const Matrix& m);
-
-		Vector3 TransformVector(const Vector3& v) const;
-		Vector3 TransformVector(float x, float y, float z) const;
-		Vector3 TransformPoint(const Vector3& p) const;
-		Vector3 TransformPoint(float x, float y, float z) const;
-
-		Vector4 TransformPoint(const Vector4& p) const;
-		Vector4 TransformPoint(float x, float y, float z, float w) const;
-
-		const Matrix& Transpose();
-		const Matrix& Inverse();
-
-		Vector3 GetAxisX() const;
-		Vector3 GetAxisY() const;
-		Vector3 GetAxisZ() const;
-		Vector3 GetTranslation() const;
-
-		static Matrix CreateTranslation(float x, float y, float z);
-		static Matrix CreateTranslation(const Vector3& t);
-		static Matrix CreateRotationX(float pitch);
-		static Matrix CreateRotationY(float yaw);
-		static Matrix CreateRotationZ(float roll);
-		static Matrix CreateRotation(float pitch, float yaw, float roll);
-		static Matrix CreateRotation(const Vector3& r);
-		static Matrix CreateScale(float sx, float sy, float sz);
-		static Matrix CreateScale(const Vector3& s);
-		static Matrix Transpose(const Matrix& m);
-		static Matrix Inverse(const Matrix& m);
-
-		static Matrix CreateLookAtLH(const Vector3& origin, const Vector3& forward, const Vector3& up);
-		static Matrix CreatePerspectiveFovLH(float fovy, float aspect, float zn, float zf);
-
-		Vector4& operator[](int index);
-		Vector4 operator[](int index) const;
-		Matrix operator*(const Matrix& m) const;
-		const Matrix& operator*=(const Matrix& m);
+			const Vector4& t) :
+			data{ xAxis, yAxis, zAxis, t }
+		{
+		}
+
+		constexpr Matrix(const Matrix& m) = default;
+		constexpr Matrix& operator=(const Matrix& m) = default;
+
+		Vector3 TransformVector(const Vector3& v) const
+		{
+			return TransformVector(v.x, v.y, v.z);
+		}
+
+		Vector3 TransformVector(float x, float y, float z) const
+		{
+#if DAE_MATH_SSE
+			return Vector4{ Combine(x, y, z, _mm_setzero_ps()) };
+#else
+			return Vector3{
+				data[0].x * x + data[1].x * y + data[2].x * z,
+				data[0].y * x + data[1].y * y + data[2].y * z,
+				data[0].z * x + data[1].z * y + data[2].z * z
+			};
+#endif
+		}
+
+		Vector3 TransformPoint(const Vector3& p) const
+		{
+			return TransformPoint(p.x, p.y, p.z);
+		}
+
+		Vector3 TransformPoint(float x, float y, float z) const
+		{
+#if DAE_MATH_SSE
+			return Vector4{ Combine(x, y, z, data[3].Load()) };
+#else
+			return Vector3{
+				data[0].x * x + data[1].x * y + data[2].x * z + data[3].x,
+				data[0].y * x + data[1].y * y + data[2].y * z + data[3].y,
+				data[0].z * x + data[1].z * y + data[2].z * z + data[3].z,
+			};
+#endif
+		}
+
+		// w is ignored, the point always gets the translation
+		Vector4 TransformPoint(const Vector4& p) const
+		{
+			return TransformPoint(p.x, p.y, p.z, p.w);
+		}
+
+		Vector4 TransformPoint(float x, float y, float z, float /*w*/) const
+		{
+#if DAE_MATH_SSE
+			return Vector4{ Combine(x, y, z, data[3].Load()) };
+#else
+			return Vector4{
+				data[0].x * x + data[1].x * y + data[2].x * z + data[3].x,
+				data[0].y * x + data[1].y * y + data[2].y * z + data[3].y,
+				data[0].z * x + data[1].z * y + data[2].z * z + data[3].z,
+				data[0].w * x + data[1].w * y + data[2].w * z + data[3].w
+			};
+#endif
+		}
+
+		const Matrix& Transpose()
+		{
+#if DAE_MATH_SSE
+			__m128 row0{ data[0].Load() };
+			__m128 row1{ data[1].Load() };
+			__m128 row2{ data[2].Load() };
+			__m128 row3{ data[3].Load() };
+			_MM_TRANSPOSE4_PS(row0, row1, row2, row3);
+			data[0] = Vector4{ row0 };
+			data[1] = Vector4{ row1 };
+			data[2] = Vector4{ row2 };
+			data[3] = Vector4{ row3 };
+#else
+			Matrix result{};
+			for (int r{ 0 }; r < 4; ++r)
+			{
+				for (int c{ 0 }; c < 4; ++c)
+				{
+					result[r][c] = data[c][r];
+				}
+			}
+
+			data[0] = result[0];
+			data[1] = result[1];
+			data[2] = result[2];
+			data[3] = result[3];
+#endif
+
+			return *this;
+		}
+
+		const Matrix& Inverse()
+		{
+			//Optimized Inverse as explained in FGED1 - used widely in other libraries too.
+			const Vector3 a = data[0];
+			const Vector3 b = data[1];
+			const Vector3 c = data[2];
+			const Vector3 d = data[3];
+
+			const float x = data[0][3];
+			const float y = data[1][3];
+			const float z = data[2][3];
+			const float w = data[3][3];
+
+			Vector3 s = Vector3::Cross(a, b);
+			Vector3 t = Vector3::Cross(c, d);
+			Vector3 u = a * y - b * x;
+			Vector3 v = c * w - d * z;
+
+			const float det = Vector3::Dot(s, v) + Vector3::Dot(t, u);
+			assert((!AreEqual(det, 0.f)) && "ERROR: determinant is 0, there is no INVERSE!");
+			const float invDet = 1.f / det;
+
+			s *= invDet; t *= invDet; u *= invDet; v *= invDet;
+
+			const Vector3 r0 = Vector3::Cross(b, v) + t * y;
+			const Vector3 r1 = Vector3::Cross(v, a) - t * x;
+			const Vector3 r2 = Vector3::Cross(d, u) + s * w;
+			//Vector3 r3 = Vector3::Cross(u, c) - s * z;
+
+			data[0] = Vector4{ r0.x, r1.x, r2.x, 0.f };
+			data[1] = Vector4{ r0.y, r1.y, r2.y, 0.f };
+			data[2] = Vector4{ r0.z, r1.z, r2.z, 0.f };
+			data[3] = { -Vector3::Dot(b, t),Vector3::Dot(a, t),-Vector3::Dot(d, s),Vector3::Dot(c, s) };
+
+			return *this;
+		}
+
+		constexpr Vector3 GetAxisX() const
+		{
+			return data[0];
+		}
+
+		constexpr Vector3 GetAxisY() const
+		{
+			return data[1];
+		}
+
+		constexpr Vector3 GetAxisZ() const
+		{
+			return data[2];
+		}
+
+		constexpr Vector3 GetTranslation() const
+		{
+			return data[3];
+		}
+
+		static constexpr Matrix CreateTranslation(float x, float y, float z)
+		{
+			return CreateTranslation({ x, y, z });
+		}
+
+		static constexpr Matrix CreateTranslation(const Vector3& t)
+		{
+			return { Vector3::UnitX, Vector3::UnitY, Vector3::UnitZ, t };
+		}
+
+		static Matrix CreateRotationX(float pitch)
+		{
+			return {
+				{1, 0, 0, 0},
+				{0, std::cos(pitch), -std::sin(pitch), 0},
+				{0, std::sin(pitch), std::cos(pitch), 0},
+				{0, 0, 0, 1}
+			};
+		}
+
+		static Matrix CreateRotationY(float yaw)
+		{
+			return {
+				{std::cos(yaw), 0, -std::sin(yaw), 0},
+				{0, 1, 0, 0},
+				{std::sin(yaw), 0, std::cos(yaw), 0},
+				{0, 0, 0, 1}
+			};
+		}
+
+		static Matrix CreateRotationZ(float roll)
+		{
+			return {
+				{std::cos(roll), std::sin(roll), 0, 0},
+				{-std::sin(roll), std::cos(roll), 0, 0},
+				{0, 0, 1, 0},
+				{0, 0, 0, 1}
+			};
+		}
+
+		static Matrix CreateRotation(float pitch, float yaw, float roll)
+		{
+			return CreateRotation({ pitch, yaw, roll });
+		}
+
+		static Matrix CreateRotation(const Vector3& r)
+		{
+			return CreateRotationX(r[0]) * CreateRotationY(r[1]) * CreateRotationZ(r[2]);
+		}
+
+		static constexpr Matrix CreateScale(float sx, float sy, float sz)
+		{
+			return { Vector3{sx, 0, 0}, Vector3{0, sy, 0}, Vector3{0, 0, sz}, Vector3::Zero };
+		}
+
+		static constexpr Matrix CreateScale(const Vector3& s)
+		{
+			return CreateScale(s[0], s[1], s[2]);
+		}
+
+		static Matrix Transpose(const Matrix& m)
+		{
+			Matrix out{ m };
+			out.Transpose();
+
+			return out;
+		}
+
+		static Matrix Inverse(const Matrix& m)
+		{
+			Matrix out{ m };
+			out.Inverse();
+
+			return out;
+		}
+
+		static Matrix CreateLookAtLH(const Vector3& origin, const Vector3& forward, const Vector3& up)
+		{
+			// Calculate the right vector (perpendicular to both the up and forward vectors)
+			Vector3 right = Vector3::Cross(up, forward).Normalized();
+
+			// Recalculate the true up vector (perpendicular to both right and forward vectors)
+			Vector3 trueUp = Vector3::Cross(forward, right).Normalized();
+
+			// Create the rotation part of the matrix (3x3)
+			Matrix rotation;
+			rotation[0] = Vector4{ right.x, right.y, right.z, 0.f };
+			rotation[1] = Vector4{ trueUp.x, trueUp.y, trueUp.z, 0.f };
+			rotation[2] = Vector4{ -forward.x, -forward.y, -forward.z, 0.f };
+			rotation[3] = Vector4{ 0.f, 0.f, 0.f, 1.f };
+
+			// Create the translation part of the matrix (3x1)
+			Matrix translation;
+			translation[0] = Vector4{ -Vector3::Dot(right, origin), -Vector3::Dot(trueUp, origin), Vector3::Dot(forward, origin), 1.f };
+
+			// Combine the rotation and translation to form the final look-at matrix
+			return rotation * translation;
+		}
+
+		static constexpr Matrix CreatePerspectiveFovLH(float fov, float aspect, float zn, float zf)
+		{
+			return Matrix
+			{
+				Vector4{1.f / (aspect * fov), 0, 0, 0},
+				Vector4{0, 1.f / fov, 0, 0},
+				Vector4{0, 0, zf / (zf - zn), 1.f},
+				Vector4{0, 0, -(zf * zn) / (zf - zn), 0}
+			};
+		}
+
+		static constexpr Matrix CreateOrthographicLH(float width, float height, float zn, float zf)
+		{
+			return Matrix
+			{
+				Vector4{2.f / width, 0, 0, 0},
+				Vector4{0, 2.f / height, 0, 0},
+				Vector4{0, 0, 1.f / (zf - zn), 0},
+				Vector4{0, 0, -zn / (zf - zn), 1.f}
+			};
+		}
+
+		constexpr Vector4& operator[](int index)
+		{
+			assert(index <= 3 && index >= 0);
+			return data[index];
+		}
+
+		constexpr Vector4 operator[](int index) const
+		{
+			assert(index <= 3 && index >= 0);
+			return data[index];
+		}
+
+		Matrix operator*(const Matrix& m) const
+		{
+			Matrix result{ *this };
+			result *= m;
+			return result;
+		}
+
+		const Matrix& operator*=(const Matrix& m)
+		{
+#if DAE_MATH_SSE
+			// Row r of the product is the rows of m weighted by the elements of row r
+			const __m128 row0{ m.data[0].Load() };
+			const __m128 row1{ m.data[1].Load() };
+			const __m128 row2{ m.data[2].Load() };
+			const __m128 row3{ m.data[3].Load() };
+
+			for (Vector4& row : data)
+			{
+				const __m128 weights{ row.Load() };
+				__m128 sum{ _mm_mul_ps(_mm_shuffle_ps(weights, weights, _MM_SHUFFLE(0, 0, 0, 0)), row0) };
+				sum = _mm_add_ps(sum, _mm_mul_ps(_mm_shuffle_ps(weights, weights, _MM_SHUFFLE(1, 1, 1, 1)), row1));
+				sum = _mm_add_ps(sum, _mm_mul_ps(_mm_shuffle_ps(weights, weights, _MM_SHUFFLE(2, 2, 2, 2)), row2));
+				sum = _mm_add_ps(sum, _mm_mul_ps(_mm_shuffle_ps(weights, weights, _MM_SHUFFLE(3, 3, 3, 3)), row3));
+				row = Vector4{ sum };
+			}
+#else
+			Matrix copy{ *this };
+			Matrix m_transposed = Transpose(m);
+
+			for (int r{ 0 }; r < 4; ++r)
+			{
+				for (int c{ 0 }; c < 4; ++c)
+				{
+					data[r][c] = Vector4::Dot(copy[r], m_transposed[c]);
+				}
+			}
+#endif
+
+			return *this;
+		}
 
 	private:
+#if DAE_MATH_SSE
+		// x * row0 + y * row1 + z * row2 + last
+		__m128 Combine(float x, float y, float z, __m128 last) const
+		{
+			__m128 sum{ _mm_add_ps(_mm_mul_ps(_mm_set1_ps(x), data[0].Load()), last) };
+			sum = _mm_add_ps(sum, _mm_mul_ps(_mm_set1_ps(y), data[1].Load()));
+			return _mm_add_ps(sum, _mm_mul_ps(_mm_set1_ps(z), data[2].Load()));
+		}
+#endif
 
 		//Row-Major Matrix
 		Vector4 data[4]
@@ -72,4 +375,4 @@ namespace dae {
 		// v2x v2y v2z v2w
 		// v3x v3y v3z v3w
 	};
-}
\ No newline at end of file
+}
@@ -8,14 +8,15 @@
 #include "Utils.h"
 #include <algorithm>
 #include <execution>
+#include <cfloat>
 #include "Camera.h"
 #include <iostream>
 
 
-Mesh::Mesh(ID3D11Device* pDevice, std::vector<dae::Vertex_In> vertices, std::vector<uint32_t> indices, std::string* texturesPaths, bool onlyDiffuse, Effect* pEffect):
+Mesh::Mesh(ID3D11Device* pDevice, dae::GeometryHandle geometry, const dae::Material& defaultMaterial, Effect* pEffect):
+	m_pGeometry{ std::move(geometry) },
 	m_pEffect{ pEffect },
-	m_Vertices{vertices},
-	m_Indices{indices},
+	m_DefaultMaterial{ defaultMaterial },
 	m_RasterizerStateBack{nullptr},
 	m_RasterizerStateFront{nullptr},
 	m_RasterizerStateNone{nullptr},
@@ -28,26 +29,8 @@ Mesh::Mesh(ID3D11Device* pDevice, std::vector<dae::Vertex_In> vertices, std::vec
 	
 	HRESULT result;
 
-	m_pDiffuseMap = dae::Texture::LoadFromFile(texturesPaths[0], pDevice);
-	m_pEffect->SetDiffuseMap(m_pDiffuseMap.get());
-
-	if (!onlyDiffuse && !texturesPaths[1].empty())
-	{
-		m_pNormalMap = dae::Texture::LoadFromFile(texturesPaths[1], pDevice);
-		m_pEffect->SetNormalMap(m_pNormalMap.get());
-	}
-
-	if (!onlyDiffuse && !texturesPaths[2].empty())
-	{
-		m_pSpecularMap = dae::Texture::LoadFromFile(texturesPaths[2], pDevice);
-		m_pEffect->SetSpecularMap(m_pSpecularMap.get());
-	}
-
-	if (!onlyDiffuse && !texturesPaths[3].empty())
-	{
-		m_pGlossinessMap = dae::Texture::LoadFromFile(texturesPaths[3], pDevice);
-		m_pEffect->SetGlossinessMap(m_pGlossinessMap.get());
-	}
+	SortDrawOrder();
+	SetWorldMatrix(m_WorldMatrix);
 
 	D3D11_RASTERIZER_DESC rasterizerDescBack{};
 	ZeroMemory(&rasterizerDescBack, sizeof(D3D11_RASTERIZER_DESC));
@@ -81,33 +64,7 @@ Mesh::Mesh(ID3D11Device* pDevice, std::vector<dae::Vertex_In> vertices, std::vec
 
 	m_CurrentRastizerState = m_RasterizerStateBack;
 
-	// Create vertex Buffer
-	D3D11_BUFFER_DESC bd{};
-	bd.Usage = D3D11_USAGE_IMMUTABLE;
-	bd.ByteWidth = sizeof(dae::Vertex_In) * static_cast<uint32_t>(vertices.size());
-	bd.BindFlags = D3D11_BIND_VERTEX_BUFFER;
-	bd.CPUAccessFlags = 0;
-	bd.MiscFlags = 0;
-
-	D3D11_SUBRESOURCE_DATA initData{};
-	initData.pSysMem = vertices.data();
-
-	result = pDevice->CreateBuffer(&bd, &initData, &m_pVertexBuffer);
-	if (FAILED(result))
-		return;
-
-	// Create index buffer
-	m_NumIndices = static_cast<uint32_t>(indices.size());
-	bd.Usage = D3D11_USAGE_IMMUTABLE;
-	bd.ByteWidth = sizeof(uint32_t) * m_NumIndices;
-	bd.BindFlags = D3D11_BIND_INDEX_BUFFER;
-	bd.CPUAccessFlags = 0;
-	bd.MiscFlags = 0;
-	initData.pSysMem = indices.data();
-	result = pDevice->CreateBuffer(&bd, &initData, &m_pIndexBuffer);
-
-	if (FAILED(result))
-		return;
+	CreateBuffers(pDevice);
 }
 
 Mesh::~Mesh()
@@ -116,55 +73,161 @@ Mesh::~Mesh()
 	m_RasterizerStateFront->Release();
 	m_RasterizerStateNone->Release();
 
-	m_pDiffuseMap.reset();
-	m_pNormalMap.reset();
-	m_pSpecularMap.reset();
-	m_pGlossinessMap.reset();
-
 	if (m_pVertexBuffer) m_pVertexBuffer->Release();
 	if (m_pIndexBuffer) m_pIndexBuffer->Release();
+	if (m_pInstanceBuffer) m_pInstanceBuffer->Release();
 
 	delete m_pEffect;
 }
 
-void Mesh::Render_DirectX(ID3D11DeviceContext* pDeviceContext, dae::Camera* camera)
+void Mesh::Render_DirectX(ID3D11DeviceContext* pDeviceContext, dae::Camera* camera, const dae::Frustum& frustum, const dae::OcclusionBuffer* pOcclusion)
 {
+	GatherVisibleInstances(frustum, m_VisibleInstances, pOcclusion);
+	if (m_VisibleInstances.empty() || FAILED(UploadInstances(pDeviceContext, m_VisibleInstances)))
+		return;
+
 	pDeviceContext->RSSetState(m_CurrentRastizerState);
 
 	//1. Set Primitive Topology
 	pDeviceContext->IASetPrimitiveTopology(D3D11_PRIMITIVE_TOPOLOGY_TRIANGLELIST);
 
+	const bool isCompact{ m_pGeometry->vertexFormat == dae::VertexFormat::Compact };
+
 	//2. Set Input Layout
-	pDeviceContext->IASetInputLayout(m_pEffect->GetInputLayout());
+	pDeviceContext->IASetInputLayout(m_pEffect->GetInputLayout(m_pGeometry->vertexFormat));
 
-	//3. Set VertexBuffer
-	constexpr UINT stride{ sizeof(dae::Vertex_In) };
-	constexpr UINT offset{ 0 };
-	pDeviceContext->IASetVertexBuffers(0, 1, &m_pVertexBuffer, &stride, &offset);
+	//3. Set VertexBuffers, the instance matrices go in the second slot
+	ID3D11Buffer* const buffers[2]{ m_pVertexBuffer, m_pInstanceBuffer };
+	const UINT strides[2]{ isCompact ? sizeof(dae::Vertex_Compact) : sizeof(dae::Vertex_In), sizeof(dae::Matrix) };
+	constexpr UINT offsets[2]{ 0, 0 };
+	pDeviceContext->IASetVertexBuffers(0, 2, buffers, strides, offsets);
 
 	dae::Matrix view{ camera->invViewMatrix };
 	dae::Matrix proj{ camera->ProjectionMatrix };
-	const dae::Matrix worldViewProjectionMatrix{ WorldMatrix * view * proj };
+	const dae::Matrix viewProjectionMatrix{ view * proj };
 
-	m_pEffect->SetMatricis(worldViewProjectionMatrix, WorldMatrix, camera->origin);
+	m_pEffect->SetMatricis(viewProjectionMatrix, m_WorldMatrix, camera->origin);
+	m_pEffect->SetVertexDecode(isCompact, m_pGeometry->quantization);
 
 	//4. Set IndexBuffer
-	pDeviceContext->IASetIndexBuffer(m_pIndexBuffer, DXGI_FORMAT_R32_UINT, 0);
-
-	pDeviceContext->GenerateMips(m_pDiffuseMap->GetShaderResourceView());
+	pDeviceContext->IASetIndexBuffer(m_pIndexBuffer, m_IndexFormat, 0);
 
-	//5. Draw
+	//5. Draw, one call per submesh, maps only get rebound when they change
 	D3DX11_TECHNIQUE_DESC techDesc{};
 	m_pEffect->GetTechnique()->GetDesc(&techDesc);
-	for (UINT p{ 0 }; p < techDesc.Passes; ++p)
+
+	const dae::Material* pBound{ nullptr };
+	for (const uint32_t subMeshIndex : m_DrawOrder)
 	{
-		m_pEffect->GetTechnique()->GetPassByIndex(p)->Apply(0, pDeviceContext);
-		pDeviceContext->DrawIndexed(m_NumIndices, 0, 0);
+		const dae::SubMesh& subMesh{ m_pGeometry->subMeshes[subMeshIndex] };
+		const dae::MeshLod& range{ subMesh.lods[m_ActiveLod] };
+		if (range.indexCount == 0)
+			continue;
+
+		const dae::Material& material{ GetMaterial(subMesh.material) };
+		if (!pBound || *pBound != material)
+		{
+			m_pEffect->SetDiffuseMap(material.pDiffuseMap);
+			m_pEffect->SetNormalMap(material.pNormalMap);
+			m_pEffect->SetSpecularMap(material.pSpecularMap);
+			m_pEffect->SetGlossinessMap(material.pGlossinessMap);
+			pBound = &material;
+		}
+
+		for (UINT p{ 0 }; p < techDesc.Passes; ++p)
+		{
+			m_pEffect->GetTechnique()->GetPassByIndex(p)->Apply(0, pDeviceContext);
+			pDeviceContext->DrawIndexedInstanced(range.indexCount, static_cast<UINT>(m_VisibleInstances.size()), range.startIndex, 0, 0);
+		}
 	}
 }
 
 
 
+HRESULT Mesh::CreateBuffers(ID3D11Device* pDevice)
+{
+	HRESULT result;
+
+	const dae::MeshGeometry& geometry{ *m_pGeometry };
+	const bool isCompact{ geometry.vertexFormat == dae::VertexFormat::Compact };
+	const uint32_t vertexCount{ geometry.GetVertexCount() };
+
+	// Create vertex Buffer
+	D3D11_BUFFER_DESC bd{};
+	bd.Usage = D3D11_USAGE_IMMUTABLE;
+	bd.ByteWidth = (isCompact ? sizeof(dae::Vertex_Compact) : sizeof(dae::Vertex_In)) * vertexCount;
+	bd.BindFlags = D3D11_BIND_VERTEX_BUFFER;
+	bd.CPUAccessFlags = 0;
+	bd.MiscFlags = 0;
+
+	D3D11_SUBRESOURCE_DATA initData{};
+	initData.pSysMem = isCompact ? static_cast<const void*>(geometry.compactVertices.data()) : static_cast<const void*>(geometry.vertices.data());
+
+	result = pDevice->CreateBuffer(&bd, &initData, &m_pVertexBuffer);
+	if (FAILED(result))
+		return result;
+
+	// Create index buffer, narrowed to 16 bit for compact meshes that fit (the CPU copy stays 32 bit)
+	m_NumIndices = static_cast<uint32_t>(geometry.indices.size());
+	m_IndexFormat = isCompact && vertexCount <= UINT16_MAX + 1u ? DXGI_FORMAT_R16_UINT : DXGI_FORMAT_R32_UINT;
+
+	std::vector<uint16_t> shortIndices{};
+	if (m_IndexFormat == DXGI_FORMAT_R16_UINT)
+	{
+		shortIndices.assign(geometry.indices.begin(), geometry.indices.end());
+	}
+
+	bd.Usage = D3D11_USAGE_IMMUTABLE;
+	bd.ByteWidth = (m_IndexFormat == DXGI_FORMAT_R16_UINT ? sizeof(uint16_t) : sizeof(uint32_t)) * m_NumIndices;
+	bd.BindFlags = D3D11_BIND_INDEX_BUFFER;
+	bd.CPUAccessFlags = 0;
+	bd.MiscFlags = 0;
+	initData.pSysMem = shortIndices.empty() ? static_cast<const void*>(geometry.indices.data()) : static_cast<const void*>(shortIndices.data());
+	result = pDevice->CreateBuffer(&bd, &initData, &m_pIndexBuffer);
+
+	if (FAILED(result))
+		return result;
+
+	return result;
+}
+
+void Mesh::SetGeometry(ID3D11Device* pDevice, dae::GeometryHandle geometry)
+{
+	if (m_pVertexBuffer) m_pVertexBuffer->Release();
+	if (m_pIndexBuffer) m_pIndexBuffer->Release();
+	m_pVertexBuffer = nullptr;
+	m_pIndexBuffer = nullptr;
+
+	m_pGeometry = std::move(geometry);
+	m_ActiveLod = 0;
+	SortDrawOrder();
+	SetWorldMatrix(m_WorldMatrix);
+
+	CreateBuffers(pDevice);
+}
+
+void Mesh::SetMaterials(std::vector<dae::Material> materials)
+{
+	m_Materials = std::move(materials);
+	SortDrawOrder();
+}
+
+void Mesh::SortDrawOrder()
+{
+	const std::vector<dae::SubMesh>& subMeshes{ m_pGeometry->subMeshes };
+
+	m_DrawOrder.resize(subMeshes.size());
+	for (uint32_t subMesh{ 0 }; subMesh < m_DrawOrder.size(); ++subMesh)
+	{
+		m_DrawOrder[subMesh] = subMesh;
+	}
+
+	std::stable_sort(m_DrawOrder.begin(), m_DrawOrder.end(), [this, &subMeshes](uint32_t a, uint32_t b)
+		{
+			return GetMaterial(subMeshes[a].material) < GetMaterial(subMeshes[b].material);
+		});
+}
+
 void Mesh::SetSamplerState(Effect::SampleState samplerState)
 {
 	m_pEffect->SetTechnique(samplerState);
@@ -188,23 +251,264 @@ void Mesh::SetCullingMode(dae::CullMode cullmode)
 	}
 }
 
-dae::Texture* Mesh::GetDiffuseMap() const
+HRESULT Mesh::UploadInstances(ID3D11DeviceContext* pDeviceContext, const std::vector<uint32_t>& instances)
+{
+	if (instances.size() > m_InstanceCapacity)
+	{
+		if (m_pInstanceBuffer) m_pInstanceBuffer->Release();
+		m_pInstanceBuffer = nullptr;
+		m_InstanceCapacity = 0;
+
+		ID3D11Device* pDevice{ nullptr };
+		pDeviceContext->GetDevice(&pDevice);
+
+		// Room for all instances, so it only grows when the list itself does
+		const uint32_t capacity{ static_cast<uint32_t>(m_Instances.size()) };
+
+		D3D11_BUFFER_DESC bd{};
+		bd.Usage = D3D11_USAGE_DYNAMIC;
+		bd.ByteWidth = sizeof(dae::Matrix) * capacity;
+		bd.BindFlags = D3D11_BIND_VERTEX_BUFFER;
+		bd.CPUAccessFlags = D3D11_CPU_ACCESS_WRITE;
+		bd.MiscFlags = 0;
+
+		const HRESULT result{ pDevice->CreateBuffer(&bd, nullptr, &m_pInstanceBuffer) };
+		pDevice->Release();
+		if (FAILED(result))
+			return result;
+
+		m_InstanceCapacity = capacity;
+	}
+
+	D3D11_MAPPED_SUBRESOURCE mapped{};
+	const HRESULT result{ pDeviceContext->Map(m_pInstanceBuffer, 0, D3D11_MAP_WRITE_DISCARD, 0, &mapped) };
+	if (FAILED(result))
+		return result;
+
+	dae::Matrix* pMatrices{ static_cast<dae::Matrix*>(mapped.pData) };
+	for (size_t index{ 0 }; index < instances.size(); ++index)
+	{
+		pMatrices[index] = m_Instances[instances[index]];
+	}
+
+	pDeviceContext->Unmap(m_pInstanceBuffer, 0);
+	return S_OK;
+}
+
+void Mesh::SetWorldMatrix(const dae::Matrix& worldMatrix)
+{
+	m_WorldMatrix = worldMatrix;
+	++m_WorldVersion;
+
+	UpdateWorldBounds();
+}
+
+void Mesh::SetInstances(std::vector<dae::Matrix> instances)
+{
+	m_HasInstances = !instances.empty();
+	m_Instances = m_HasInstances ? std::move(instances) : std::vector<dae::Matrix>{ dae::Matrix{} };
+
+	UpdateWorldBounds();
+}
+
+bool Mesh::HasInstances() const
+{
+	return m_HasInstances;
+}
+
+uint32_t Mesh::GetInstanceCount() const
+{
+	return static_cast<uint32_t>(m_Instances.size());
+}
+
+const dae::Matrix& Mesh::GetInstance(uint32_t instance) const
+{
+	return m_Instances[instance];
+}
+
+void Mesh::GatherVisibleInstances(const dae::Frustum& frustum, std::vector<uint32_t>& instances, const dae::OcclusionBuffer* pOcclusion) const
+{
+	instances.clear();
+	dae::FrustumCulling::CullSpheres(frustum, m_InstanceSpheres, m_InstanceVisibility);
+	dae::FrustumCulling::GetVisibleIndices(m_InstanceVisibility, m_InstanceSpheres.Size(), instances);
+
+	if (pOcclusion)
+	{
+		std::erase_if(instances, [this, pOcclusion](uint32_t instance) { return !pOcclusion->IsVisible(m_InstanceSpheres.Get(instance)); });
+	}
+}
+
+dae::BoundingSphere Mesh::GetInstanceSphere(uint32_t instance) const
+{
+	return m_InstanceSpheres.Get(instance);
+}
+
+void Mesh::UpdateWorldBounds()
+{
+	const dae::BoundingBox& localBounds{ m_pGeometry->localBounds };
+	const dae::BoundingSphere& localSphere{ m_pGeometry->localSphere };
+
+	// Transformed box extents (Arvo), the sphere grows with the largest axis scale
+	const dae::Vector3 localCenter{ (localBounds.min + localBounds.max) * 0.5f };
+	const dae::Vector3 localExtent{ (localBounds.max - localBounds.min) * 0.5f };
+	const dae::Vector3 worldCenter{ m_WorldMatrix.TransformPoint(localCenter) };
+
+	dae::Vector3 worldExtent{};
+	float maxScale{ 0.f };
+	for (int axis{ 0 }; axis < 3; ++axis)
+	{
+		const dae::Vector3 row{ m_WorldMatrix[axis] };
+		worldExtent.x += std::abs(row.x) * localExtent[axis];
+		worldExtent.y += std::abs(row.y) * localExtent[axis];
+		worldExtent.z += std::abs(row.z) * localExtent[axis];
+		maxScale = std::max(maxScale, row.Magnitude());
+	}
+
+	const dae::BoundingSphere meshSphere{ m_WorldMatrix.TransformPoint(localSphere.center), localSphere.radius * maxScale };
+
+	// Same again for every instance, on top of the mesh's own world bounds
+	m_InstanceSpheres.Resize(static_cast<uint32_t>(m_Instances.size()));
+	for (uint32_t instance{ 0 }; instance < m_Instances.size(); ++instance)
+	{
+		const dae::Matrix& instanceMatrix{ m_Instances[instance] };
+		const dae::Vector3 instanceCenter{ instanceMatrix.TransformPoint(worldCenter) };
+
+		dae::Vector3 instanceExtent{};
+		float instanceScale{ 0.f };
+		for (int axis{ 0 }; axis < 3; ++axis)
+		{
+			const dae::Vector3 row{ instanceMatrix[axis] };
+			instanceExtent.x += std::abs(row.x) * worldExtent[axis];
+			instanceExtent.y += std::abs(row.y) * worldExtent[axis];
+			instanceExtent.z += std::abs(row.z) * worldExtent[axis];
+			instanceScale = std::max(instanceScale, row.Magnitude());
+		}
+
+		if (instance == 0)
+		{
+			m_WorldBounds = dae::BoundingBox{ instanceCenter - instanceExtent, instanceCenter + instanceExtent };
+		}
+		m_WorldBounds.Grow(instanceCenter - instanceExtent);
+		m_WorldBounds.Grow(instanceCenter + instanceExtent);
+
+		m_InstanceSpheres.Set(instance, dae::BoundingSphere{ instanceMatrix.TransformPoint(meshSphere.center), meshSphere.radius * instanceScale });
+	}
+
+	// Around the instance spheres, centered on the box that holds them
+	m_WorldSphere = dae::BoundingSphere{ (m_WorldBounds.min + m_WorldBounds.max) * 0.5f, 0.f };
+	for (uint32_t instance{ 0 }; instance < m_InstanceSpheres.Size(); ++instance)
+	{
+		const dae::BoundingSphere sphere{ m_InstanceSpheres.Get(instance) };
+		m_WorldSphere.radius = std::max(m_WorldSphere.radius, (sphere.center - m_WorldSphere.center).Magnitude() + sphere.radius);
+	}
+}
+
+const dae::MeshGeometry& Mesh::GetGeometry() const
+{
+	return *m_pGeometry;
+}
+
+const dae::Matrix& Mesh::GetWorldMatrix() const
+{
+	return m_WorldMatrix;
+}
+
+uint64_t Mesh::GetWorldVersion() const
+{
+	return m_WorldVersion;
+}
+
+void Mesh::UpdateWorldVertices()
+{
+	if (m_WorldVerticesVersion == m_WorldVersion)
+		return;
+
+	const dae::MeshGeometry& geometry{ *m_pGeometry };
+	m_WorldVertices.resize(geometry.GetVertexCount());
+
+	// Compact vertices get decoded once here instead of per triangle every frame
+	std::for_each(std::execution::par_unseq, m_WorldVertices.begin(), m_WorldVertices.end(), [this, &geometry](dae::Vertex_In& worldVertex)
+		{
+			const uint32_t index{ static_cast<uint32_t>(&worldVertex - m_WorldVertices.data()) };
+			worldVertex = ToWorldSpace(geometry.GetVertex(index), m_WorldMatrix);
+		});
+
+	m_WorldVerticesVersion = m_WorldVersion;
+}
+
+const std::vector<dae::Vertex_In>& Mesh::GetWorldVertices() const
+{
+	return m_WorldVertices;
+}
+
+dae::Vertex_In Mesh::ToWorldSpace(const dae::Vertex_In& vertex, const dae::Matrix& worldMatrix)
+{
+	dae::Vertex_In worldVertex{ vertex };
+	worldVertex.position = worldMatrix.TransformPoint(vertex.position);
+	worldVertex.normal = worldMatrix.TransformVector(vertex.normal).Normalized();
+	worldVertex.tangent = worldMatrix.TransformVector(vertex.tangent).Normalized();
+	return worldVertex;
+}
+
+const dae::BoundingBox& Mesh::GetWorldBounds() const
+{
+	return m_WorldBounds;
+}
+
+const dae::BoundingSphere& Mesh::GetWorldSphere() const
+{
+	return m_WorldSphere;
+}
+
+bool Mesh::IsVisible(const dae::Frustum& frustum) const
+{
+	return frustum.IntersectsSphere(m_WorldSphere);
+}
+
+void Mesh::UpdateLod(const dae::Camera& camera, float screenHeight)
+{
+	// Pick the coarsest LOD whose error still projects to less than m_LodPixelError pixels on the nearest instance
+	float distance{ FLT_MAX };
+	for (uint32_t instance{ 0 }; instance < m_InstanceSpheres.Size(); ++instance)
+	{
+		const dae::BoundingSphere sphere{ m_InstanceSpheres.Get(instance) };
+		distance = std::min(distance, std::max((sphere.center - camera.origin).Magnitude() - sphere.radius, 0.0001f));
+	}
+	const float pixelsPerUnit{ screenHeight / (2.f * camera.fov * distance) };
+
+	m_ActiveLod = 0;
+	const std::vector<dae::MeshLod>& lods{ m_pGeometry->lods };
+	for (uint32_t lod{ 1 }; lod < lods.size(); ++lod)
+	{
+		if (lods[lod].geometricError * pixelsPerUnit > m_LodPixelError)
+			break;
+
+		m_ActiveLod = lod;
+	}
+}
+
+const dae::MeshLod& Mesh::GetActiveLod() const
+{
+	return m_pGeometry->lods[m_ActiveLod];
+}
+
+uint32_t Mesh::GetActiveLodIndex() const
 {
-	return m_pDiffuseMap.get();
+	return m_ActiveLod;
 }
 
-dae::Texture* Mesh::GetNormalMap() const
+const std::vector<dae::MeshLod>& Mesh::GetLods() const
 {
-	return m_pNormalMap.get();
+	return m_pGeometry->lods;
 }
 
-dae::Texture* Mesh::GetSpecularMap() const
+const std::vector<dae::SubMesh>& Mesh::GetSubMeshes() const
 {
-	return m_pSpecularMap.get();
+	return m_pGeometry->subMeshes;
 }
 
-dae::Texture* Mesh::GetGlossinessMap() const
+const dae::Material& Mesh::GetMaterial(uint32_t material) const
 {
-	return m_pGlossinessMap.get();
+	return material < m_Materials.size() ? m_Materials[material] : m_DefaultMaterial;
 }
 
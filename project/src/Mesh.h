@@ -5,6 +5,11 @@
 #include "Texture.h"
 #include "DataTypes.h"
 #include "Effect.h"
+#include "MeshSimplifier.h"
+#include "AssetLoader.h"
+#include "GeometryStore.h"
+#include "FrustumCulling.h"
+#include "OcclusionBuffer.h"
 
 
 struct ID3D11Device;
@@ -14,26 +19,92 @@ struct Matrix;
 class Mesh final
 {
 public:
-	Mesh(ID3D11Device* pDevice, std::vector<dae::Vertex_In> vertices, std::vector<uint32_t> indices, std::string* texturesPaths, bool onlyDiffuse, Effect* pEffect);
+	Mesh(ID3D11Device* pDevice, dae::GeometryHandle geometry, const dae::Material& defaultMaterial, Effect* pEffect);
 	~Mesh();
 
-	void Render_DirectX(ID3D11DeviceContext* pDeviceContext, dae::Camera* camera);
+	Mesh(const Mesh&) = delete;
+	Mesh(Mesh&&) noexcept = delete;
+	Mesh& operator=(const Mesh&) = delete;
+	Mesh& operator=(Mesh&&) noexcept = delete;
+
+	// One instanced draw per submesh, covering every instance inside the frustum and not occluded
+	void Render_DirectX(ID3D11DeviceContext* pDeviceContext, dae::Camera* camera, const dae::Frustum& frustum, const dae::OcclusionBuffer* pOcclusion = nullptr);
 	//void Render_Software(float aspectRatio, float width, float height, dae::Camera* pCamera, const dae::Frustum& frustum, SDL_Surface* pBackBuffer, uint32_t* pBackBufferPixels, float* pDepthBufferArr);
 
 	void SetSamplerState(Effect::SampleState samplerState);
 	void SetCullingMode(dae::CullMode cullmode);
 
-	dae::Texture* GetDiffuseMap() const;
-	dae::Texture* GetNormalMap() const;
-	dae::Texture* GetSpecularMap() const;
-	dae::Texture* GetGlossinessMap() const;
+	// Used by streaming to replace a proxy with the real asset between frames
+	void SetGeometry(ID3D11Device* pDevice, dae::GeometryHandle geometry);
+	// Indexed by SubMesh::material, materials without an entry use the default material
+	void SetMaterials(std::vector<dae::Material> materials);
+
+	void SetWorldMatrix(const dae::Matrix& worldMatrix);
+	const dae::Matrix& GetWorldMatrix() const;
+	// Bumped by every SetWorldMatrix and SetGeometry
+	uint64_t GetWorldVersion() const;
+
+	// Software rendering only: the vertices with position, normal and tangent in world space.
+	// Rebuilt when the world version changed since the last update, so static meshes are transformed once.
+	void UpdateWorldVertices();
+	const std::vector<dae::Vertex_In>& GetWorldVertices() const;
+	static dae::Vertex_In ToWorldSpace(const dae::Vertex_In& vertex, const dae::Matrix& worldMatrix);
+
+	// Copies of the mesh drawn together, each one moved in world space by its matrix
+	// (world position = position * worldMatrix * instance). An empty list draws the mesh once.
+	void SetInstances(std::vector<dae::Matrix> instances);
+	bool HasInstances() const;
+	uint32_t GetInstanceCount() const;
+	const dae::Matrix& GetInstance(uint32_t instance) const;
+	// Instances whose bounding sphere touches the frustum and, when given, is not hidden behind the occluders
+	void GatherVisibleInstances(const dae::Frustum& frustum, std::vector<uint32_t>& instances, const dae::OcclusionBuffer* pOcclusion = nullptr) const;
+	dae::BoundingSphere GetInstanceSphere(uint32_t instance) const;
+
+	// Cover all instances
+	const dae::BoundingBox& GetWorldBounds() const;
+	const dae::BoundingSphere& GetWorldSphere() const;
+	bool IsVisible(const dae::Frustum& frustum) const;
+
+	void UpdateLod(const dae::Camera& camera, float screenHeight);
+	const dae::MeshLod& GetActiveLod() const;
+	uint32_t GetActiveLodIndex() const;
+	const std::vector<dae::MeshLod>& GetLods() const;
+
+	const dae::MeshGeometry& GetGeometry() const;
+
+	const std::vector<dae::SubMesh>& GetSubMeshes() const;
+	const dae::Material& GetMaterial(uint32_t material) const;
 
-	dae::Matrix WorldMatrix;
 	dae::PrimitiveTopology m_PrimitiveTopology{ dae::PrimitiveTopology::TriangleList };
 
-	std::vector<dae::Vertex_In> m_Vertices{};
-	std::vector<uint32_t> m_Indices{};
 private:
+	void SortDrawOrder();
+	void UpdateWorldBounds();
+	HRESULT CreateBuffers(ID3D11Device* pDevice);
+	// Uploads the given instances, growing the buffer when needed
+	HRESULT UploadInstances(ID3D11DeviceContext* pDeviceContext, const std::vector<uint32_t>& instances);
+
+	dae::Matrix m_WorldMatrix{};
+	uint64_t m_WorldVersion{ 0 };
+
+	std::vector<dae::Vertex_In> m_WorldVertices{};
+	uint64_t m_WorldVerticesVersion{ UINT64_MAX };
+
+	// Vertices, indices, LODs and object space bounds, shared with every other user of the same file
+	dae::GeometryHandle m_pGeometry{};
+
+	// A single identity instance unless SetInstances was given any
+	std::vector<dae::Matrix> m_Instances{ dae::Matrix{} };
+	bool m_HasInstances{ false };
+
+	// World bounds follow m_WorldMatrix and the instances
+	dae::SphereArray m_InstanceSpheres{};
+	mutable std::vector<uint64_t> m_InstanceVisibility{};
+	dae::BoundingBox m_WorldBounds{};
+	dae::BoundingSphere m_WorldSphere{};
+
+	uint32_t m_ActiveLod{ 0 };
+	const float m_LodPixelError{ 1.f };
 
 	// DirectX
 	Effect* m_pEffect;
@@ -41,10 +112,20 @@ private:
 	ID3D11Buffer* m_pVertexBuffer;
 	ID3D11Buffer* m_pIndexBuffer;
 
-	std::unique_ptr<dae::Texture> m_pDiffuseMap;
-	std::unique_ptr<dae::Texture> m_pNormalMap;
-	std::unique_ptr<dae::Texture> m_pSpecularMap;
-	std::unique_ptr<dae::Texture> m_pGlossinessMap;
+	// Dynamic, refilled with the visible instances every frame
+	ID3D11Buffer* m_pInstanceBuffer{ nullptr };
+	uint32_t m_InstanceCapacity{ 0 };
+	std::vector<uint32_t> m_VisibleInstances{};
+
+	// Compact meshes also get 16 bit indices whenever the vertex count allows it
+	DXGI_FORMAT m_IndexFormat{ DXGI_FORMAT_R32_UINT };
+
+	// Textures are owned by the renderer's texture cache
+	dae::Material m_DefaultMaterial{};
+	std::vector<dae::Material> m_Materials{};
+
+	// Submeshes with equal maps end up next to each other, so rebinding can be skipped
+	std::vector<uint32_t> m_DrawOrder{};
 
 	ID3D11RasterizerState* m_RasterizerStateBack;
 	ID3D11RasterizerState* m_RasterizerStateFront;
@@ -0,0 +1,511 @@
+#include "MeshSimplifier.h"
+#include <unordered_map>
+#include <queue>
+#include <algorithm>
+#include <cfloat>
+#include <cstring>
+#include <cmath>
+#include <array>
+
+namespace dae
+{
+	namespace
+	{
+		// Symmetric 4x4 matrix storing the sum of squared plane distances
+		struct Quadric
+		{
+			double a2{}, ab{}, ac{}, ad{};
+			double b2{}, bc{}, bd{};
+			double c2{}, cd{};
+			double d2{};
+
+			static Quadric FromPlane(double a, double b, double c, double d, double weight)
+			{
+				Quadric q{};
+				q.a2 = a * a * weight; q.ab = a * b * weight; q.ac = a * c * weight; q.ad = a * d * weight;
+				q.b2 = b * b * weight; q.bc = b * c * weight; q.bd = b * d * weight;
+				q.c2 = c * c * weight; q.cd = c * d * weight;
+				q.d2 = d * d * weight;
+				return q;
+			}
+
+			Quadric& operator+=(const Quadric& q)
+			{
+				a2 += q.a2; ab += q.ab; ac += q.ac; ad += q.ad;
+				b2 += q.b2; bc += q.bc; bd += q.bd;
+				c2 += q.c2; cd += q.cd;
+				d2 += q.d2;
+				return *this;
+			}
+
+			double Evaluate(const Vector3& p) const
+			{
+				const double x{ p.x }, y{ p.y }, z{ p.z };
+				return a2 * x * x + 2.0 * ab * x * y + 2.0 * ac * x * z + 2.0 * ad * x
+					+ b2 * y * y + 2.0 * bc * y * z + 2.0 * bd * y
+					+ c2 * z * z + 2.0 * cd * z
+					+ d2;
+			}
+		};
+
+		struct Collapse
+		{
+			double cost;
+			uint32_t vertex;
+			uint32_t target;
+			uint32_t version;
+
+			bool operator>(const Collapse& other) const { return cost > other.cost; }
+		};
+
+		struct PositionHash
+		{
+			size_t operator()(const Vector3& p) const
+			{
+				uint32_t bits[3];
+				std::memcpy(bits, &p, sizeof(bits));
+				return (size_t(bits[0]) * 73856093u) ^ (size_t(bits[1]) * 19349663u) ^ (size_t(bits[2]) * 83492791u);
+			}
+		};
+
+		struct PositionEqual
+		{
+			bool operator()(const Vector3& a, const Vector3& b) const
+			{
+				return a.x == b.x && a.y == b.y && a.z == b.z;
+			}
+		};
+
+		struct VertexHash
+		{
+			size_t operator()(const Vertex_In& v) const
+			{
+				size_t hash{ PositionHash{}(v.position) };
+				const float values[5]{ v.uv.x, v.uv.y, v.normal.x, v.normal.y, v.normal.z };
+				for (float value : values)
+				{
+					uint32_t bits;
+					std::memcpy(&bits, &value, sizeof(bits));
+					hash = hash * 31u + bits;
+				}
+				return hash;
+			}
+		};
+
+		struct VertexEqual
+		{
+			bool operator()(const Vertex_In& a, const Vertex_In& b) const
+			{
+				return PositionEqual{}(a.position, b.position) && PositionEqual{}(a.normal, b.normal)
+					&& a.uv.x == b.uv.x && a.uv.y == b.uv.y;
+			}
+		};
+
+		Vector3 FaceNormal(const Vector3& p0, const Vector3& p1, const Vector3& p2)
+		{
+			return Vector3::Cross(p1 - p0, p2 - p0);
+		}
+	}
+
+	void MeshSimplifier::WeldVertices(std::vector<Vertex_In>& vertices, std::vector<uint32_t>& indices)
+	{
+		std::vector<uint32_t> vertexMaterials(vertices.size(), 0);
+		WeldVertices(vertices, indices, vertexMaterials);
+	}
+
+	void MeshSimplifier::WeldVertices(std::vector<Vertex_In>& vertices, std::vector<uint32_t>& indices, std::vector<uint32_t>& vertexMaterials)
+	{
+		// One lookup per material
+		std::vector<std::unordered_map<Vertex_In, uint32_t, VertexHash, VertexEqual>> uniqueVertices{};
+
+		std::vector<Vertex_In> welded{};
+		std::vector<uint32_t> weldedMaterials{};
+		welded.reserve(vertices.size());
+		weldedMaterials.reserve(vertices.size());
+
+		std::vector<uint32_t> remap(vertices.size());
+		for (uint32_t index{ 0 }; index < vertices.size(); ++index)
+		{
+			const uint32_t material{ vertexMaterials[index] };
+			if (material >= uniqueVertices.size())
+			{
+				uniqueVertices.resize(material + 1);
+			}
+
+			const auto [it, inserted] = uniqueVertices[material].try_emplace(vertices[index], static_cast<uint32_t>(welded.size()));
+			if (inserted)
+			{
+				welded.push_back(vertices[index]);
+				weldedMaterials.push_back(material);
+			}
+			remap[index] = it->second;
+		}
+
+		for (uint32_t& index : indices)
+		{
+			index = remap[index];
+		}
+
+		vertices = std::move(welded);
+		vertexMaterials = std::move(weldedMaterials);
+	}
+
+	float MeshSimplifier::Simplify(const std::vector<Vertex_In>& vertices, const std::vector<uint32_t>& indices, uint32_t targetIndexCount, std::vector<uint32_t>& outIndices)
+	{
+		const uint32_t vertexCount{ static_cast<uint32_t>(vertices.size()) };
+		const uint32_t triangleCount{ static_cast<uint32_t>(indices.size() / 3) };
+
+		// Collapses happen on positions, every vertex sharing a position is one "wedge" of it (uv/normal seams)
+		std::unordered_map<Vector3, uint32_t, PositionHash, PositionEqual> positionIds{};
+		std::vector<uint32_t> wedgePosition(vertexCount);
+		std::vector<Vector3> positions{};
+		for (uint32_t v{ 0 }; v < vertexCount; ++v)
+		{
+			const auto [it, inserted] = positionIds.try_emplace(vertices[v].position, static_cast<uint32_t>(positions.size()));
+			if (inserted) positions.push_back(vertices[v].position);
+			wedgePosition[v] = it->second;
+		}
+		const uint32_t positionCount{ static_cast<uint32_t>(positions.size()) };
+
+		std::vector<uint32_t> triangles{ indices };
+		std::vector<bool> triangleRemoved(triangleCount);
+		std::vector<std::vector<uint32_t>> positionTriangles(positionCount);
+		std::vector<Quadric> quadrics(positionCount);
+
+		for (uint32_t t{ 0 }; t < triangleCount; ++t)
+		{
+			const uint32_t* tri{ &triangles[t * 3] };
+			Vector3 normal{ FaceNormal(vertices[tri[0]].position, vertices[tri[1]].position, vertices[tri[2]].position) };
+			const float length{ normal.Magnitude() };
+			if (length > 0.f) normal /= length;
+
+			const Quadric quadric{ Quadric::FromPlane(normal.x, normal.y, normal.z, -Vector3::Dot(normal, vertices[tri[0]].position), 1.0) };
+			for (int corner{ 0 }; corner < 3; ++corner)
+			{
+				quadrics[wedgePosition[tri[corner]]] += quadric;
+				positionTriangles[wedgePosition[tri[corner]]].push_back(t);
+			}
+		}
+
+		// Open borders and attribute seams get a constraint plane so their outline keeps its shape
+		struct EdgeUsage
+		{
+			uint32_t count{};
+			uint32_t wedgeA{};
+			uint32_t wedgeB{};
+			bool isSeam{};
+		};
+		std::unordered_map<uint64_t, EdgeUsage> edgeUsage{};
+		const auto edgeKey = [&](uint32_t a, uint32_t b)
+			{
+				uint64_t pa{ wedgePosition[a] }, pb{ wedgePosition[b] };
+				if (pa > pb) std::swap(pa, pb);
+				return (pa << 32) | pb;
+			};
+
+		for (uint32_t t{ 0 }; t < triangleCount; ++t)
+		{
+			for (int corner{ 0 }; corner < 3; ++corner)
+			{
+				uint32_t a{ triangles[t * 3 + corner] };
+				uint32_t b{ triangles[t * 3 + (corner + 1) % 3] };
+				if (wedgePosition[a] > wedgePosition[b]) std::swap(a, b);
+
+				EdgeUsage& usage{ edgeUsage[edgeKey(a, b)] };
+				if (usage.count++ == 0)
+				{
+					usage.wedgeA = a;
+					usage.wedgeB = b;
+				}
+				else if (usage.wedgeA != a || usage.wedgeB != b)
+				{
+					usage.isSeam = true;
+				}
+			}
+		}
+
+		constexpr double constraintWeight{ 10.0 };
+		for (uint32_t t{ 0 }; t < triangleCount; ++t)
+		{
+			const uint32_t* tri{ &triangles[t * 3] };
+			const Vector3 faceNormal{ FaceNormal(vertices[tri[0]].position, vertices[tri[1]].position, vertices[tri[2]].position) };
+			for (int corner{ 0 }; corner < 3; ++corner)
+			{
+				const uint32_t a{ tri[corner] };
+				const uint32_t b{ tri[(corner + 1) % 3] };
+				const EdgeUsage& usage{ edgeUsage[edgeKey(a, b)] };
+				if (usage.count != 1 && !usage.isSeam) continue;
+
+				Vector3 edgeNormal{ Vector3::Cross(vertices[b].position - vertices[a].position, faceNormal) };
+				const float length{ edgeNormal.Magnitude() };
+				if (length <= 0.f) continue;
+				edgeNormal /= length;
+
+				const Quadric quadric{ Quadric::FromPlane(edgeNormal.x, edgeNormal.y, edgeNormal.z, -Vector3::Dot(edgeNormal, vertices[a].position), constraintWeight) };
+				quadrics[wedgePosition[a]] += quadric;
+				quadrics[wedgePosition[b]] += quadric;
+			}
+		}
+
+		// Every wedge of u has to land on exactly one wedge of v it shares an edge with, otherwise the collapse would tear a seam
+		std::vector<std::pair<uint32_t, uint32_t>> wedgeRemap{};
+		const auto buildWedgeRemap = [&](uint32_t u, uint32_t v)
+			{
+				wedgeRemap.clear();
+				for (uint32_t t : positionTriangles[u])
+				{
+					if (triangleRemoved[t]) continue;
+
+					uint32_t wedgeU{ UINT32_MAX };
+					uint32_t wedgeV{ UINT32_MAX };
+					for (int corner{ 0 }; corner < 3; ++corner)
+					{
+						const uint32_t wedge{ triangles[t * 3 + corner] };
+						if (wedgePosition[wedge] == u) wedgeU = wedge;
+						else if (wedgePosition[wedge] == v) wedgeV = wedge;
+					}
+
+					auto it{ std::find_if(wedgeRemap.begin(), wedgeRemap.end(), [&](const auto& pair) { return pair.first == wedgeU; }) };
+					if (it == wedgeRemap.end())
+					{
+						wedgeRemap.emplace_back(wedgeU, wedgeV);
+					}
+					else if (it->second == UINT32_MAX)
+					{
+						it->second = wedgeV;
+					}
+					else if (wedgeV != UINT32_MAX && it->second != wedgeV)
+					{
+						return false;
+					}
+				}
+
+				return std::all_of(wedgeRemap.begin(), wedgeRemap.end(), [](const auto& pair) { return pair.second != UINT32_MAX; });
+			};
+
+		// Moving u onto v must not flip or collapse any triangle that survives
+		const auto isValidCollapse = [&](uint32_t u, uint32_t v)
+			{
+				if (!buildWedgeRemap(u, v)) return false;
+
+				for (uint32_t t : positionTriangles[u])
+				{
+					if (triangleRemoved[t]) continue;
+
+					Vector3 p[3]{};
+					bool touchesTarget{ false };
+					for (int corner{ 0 }; corner < 3; ++corner)
+					{
+						const uint32_t position{ wedgePosition[triangles[t * 3 + corner]] };
+						touchesTarget |= position == v;
+						p[corner] = positions[position];
+					}
+					if (touchesTarget) continue;
+
+					const Vector3 before{ FaceNormal(p[0], p[1], p[2]) };
+					for (int corner{ 0 }; corner < 3; ++corner)
+					{
+						if (wedgePosition[triangles[t * 3 + corner]] == u) p[corner] = positions[v];
+					}
+					const Vector3 after{ FaceNormal(p[0], p[1], p[2]) };
+
+					const float afterLength{ after.Magnitude() };
+					if (afterLength <= 1e-12f) return false;
+					if (Vector3::Dot(before, after) < 0.2f * before.Magnitude() * afterLength) return false;
+				}
+				return true;
+			};
+
+		std::vector<bool> positionRemoved(positionCount);
+		std::vector<uint32_t> versions(positionCount);
+		std::priority_queue<Collapse, std::vector<Collapse>, std::greater<Collapse>> heap{};
+
+		const auto pushBestCollapse = [&](uint32_t u)
+			{
+				++versions[u];
+				if (positionRemoved[u]) return;
+
+				double bestCost{ DBL_MAX };
+				uint32_t bestTarget{ u };
+				for (uint32_t t : positionTriangles[u])
+				{
+					if (triangleRemoved[t]) continue;
+					for (int corner{ 0 }; corner < 3; ++corner)
+					{
+						const uint32_t target{ wedgePosition[triangles[t * 3 + corner]] };
+						if (target == u) continue;
+
+						Quadric combined{ quadrics[u] };
+						combined += quadrics[target];
+						const double cost{ std::max(combined.Evaluate(positions[target]), 0.0) };
+						if (cost < bestCost && isValidCollapse(u, target))
+						{
+							bestCost = cost;
+							bestTarget = target;
+						}
+					}
+				}
+
+				if (bestTarget != u)
+				{
+					heap.push(Collapse{ bestCost, u, bestTarget, versions[u] });
+				}
+			};
+
+		for (uint32_t p{ 0 }; p < positionCount; ++p)
+		{
+			pushBestCollapse(p);
+		}
+
+		uint32_t liveTriangles{ triangleCount };
+		double maxCost{ 0.0 };
+		std::vector<uint32_t> neighbours{};
+
+		while (liveTriangles * 3 > targetIndexCount && !heap.empty())
+		{
+			const Collapse collapse{ heap.top() };
+			heap.pop();
+
+			const uint32_t u{ collapse.vertex };
+			const uint32_t v{ collapse.target };
+			if (positionRemoved[u] || positionRemoved[v] || versions[u] != collapse.version) continue;
+			if (!isValidCollapse(u, v))
+			{
+				pushBestCollapse(u);
+				continue;
+			}
+
+			maxCost = std::max(maxCost, collapse.cost);
+			quadrics[v] += quadrics[u];
+			positionRemoved[u] = true;
+
+			for (uint32_t t : positionTriangles[u])
+			{
+				if (triangleRemoved[t]) continue;
+
+				uint32_t* tri{ &triangles[t * 3] };
+				if (wedgePosition[tri[0]] == v || wedgePosition[tri[1]] == v || wedgePosition[tri[2]] == v)
+				{
+					triangleRemoved[t] = true;
+					--liveTriangles;
+					continue;
+				}
+
+				for (int corner{ 0 }; corner < 3; ++corner)
+				{
+					if (wedgePosition[tri[corner]] != u) continue;
+					tri[corner] = std::find_if(wedgeRemap.begin(), wedgeRemap.end(), [&](const auto& pair) { return pair.first == tri[corner]; })->second;
+				}
+				positionTriangles[v].push_back(t);
+			}
+			positionTriangles[u].clear();
+
+			// Drop dead triangles and gather the one-ring that needs new collapse costs
+			auto& ring{ positionTriangles[v] };
+			ring.erase(std::remove_if(ring.begin(), ring.end(), [&](uint32_t t) { return triangleRemoved[t]; }), ring.end());
+
+			neighbours.clear();
+			for (uint32_t t : ring)
+			{
+				for (int corner{ 0 }; corner < 3; ++corner)
+				{
+					neighbours.push_back(wedgePosition[triangles[t * 3 + corner]]);
+				}
+			}
+			std::sort(neighbours.begin(), neighbours.end());
+			neighbours.erase(std::unique(neighbours.begin(), neighbours.end()), neighbours.end());
+
+			for (uint32_t neighbour : neighbours)
+			{
+				pushBestCollapse(neighbour);
+			}
+		}
+
+		outIndices.clear();
+		outIndices.reserve(size_t(liveTriangles) * 3);
+		for (uint32_t t{ 0 }; t < triangleCount; ++t)
+		{
+			if (triangleRemoved[t]) continue;
+			outIndices.insert(outIndices.end(), &triangles[t * 3], &triangles[t * 3] + 3);
+		}
+
+		return static_cast<float>(std::sqrt(maxCost));
+	}
+
+	std::vector<MeshLod> MeshSimplifier::BuildLods(const std::vector<Vertex_In>& vertices, std::vector<uint32_t>& indices, uint32_t maxLods, float reductionPerLod)
+	{
+		std::vector<MeshLod> lods{ MeshLod{ 0, static_cast<uint32_t>(indices.size()), 0.f } };
+
+		std::vector<uint32_t> source{ indices };
+		std::vector<uint32_t> simplified{};
+
+		while (lods.size() < maxLods)
+		{
+			const MeshLod& previous{ lods.back() };
+			const uint32_t target{ static_cast<uint32_t>(previous.indexCount * reductionPerLod) / 3 * 3 };
+
+			const float error{ Simplify(vertices, source, target, simplified) };
+
+			// Stop once the locked seams keep us from making real progress
+			if (simplified.empty() || simplified.size() > previous.indexCount * 0.9f) break;
+
+			lods.push_back(MeshLod{ static_cast<uint32_t>(indices.size()), static_cast<uint32_t>(simplified.size()), previous.geometricError + error });
+			indices.insert(indices.end(), simplified.begin(), simplified.end());
+			source.swap(simplified);
+		}
+
+		return lods;
+	}
+
+	std::vector<SubMesh> MeshSimplifier::SortByMaterial(const std::vector<uint32_t>& vertexMaterials, uint32_t materialCount, std::vector<uint32_t>& indices, const std::vector<MeshLod>& lods)
+	{
+		std::vector<SubMesh> subMeshes(materialCount);
+		for (uint32_t material{ 0 }; material < materialCount; ++material)
+		{
+			subMeshes[material].material = material;
+			subMeshes[material].lods.resize(lods.size());
+		}
+
+		// Welding keeps vertices per material and collapses never cross a seam, so any corner tells the material
+		std::vector<std::array<uint32_t, 3>> triangles{};
+		for (uint32_t level{ 0 }; level < lods.size(); ++level)
+		{
+			const MeshLod& lod{ lods[level] };
+
+			triangles.clear();
+			for (uint32_t index{ lod.startIndex }; index + 2 < lod.startIndex + lod.indexCount; index += 3)
+			{
+				triangles.push_back({ indices[index], indices[index + 1], indices[index + 2] });
+			}
+
+			std::stable_sort(triangles.begin(), triangles.end(), [&vertexMaterials](const std::array<uint32_t, 3>& a, const std::array<uint32_t, 3>& b)
+				{
+					return vertexMaterials[a[0]] < vertexMaterials[b[0]];
+				});
+
+			for (SubMesh& subMesh : subMeshes)
+			{
+				subMesh.lods[level] = MeshLod{ lod.startIndex, 0, lod.geometricError };
+			}
+
+			uint32_t index{ lod.startIndex };
+			for (const std::array<uint32_t, 3>& triangle : triangles)
+			{
+				MeshLod& range{ subMeshes[vertexMaterials[triangle[0]]].lods[level] };
+				if (range.indexCount == 0)
+				{
+					range.startIndex = index;
+				}
+				range.indexCount += 3;
+
+				for (const uint32_t corner : triangle)
+				{
+					indices[index++] = corner;
+				}
+			}
+		}
+
+		std::erase_if(subMeshes, [](const SubMesh& subMesh) { return subMesh.lods.empty() || subMesh.lods[0].indexCount == 0; });
+		return subMeshes;
+	}
+}
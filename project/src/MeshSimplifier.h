@@ -0,0 +1,43 @@
+#pragma once
+#include <vector>
+#include <cstdint>
+#include "DataTypes.h"
+
+namespace dae
+{
+	struct MeshLod
+	{
+		// Range inside the mesh index buffer
+		uint32_t startIndex{};
+		uint32_t indexCount{};
+
+		// Largest object-space deviation introduced by the simplification
+		float geometricError{};
+	};
+
+	// All triangles of one material, one range per LOD level
+	struct SubMesh
+	{
+		uint32_t material{};
+		std::vector<MeshLod> lods{};
+	};
+
+	namespace MeshSimplifier
+	{
+		// Merges vertices with identical position, uv and normal, tangents are generated afterwards
+		void WeldVertices(std::vector<Vertex_In>& vertices, std::vector<uint32_t>& indices);
+		// Same, but vertices of different materials never merge, so material borders stay seams for Simplify
+		void WeldVertices(std::vector<Vertex_In>& vertices, std::vector<uint32_t>& indices, std::vector<uint32_t>& vertexMaterials);
+
+		// Quadric error metric simplification by half-edge collapses.
+		// UV/normal seams and open borders are preserved, returns the geometric error.
+		float Simplify(const std::vector<Vertex_In>& vertices, const std::vector<uint32_t>& indices, uint32_t targetIndexCount, std::vector<uint32_t>& outIndices);
+
+		// Appends every generated LOD behind LOD0 inside indices, LOD0 being the original triangle list
+		std::vector<MeshLod> BuildLods(const std::vector<Vertex_In>& vertices, std::vector<uint32_t>& indices, uint32_t maxLods = 5, float reductionPerLod = 0.5f);
+
+		// Sorts the triangles inside every LOD by material and returns the per material ranges,
+		// materials without any triangle in LOD0 are left out
+		std::vector<SubMesh> SortByMaterial(const std::vector<uint32_t>& vertexMaterials, uint32_t materialCount, std::vector<uint32_t>& indices, const std::vector<MeshLod>& lods);
+	}
+}
@@ -0,0 +1,198 @@
+#include "NormalMapBaker.h"
+#include <algorithm>
+#include <numeric>
+#include <cmath>
+#include <array>
+#include <utility>
+
+namespace dae
+{
+	namespace
+	{
+		// About 14 degrees, beyond that a texel already covered by another triangle counts as a different surface
+		constexpr float ConflictCosine{ 0.97f };
+		// Point sampling rounds down, texels along the uv seams are read without their centre being covered
+		constexpr int DilationPasses{ 2 };
+		// Texels a dilation pass copies from, the first one covered wins
+		constexpr std::array<std::pair<int, int>, 4> DilationOffsets{ { { -1, 0 }, { 1, 0 }, { 0, -1 }, { 0, 1 } } };
+		// Half the texel diagonal, a texel closer than this to the triangle can be sampled for it
+		constexpr float TouchDistance{ 0.7071f };
+
+		struct BakedTexel
+		{
+			size_t texel{};
+			Vector3 normal{};
+			bool isInside{};	// centre inside the triangle, otherwise the texel only touches it
+		};
+
+		Vector3 DecodeNormal(uint32_t texel)
+		{
+			const Vector3 color{ static_cast<float>(texel & 0xFF), static_cast<float>((texel >> 8) & 0xFF), static_cast<float>((texel >> 16) & 0xFF) };
+			return color / 255.f * 2.f - Vector3{ 1.f, 1.f, 1.f };
+		}
+
+		uint32_t EncodeNormal(const Vector3& normal)
+		{
+			const auto channel = [](float value) { return static_cast<uint32_t>(std::clamp(value * 0.5f + 0.5f, 0.f, 1.f) * 255.f + 0.5f); };
+			return channel(normal.x) | (channel(normal.y) << 8) | (channel(normal.z) << 16) | (255u << 24);
+		}
+
+		// Object space normals of every texel the triangle touches, taken at the nearest point inside it
+		void RasterizeTriangle(const Vertex_In* (&corners)[3], const TextureData& tangentSpaceMap, std::vector<BakedTexel>& texels)
+		{
+			const int width{ static_cast<int>(tangentSpaceMap.width) };
+			const int height{ static_cast<int>(tangentSpaceMap.height) };
+			texels.clear();
+
+			// Texel space, the texel (x, y) is what Texture::Sample returns for uvs in [x, x + 1) / width
+			Vector2 points[3]{};
+			for (int corner{ 0 }; corner < 3; ++corner)
+			{
+				points[corner] = { corners[corner]->uv.x * width, corners[corner]->uv.y * height };
+			}
+
+			const float area{ Vector2::Cross(points[1] - points[0], points[2] - points[0]) };
+			if (area == 0.f) return;
+			const float invArea{ 1.f / area };
+
+			// Signed area, so either uv winding gives positive weights inside. A weight times the height over its
+			// edge is the distance to that edge, negative outside.
+			const float heights[3]{
+				std::abs(area) / (points[2] - points[1]).Magnitude(),
+				std::abs(area) / (points[0] - points[2]).Magnitude(),
+				std::abs(area) / (points[1] - points[0]).Magnitude() };
+
+			const int minX{ std::max(static_cast<int>(std::floor(std::min({ points[0].x, points[1].x, points[2].x }))), 0) };
+			const int minY{ std::max(static_cast<int>(std::floor(std::min({ points[0].y, points[1].y, points[2].y }))), 0) };
+			const int maxX{ std::min(static_cast<int>(std::ceil(std::max({ points[0].x, points[1].x, points[2].x }))), width) };
+			const int maxY{ std::min(static_cast<int>(std::ceil(std::max({ points[0].y, points[1].y, points[2].y }))), height) };
+
+			for (int y{ minY }; y < maxY; ++y)
+			{
+				for (int x{ minX }; x < maxX; ++x)
+				{
+					const Vector2 point{ x + 0.5f, y + 0.5f };
+					float weight0{ Vector2::Cross(points[2] - points[1], point - points[1]) * invArea };
+					float weight1{ Vector2::Cross(points[0] - points[2], point - points[2]) * invArea };
+					float weight2{ Vector2::Cross(points[1] - points[0], point - points[0]) * invArea };
+					if (weight0 * heights[0] < -TouchDistance || weight1 * heights[1] < -TouchDistance || weight2 * heights[2] < -TouchDistance) continue;
+
+					const bool isInside{ weight0 >= 0.f && weight1 >= 0.f && weight2 >= 0.f };
+					if (!isInside)
+					{
+						weight0 = std::max(weight0, 0.f);
+						weight1 = std::max(weight1, 0.f);
+						weight2 = std::max(weight2, 0.f);
+						const float sum{ weight0 + weight1 + weight2 };
+						weight0 /= sum;
+						weight1 /= sum;
+						weight2 /= sum;
+					}
+
+					// The same frame the software renderer builds per pixel, only in object space
+					const Vector3 normal{ (corners[0]->normal * weight0 + corners[1]->normal * weight1 + corners[2]->normal * weight2).Normalized() };
+					const Vector3 tangent{ (corners[0]->tangent * weight0 + corners[1]->tangent * weight1 + corners[2]->tangent * weight2).Normalized() };
+					const Vector3 binormal{ Vector3::Cross(normal, tangent) * corners[0]->tangentSign };
+
+					const size_t texel{ static_cast<size_t>(y) * width + x };
+					const Vector3 sampled{ DecodeNormal(tangentSpaceMap.texels[texel]) };
+					texels.push_back({ texel, (tangent * sampled.x + binormal * sampled.y + normal * sampled.z).Normalized(), isInside });
+				}
+			}
+		}
+	}
+
+	bool NormalMapBaker::BakeObjectSpace(std::span<const Vertex_In> vertices, std::span<const uint32_t> indices,
+		const TextureData& tangentSpaceMap, TextureData& objectSpaceMap, std::vector<bool>& isBaked, Stats& stats)
+	{
+		const uint32_t triangleCount{ static_cast<uint32_t>(indices.size() / 3) };
+		stats = { triangleCount };
+		isBaked.assign(triangleCount, false);
+		if (tangentSpaceMap.width == 0 || tangentSpaceMap.height == 0)
+			return false;
+
+		// Only the top level, the caller builds the mip chain of the result
+		std::vector<Vector3> normals(static_cast<size_t>(tangentSpaceMap.width) * tangentSpaceMap.height);
+		std::vector<bool> isCovered(normals.size(), false);
+		std::vector<bool> isInside(normals.size(), false);
+
+		// Unmirrored triangles claim their texels first, they usually are the larger half
+		std::vector<uint32_t> order(triangleCount);
+		std::iota(order.begin(), order.end(), 0u);
+		std::stable_partition(order.begin(), order.end(), [&](uint32_t triangle) { return vertices[indices[triangle * 3]].tangentSign > 0.f; });
+
+		std::vector<BakedTexel> texels{};
+		for (const uint32_t triangle : order)
+		{
+			const Vertex_In* corners[3]{ &vertices[indices[triangle * 3]], &vertices[indices[triangle * 3 + 1]], &vertices[indices[triangle * 3 + 2]] };
+			RasterizeTriangle(corners, tangentSpaceMap, texels);
+			// Collapsed uvs (caps mapped to a single point) have nothing to store
+			if (texels.empty()) continue;
+
+			// All or nothing, a triangle is either shaded from the object space map or from the tangent space one
+			const bool isConflicting{ std::any_of(texels.begin(), texels.end(), [&](const BakedTexel& baked)
+				{
+					return isCovered[baked.texel] && Vector3::Dot(normals[baked.texel], baked.normal) < ConflictCosine;
+				}) };
+			if (isConflicting) continue;
+
+			// A texel whose centre is inside a triangle belongs to it, the ones only touching keep the first normal
+			for (const BakedTexel& baked : texels)
+			{
+				if (!isCovered[baked.texel] || (baked.isInside && !isInside[baked.texel]))
+				{
+					stats.coveredTexels += !isCovered[baked.texel];
+					isCovered[baked.texel] = true;
+					isInside[baked.texel] = baked.isInside;
+					normals[baked.texel] = baked.normal;
+				}
+			}
+
+			isBaked[triangle] = true;
+			++stats.bakedTriangles;
+		}
+
+		if (stats.bakedTriangles == 0)
+			return false;
+
+		// Grow the covered islands a little, texels nothing covers at all are never sampled
+		const int width{ static_cast<int>(tangentSpaceMap.width) };
+		const int height{ static_cast<int>(tangentSpaceMap.height) };
+		for (int pass{ 0 }; pass < DilationPasses; ++pass)
+		{
+			const std::vector<bool> wasCovered{ isCovered };
+			for (int y{ 0 }; y < height; ++y)
+			{
+				for (int x{ 0 }; x < width; ++x)
+				{
+					const size_t texel{ static_cast<size_t>(y) * width + x };
+					if (wasCovered[texel]) continue;
+
+					for (const auto& [offsetX, offsetY] : DilationOffsets)
+					{
+						const int neighbourX{ x + offsetX };
+						const int neighbourY{ y + offsetY };
+						if (neighbourX < 0 || neighbourY < 0 || neighbourX >= width || neighbourY >= height) continue;
+
+						const size_t neighbour{ static_cast<size_t>(neighbourY) * width + neighbourX };
+						if (wasCovered[neighbour])
+						{
+							normals[texel] = normals[neighbour];
+							isCovered[texel] = true;
+							break;
+						}
+					}
+				}
+			}
+		}
+
+		objectSpaceMap = TextureData{ tangentSpaceMap.width, tangentSpaceMap.height, 1, {} };
+		objectSpaceMap.texels.resize(normals.size());
+		for (size_t texel{ 0 }; texel < normals.size(); ++texel)
+		{
+			// Flat up for what stays uncovered, it is never sampled
+			objectSpaceMap.texels[texel] = EncodeNormal(isCovered[texel] ? normals[texel] : Vector3::UnitZ);
+		}
+		return true;
+	}
+}
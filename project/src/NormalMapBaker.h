@@ -0,0 +1,30 @@
+#pragma once
+#include <span>
+#include <vector>
+#include <cstdint>
+#include "DataTypes.h"
+#include "AssetFormat.h"
+
+namespace dae
+{
+	// Converts tangent space normal maps into object space ones for rigid meshes, so the software
+	// renderer can rotate the sampled normal by the world matrix instead of building a tangent frame
+	// per pixel. Meant to run in the AssetCooker on the welded mesh with its final tangents.
+	namespace NormalMapBaker
+	{
+		struct Stats
+		{
+			uint32_t triangles{};
+			uint32_t bakedTriangles{};
+			uint32_t coveredTexels{};
+		};
+
+		// Rasterizes the triangles in uv space at the resolution of tangentSpaceMap and writes one level of
+		// object space normals, encoded like the tangent space ones (n * 0.5 + 0.5).
+		// Parts sharing uvs (mirrored halves, repeated wheels) cannot all be stored: a triangle whose texels
+		// already hold a different normal is left out and keeps the tangent space map. isBaked gets one entry
+		// per triangle, returns false when no triangle could be baked.
+		bool BakeObjectSpace(std::span<const Vertex_In> vertices, std::span<const uint32_t> indices,
+			const TextureData& tangentSpaceMap, TextureData& objectSpaceMap, std::vector<bool>& isBaked, Stats& stats);
+	}
+}
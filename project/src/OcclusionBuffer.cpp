@@ -0,0 +1,216 @@
+#include "pch.h"
+#include "OcclusionBuffer.h"
+#include <execution>
+#include <cmath>
+#include <cfloat>
+
+namespace dae
+{
+	namespace
+	{
+		// Clip w below this is treated as touching the near plane
+		constexpr float MinClipW{ 0.0001f };
+	}
+
+	OcclusionBuffer::OcclusionBuffer(int width, int height) :
+		m_Width{ width },
+		m_Height{ height },
+		m_Depth(static_cast<size_t>(width) * height, 1.f),
+		m_ErodedDepth(static_cast<size_t>(width) * height, 1.f)
+	{
+	}
+
+	void OcclusionBuffer::Clear(const Matrix& viewProjection)
+	{
+		m_ViewProjection = viewProjection;
+		m_HasOccluders = false;
+		m_Stats = Stats{};
+
+		std::fill(m_Depth.begin(), m_Depth.end(), 1.f);
+	}
+
+	void OcclusionBuffer::SetOccluderVertices(std::span<const Vertex_In> worldVertices, const Matrix* pInstance)
+	{
+		const Matrix m{ pInstance ? *pInstance * m_ViewProjection : m_ViewProjection };
+		const float width{ static_cast<float>(m_Width) };
+		const float height{ static_cast<float>(m_Height) };
+
+		m_ScreenVertices.resize(worldVertices.size());
+		std::transform(std::execution::par_unseq, worldVertices.begin(), worldVertices.end(), m_ScreenVertices.begin(), [&m, width, height](const Vertex_In& vertex)
+			{
+				const Vector4 clip{ m.TransformPoint(Vector4{ vertex.position, 1.f }) };
+				if (clip.w < MinClipW)
+					return Vector4{ 0.f, 0.f, 0.f, clip.w };
+
+				// Same mapping as the software renderer's screen space
+				return Vector4{
+					(clip.x / clip.w + 1.f) / 2.f * width,
+					(1.f - clip.y / clip.w) / 2.f * height,
+					clip.z / clip.w,
+					clip.w };
+			});
+	}
+
+	void OcclusionBuffer::RasterizeTriangles(std::span<const uint32_t> indices)
+	{
+		const float width{ static_cast<float>(m_Width) };
+		const float height{ static_cast<float>(m_Height) };
+
+		for (size_t index{ 0 }; index + 2 < indices.size(); index += 3)
+		{
+			const Vector4& s0{ m_ScreenVertices[indices[index]] };
+			const Vector4& s1{ m_ScreenVertices[indices[index + 1]] };
+			const Vector4& s2{ m_ScreenVertices[indices[index + 2]] };
+
+			// Clipping would only add occlusion, leaving the triangle out stays on the safe side
+			if (s0.w < MinClipW || s1.w < MinClipW || s2.w < MinClipW)
+				continue;
+			if (s0.z < 0.f || s1.z < 0.f || s2.z < 0.f)
+				continue;
+
+			const Vector2 v0{ s0.GetXY() };
+			const Vector2 v1{ s1.GetXY() };
+			const Vector2 v2{ s2.GetXY() };
+
+			const float area{ Vector2::Cross(v1 - v0, v2 - v0) };
+			if (area == 0.f)
+				continue;
+
+			// Bounding box caculations, clamped as floats since vertices close to the camera plane land far off screen
+			const int minX{ static_cast<int>(std::floor(std::clamp(std::min({ v0.x, v1.x, v2.x }), 0.f, width))) };
+			const int minY{ static_cast<int>(std::floor(std::clamp(std::min({ v0.y, v1.y, v2.y }), 0.f, height))) };
+			const int maxX{ static_cast<int>(std::ceil(std::clamp(std::max({ v0.x, v1.x, v2.x }), 0.f, width))) };
+			const int maxY{ static_cast<int>(std::ceil(std::clamp(std::max({ v0.y, v1.y, v2.y }), 0.f, height))) };
+			if (minX >= maxX || minY >= maxY)
+				continue;
+
+			++m_Stats.occluderTriangles;
+
+			// NDC depth is linear in screen space, so the farthest depth inside a pixel is on one of its corners
+			const Vector2 edge0{ v1 - v0 };
+			const Vector2 edge1{ v2 - v0 };
+			const float depthDx{ ((s1.z - s0.z) * edge1.y - (s2.z - s0.z) * edge0.y) / area };
+			const float depthDy{ ((s2.z - s0.z) * edge0.x - (s1.z - s0.z) * edge1.x) / area };
+			const float pixelSlack{ 0.5f * (std::abs(depthDx) + std::abs(depthDy)) };
+
+			for (int py{ minY }; py < maxY; ++py)
+			{
+				for (int px{ minX }; px < maxX; ++px)
+				{
+					const Vector2 point{ px + 0.5f, py + 0.5f };
+
+					// Both windings count, a back face is still in front of whatever is behind it
+					const float sin1{ Vector2::Cross(v1 - v0, point - v0) };
+					const float sin2{ Vector2::Cross(v2 - v1, point - v1) };
+					const float sin3{ Vector2::Cross(v0 - v2, point - v2) };
+					const bool isInside{ (sin1 >= 0.f && sin2 >= 0.f && sin3 >= 0.f) || (sin1 <= 0.f && sin2 <= 0.f && sin3 <= 0.f) };
+					if (!isInside)
+						continue;
+
+					const float depth{ std::min(1.f, s0.z + depthDx * (point.x - v0.x) + depthDy * (point.y - v0.y) + pixelSlack) };
+					float& stored{ m_Depth[px + py * m_Width] };
+					stored = std::min(stored, depth);
+				}
+			}
+
+			m_HasOccluders = true;
+		}
+	}
+
+	void OcclusionBuffer::Finish()
+	{
+		if (!m_HasOccluders)
+			return;
+
+		// Farthest depth of every 3x3 block, pixels on the rim of an occluder or next to a hole in it fall back to 1.
+		// Run as a horizontal then a vertical pass, the border counts as empty.
+		std::vector<float> rows(m_Depth.size());
+		for (int py{ 0 }; py < m_Height; ++py)
+		{
+			const float* pRow{ &m_Depth[py * m_Width] };
+			for (int px{ 0 }; px < m_Width; ++px)
+			{
+				const float left{ px > 0 ? pRow[px - 1] : 1.f };
+				const float right{ px + 1 < m_Width ? pRow[px + 1] : 1.f };
+				rows[px + py * m_Width] = std::max({ left, pRow[px], right });
+			}
+		}
+
+		for (int py{ 0 }; py < m_Height; ++py)
+		{
+			for (int px{ 0 }; px < m_Width; ++px)
+			{
+				const float up{ py > 0 ? rows[px + (py - 1) * m_Width] : 1.f };
+				const float down{ py + 1 < m_Height ? rows[px + (py + 1) * m_Width] : 1.f };
+				m_ErodedDepth[px + py * m_Width] = std::max({ up, rows[px + py * m_Width], down });
+			}
+		}
+	}
+
+	bool OcclusionBuffer::IsVisible(const BoundingBox& worldBox) const
+	{
+		if (!m_HasOccluders)
+			return true;
+
+		++m_Stats.tests;
+
+		float minX{ FLT_MAX };
+		float minY{ FLT_MAX };
+		float maxX{ -FLT_MAX };
+		float maxY{ -FLT_MAX };
+		float nearestDepth{ FLT_MAX };
+		for (int corner{ 0 }; corner < 8; ++corner)
+		{
+			const Vector3 position{
+				corner & 1 ? worldBox.max.x : worldBox.min.x,
+				corner & 2 ? worldBox.max.y : worldBox.min.y,
+				corner & 4 ? worldBox.max.z : worldBox.min.z };
+
+			// Reaching the camera plane, it can cover any part of the screen
+			const Vector4 clip{ m_ViewProjection.TransformPoint(Vector4{ position, 1.f }) };
+			if (clip.w < MinClipW)
+				return true;
+
+			const float x{ (clip.x / clip.w + 1.f) / 2.f * m_Width };
+			const float y{ (1.f - clip.y / clip.w) / 2.f * m_Height };
+			minX = std::min(minX, x);
+			minY = std::min(minY, y);
+			maxX = std::max(maxX, x);
+			maxY = std::max(maxY, y);
+			nearestDepth = std::min(nearestDepth, clip.z / clip.w);
+		}
+
+		// Every pixel the screen rectangle touches
+		const float width{ static_cast<float>(m_Width) };
+		const float height{ static_cast<float>(m_Height) };
+		const int startX{ static_cast<int>(std::floor(std::clamp(minX, 0.f, width))) };
+		const int startY{ static_cast<int>(std::floor(std::clamp(minY, 0.f, height))) };
+		const int endX{ static_cast<int>(std::ceil(std::clamp(maxX, 0.f, width))) };
+		const int endY{ static_cast<int>(std::ceil(std::clamp(maxY, 0.f, height))) };
+		if (startX >= endX || startY >= endY)
+			return true;
+
+		for (int py{ startY }; py < endY; ++py)
+		{
+			for (int px{ startX }; px < endX; ++px)
+			{
+				if (m_ErodedDepth[px + py * m_Width] >= nearestDepth)
+					return true;
+			}
+		}
+
+		++m_Stats.occluded;
+		return false;
+	}
+
+	bool OcclusionBuffer::IsVisible(const BoundingSphere& worldSphere) const
+	{
+		const Vector3 extent{ worldSphere.radius, worldSphere.radius, worldSphere.radius };
+		return IsVisible(BoundingBox{ worldSphere.center - extent, worldSphere.center + extent });
+	}
+
+	const OcclusionBuffer::Stats& OcclusionBuffer::GetStats() const
+	{
+		return m_Stats;
+	}
+}
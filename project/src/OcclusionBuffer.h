@@ -0,0 +1,65 @@
+#pragma once
+#include <vector>
+#include <span>
+#include <cstdint>
+#include "DataTypes.h"
+
+namespace dae
+{
+	// Low resolution depth of a few chosen occluders, used to skip meshes, instances and clusters
+	// hidden behind them. Occluders are rasterized with the same bounding box and edge function
+	// loop as Renderer::RenderTriangle, then eroded so a pixel only keeps a depth when the occluder
+	// covers all of it. Tests compare against the farthest occluder depth of that footprint, so
+	// they only ever report hidden for things that really are behind the occluders.
+	class OcclusionBuffer final
+	{
+	public:
+		struct Stats
+		{
+			uint32_t occluderTriangles{};
+			uint32_t tests{};
+			uint32_t occluded{};
+		};
+
+		OcclusionBuffer(int width, int height);
+		~OcclusionBuffer() = default;
+
+		OcclusionBuffer(const OcclusionBuffer&) = delete;
+		OcclusionBuffer(OcclusionBuffer&&) noexcept = delete;
+		OcclusionBuffer& operator=(const OcclusionBuffer&) = delete;
+		OcclusionBuffer& operator=(OcclusionBuffer&&) noexcept = delete;
+
+		// Starts a frame, nothing is occluded until occluders are rasterized and Finish is called
+		void Clear(const Matrix& viewProjection);
+
+		// Projects world space vertices (see Mesh::GetWorldVertices), moved by instance first when given.
+		// The indices passed to the following RasterizeTriangles calls point into them.
+		void SetOccluderVertices(std::span<const Vertex_In> worldVertices, const Matrix* pInstance);
+		void RasterizeTriangles(std::span<const uint32_t> indices);
+
+		// Erodes the rasterized occluders, has to run before the first test of the frame
+		void Finish();
+
+		// False only when the box is completely behind the occluders
+		bool IsVisible(const BoundingBox& worldBox) const;
+		bool IsVisible(const BoundingSphere& worldSphere) const;
+
+		const Stats& GetStats() const;
+
+	private:
+		const int m_Width;
+		const int m_Height;
+
+		Matrix m_ViewProjection{};
+		bool m_HasOccluders{ false };
+
+		// NDC depth, 1 where no occluder was rasterized
+		std::vector<float> m_Depth{};
+		std::vector<float> m_ErodedDepth{};
+
+		// Screen x, screen y, NDC depth and clip w of the current occluder's vertices
+		std::vector<Vector4> m_ScreenVertices{};
+
+		mutable Stats m_Stats{};
+	};
+}
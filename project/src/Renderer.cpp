@@ -2,14 +2,48 @@
 #include "Effect.h"
 #include "Renderer.h"
 #include "Utils.h"
+#include "AssetLoader.h"
 #include "DataTypes.h"
 #include <algorithm>
+#include <chrono>
 #include <execution>
+#include <numeric>
+#include <random>
 
 #define EPS 1e-4
 
 namespace dae {
 
+	namespace
+	{
+		// Depth-only passes write from many threads at once, the nearest depth has to win whatever the order
+		void StoreMinDepth(float& stored, float depth)
+		{
+			std::atomic_ref<float> target{ stored };
+			float current{ target.load(std::memory_order_relaxed) };
+			while (depth < current && !target.compare_exchange_weak(current, depth, std::memory_order_relaxed))
+			{
+			}
+		}
+
+		// Loader jobs hand their exceptions to the futures, called from the catch of a get() that threw
+		void ReportLoadFailure(const std::string& name)
+		{
+			try
+			{
+				throw;
+			}
+			catch (const std::exception& error)
+			{
+				std::cout << "Failed to load " << name << ": " << error.what() << std::endl;
+			}
+			catch (...)
+			{
+				std::cout << "Failed to load " << name << std::endl;
+			}
+		}
+	}
+
 	Renderer::Renderer(SDL_Window* pWindow) :
 		m_pWindow(pWindow)
 	{
@@ -24,13 +58,16 @@ namespace dae {
 		m_pDepthBufferPixels = new float[m_Width * m_Height];
 		std::fill_n(m_pDepthBufferPixels, m_Width * m_Height, FLT_MAX);
 
+		// Start loading before the device exists, the first frame does not wait for any of it
+		m_pAssetLoader = std::make_unique<AssetLoader>();
+		RequestAssets();
+
 		//Initialize DirectX pipeline
 		const HRESULT result = InitializeDirectX();
 		if (result == S_OK)
 		{
 			m_IsInitialized = true;
-
-			CreateMeshes();
+			m_PlaceholderMaterial = AssetLoader::CreatePlaceholders(m_pDevice, m_Textures);
 
 			std::cout << "DirectX is initialized and ready!\n";
 		}
@@ -41,14 +78,20 @@ namespace dae {
 
 		m_pCamera = std::make_unique<Camera>();
 		m_pCamera->Initialize(45.f, { 0,0,0.f }, static_cast<float>(m_Width) / static_cast<float>(m_Height));
+		m_pLightCulling = std::make_unique<TiledLightCulling>(m_Width, m_Height);
+		m_pTriangleBins = std::make_unique<TriangleBins>(m_Width, m_Height);
 
 		PrintOutKeys();
 	}
 
 	Renderer::~Renderer()
 	{
+		ReleaseStream(m_VehicleStream, m_pMesh.get());
+		ReleaseStream(m_FireStream, m_pFireMesh.get());
+
 		m_pFireMesh.reset();
 		m_pMesh.reset();
+		m_Textures.clear();
 		m_pCamera.reset();
 
 		m_pRenderTargetView->Release();
@@ -72,8 +115,16 @@ namespace dae {
 
 	void Renderer::Update(const dae::Timer* pTimer)
 	{
+		// Swapping in here keeps every frame on a consistent set of assets
+		StreamAssets();
+
 		m_pCamera->Update(pTimer);
 		RotateMesh(pTimer->GetElapsed());
+		MovePointLights(pTimer->GetTotal());
+		m_Scene.Update();
+
+		if (m_pMesh) m_pMesh->UpdateLod(*m_pCamera, static_cast<float>(m_Height));
+		if (m_pFireMesh) m_pFireMesh->UpdateLod(*m_pCamera, static_cast<float>(m_Height));
 	}
 
 
@@ -87,6 +138,13 @@ namespace dae {
 		{
 			Render_Software();
 		}
+
+		if (!m_HasPresented)
+		{
+			m_HasPresented = true;
+			const float ms{ std::chrono::duration<float, std::milli>(std::chrono::steady_clock::now() - m_StartTime).count() };
+			std::cout << "First frame presented after " << ms << " ms" << std::endl;
+		}
 	}
 
 	void Renderer::Render_DirectX()
@@ -101,10 +159,18 @@ namespace dae {
 		m_pDeviceContext->ClearDepthStencilView(m_pDethStencilView, D3D11_CLEAR_DEPTH | D3D11_CLEAR_STENCIL, 1.f, 0);
 
 
-		m_pMesh->Render_DirectX(m_pDeviceContext, m_pCamera.get());
-		if (m_RenderFireFX)
+		const dae::Matrix viewProjection{ m_pCamera->invViewMatrix * m_pCamera->ProjectionMatrix };
+		dae::Frustum frustum;
+		ExtractFrustumPlanes(viewProjection, frustum);
+		RenderOccluders(frustum, viewProjection);
+
+		if (m_pMesh && m_pMesh->IsVisible(frustum))
+		{
+			m_pMesh->Render_DirectX(m_pDeviceContext, m_pCamera.get(), frustum, &m_OcclusionBuffer);
+		}
+		if (m_RenderFireFX && m_pFireMesh && m_pFireMesh->IsVisible(frustum))
 		{
-			m_pFireMesh->Render_DirectX(m_pDeviceContext, m_pCamera.get());
+			m_pFireMesh->Render_DirectX(m_pDeviceContext, m_pCamera.get(), frustum, &m_OcclusionBuffer);
 		}
 
 
@@ -113,6 +179,7 @@ namespace dae {
 
 	void Renderer::Render_Software()
 	{
+		const auto start{ std::chrono::steady_clock::now() };
 		SDL_LockSurface(m_pBackBuffer);
 
 		dae::Matrix view{ m_pCamera->invViewMatrix };
@@ -120,6 +187,7 @@ namespace dae {
 
 		dae::Frustum frustum;
 		ExtractFrustumPlanes(view * proj, frustum);
+		RenderOccluders(frustum, view * proj);
 
 		const int allPixels{ m_Width * m_Height };
 
@@ -139,10 +207,87 @@ namespace dae {
 				static_cast<uint8_t>(finalColor.b * 255));
 		}
 
-		RenderMesh(m_pMesh.get());
+		std::vector<TriangleBatch> triangleBatches{};
+		if (m_pMesh && m_UseClusteredMesh && m_pClusteredMesh)
+		{
+			TransformClusteredMesh(m_pClusteredMesh.get(), m_pMesh.get(), frustum, triangleBatches);
+		}
+		else
+		{
+			std::vector<DrawBatch> batches{};
+			if (m_pMesh) GatherBatches(m_pMesh.get(), frustum, batches);
+
+			// Consecutive batches sharing maps keep their texels in cache
+			std::stable_sort(batches.begin(), batches.end(), [](const DrawBatch& a, const DrawBatch& b) { return a.material < b.material; });
+			triangleBatches.resize(batches.size());
+			for (size_t index{ 0 }; index < batches.size(); ++index)
+			{
+				const DrawBatch& batch{ batches[index] };
+				triangleBatches[index].material = batch.material;
+				triangleBatches[index].objectToWorld = batch.pInstance ? batch.pMesh->GetWorldMatrix() * *batch.pInstance : batch.pMesh->GetWorldMatrix();
+				triangleBatches[index].shadingTier = batch.shadingTier;
+				TransformBatch(batch, triangleBatches[index].triangles);
+			}
+		}
+
+		// Settings only change between frames and materials between batches, the rasterizer is looked up once per batch
+		for (TriangleBatch& batch : triangleBatches)
+		{
+			batch.pRasterize = SelectRasterizer(batch);
+		}
+
+		RenderShadowMap();
+		CullLights(triangleBatches);
+
+		// The debug views do not shade
+		if (!m_RenderDepthBuffer && !m_RenderBoundingBox)
+		{
+			for (TriangleBatch& batch : triangleBatches)
+			{
+				if (batch.shadingTier == ShadingTier::PerVertex) LightVertices(batch);
+			}
+		}
+
+		m_ShadedFragments = 0;
+		m_RejectedFragments = 0;
+		if (m_SortFrontToBack)
+		{
+			BinTriangles(triangleBatches);
+			RasterizeBins(triangleBatches);
+		}
+		else
+		{
+			// Depth first, the shading pass then only shades the fragments that end up on screen
+			const PixelRect screen{ 0, 0, m_Width, m_Height };
+			if (m_UseDepthPrepass && !m_RenderBoundingBox)
+			{
+				const DepthRasterizer rasterizeDepth{ SelectDepthRasterizer() };
+				for (const TriangleBatch& batch : triangleBatches)
+				{
+					std::for_each(std::execution::par_unseq, batch.triangles.begin(), batch.triangles.end(), [&](const dae::Triangle& triangle)
+						{
+							(this->*rasterizeDepth)(triangle.vertices, screen);
+						});
+				}
+			}
+
+			for (const TriangleBatch& batch : triangleBatches)
+			{
+				RasterizeBatch(batch);
+			}
+		}
+
+		// The debug views only show the opaque meshes
+		if (m_RenderFireFX && m_pFireMesh && !m_RenderDepthBuffer && !m_RenderBoundingBox)
+		{
+			RenderTransparentMesh(m_pFireMesh.get(), frustum, view * proj);
+		}
 	
+		m_CoveredPixels = 0;
 		for (int pixelIndex{ 0 }; pixelIndex < allPixels; ++pixelIndex)
 		{
+			m_CoveredPixels += m_pDepthBufferPixels[pixelIndex] != FLT_MAX;
+
 			if (m_RenderDepthBuffer)
 			{
 				const float depthValue{ m_pDepthBufferPixels[pixelIndex] };
@@ -169,6 +314,8 @@ namespace dae {
 		SDL_UnlockSurface(m_pBackBuffer);
 		SDL_BlitSurface(m_pBackBuffer, 0, m_pFrontBuffer, 0);
 		SDL_UpdateWindowSurface(m_pWindow);
+
+		m_SoftwareFrameMs = std::chrono::duration<float, std::milli>(std::chrono::steady_clock::now() - start).count();
 	}
 
 	void Renderer::ToggleRenderMethod()
@@ -227,7 +374,7 @@ namespace dae {
 		default:
 			break;
 		}
-		m_pMesh->SetCullingMode(m_CullMode);
+		if (m_pMesh) m_pMesh->SetCullingMode(m_CullMode);
 
 		SetConsoleTextAttribute(hConsole, 15);
 	}
@@ -250,8 +397,6 @@ namespace dae {
 
 	void Renderer::ToggleFireEffect()
 	{
-		if (m_RenderMethod != DirectX) return;
-
 		HANDLE hConsole = GetStdHandle(STD_OUTPUT_HANDLE);
 		SetConsoleTextAttribute(hConsole, 2);
 		m_RenderFireFX = !m_RenderFireFX;
@@ -290,7 +435,7 @@ namespace dae {
 			break;
 		}
 
-		m_pMesh->SetSamplerState(m_SampleState);
+		if (m_pMesh) m_pMesh->SetSamplerState(m_SampleState);
 		SetConsoleTextAttribute(hConsole, 15);
 	}
 
@@ -378,282 +523,1152 @@ namespace dae {
 		SetConsoleTextAttribute(hConsole, 15);
 	}
 
-	void Renderer::RenderMesh(Mesh* mesh)
+	void Renderer::ToggleClusteredMesh()
 	{
-		std::vector<uint32_t> indices(3);
-		std::vector<dae::Triangle> triangles{};
-
-		dae::Matrix view{ m_pCamera->invViewMatrix };
-		dae::Matrix proj{ m_pCamera->ProjectionMatrix };
-		const dae::Matrix worldViewProjectionMatrix{ mesh->WorldMatrix * view * proj };
+		if (m_RenderMethod != Software) return;
 
-		int increment = (mesh->m_PrimitiveTopology == dae::PrimitiveTopology::TriangleList) ? 3 : 1;
-		for (int indicesIndex = 0; indicesIndex < mesh->m_Indices.size() - 2; indicesIndex += increment)
+		HANDLE hConsole = GetStdHandle(STD_OUTPUT_HANDLE);
+		SetConsoleTextAttribute(hConsole, 5);
+		if (!m_pClusteredMesh)
 		{
-			bool isOdd = (indicesIndex % 2) != 0 && mesh->m_PrimitiveTopology == dae::PrimitiveTopology::TriangleStrip;
-
-			// Calculate indices for current triangle
-			indices = {
-				mesh->m_Indices[indicesIndex],
-				mesh->m_Indices[indicesIndex + (isOdd ? 2 : 1)],
-				mesh->m_Indices[indicesIndex + (isOdd ? 1 : 2)],
-			};
-
-			// Skip degenerate triangles
-			if (indices[0] == indices[1] || indices[1] == indices[2] || indices[0] == indices[2]) continue;
-
-			// Prepare vertices
-			std::vector<dae::Vertex_Out> out;
-			std::vector<dae::Vertex_In> in{ mesh->m_Vertices[indices[0]], mesh->m_Vertices[indices[1]], mesh->m_Vertices[indices[2]] };
-
-			// Transform vertices and cull
-			bool culling{ false };
-			VertexTransformationFunction(in, out, culling, mesh->WorldMatrix);
-
-			if (culling || out.size() != 3) continue;
+			// Opened on first use, the clusters only exist after running the AssetCooker
+			m_pClusteredMesh = std::make_unique<ClusteredMesh>(AssetFormat::GetClusteredPath(m_VehicleStream.name), AssetFormat::GetSourceTime(m_VehicleStream.name), m_ClusterMemoryBudget);
+		}
 
-			triangles.emplace_back(dae::Triangle{ out });
+		if (!m_pClusteredMesh->IsOpen())
+		{
+			std::cout << "**Out-of-core Vehicle unavailable, cook the assets first (or again, after editing the source)" << std::endl;
+			SetConsoleTextAttribute(hConsole, 15);
+			return;
 		}
 
-		std::for_each(std::execution::par_unseq, triangles.begin(), triangles.end(), [&](dae::Triangle triangle)
-			{
-				RenderTriangle(triangle.vertices, mesh);
-			});
+		m_UseClusteredMesh = !m_UseClusteredMesh;
+		if (m_UseClusteredMesh)
+		{
+			std::cout << "**Out-of-core Vehicle = ON (budget " << m_ClusterMemoryBudget / (1024 * 1024) << " MB)" << std::endl;
+		}
+		else
+		{
+			const ClusteredMesh::Stats& stats{ m_pClusteredMesh->GetStats() };
+			std::cout << "**Out-of-core Vehicle = OFF (" << stats.residentClusters << " clusters, "
+				<< stats.residentBytes / 1024 << " KB resident, last frame " << stats.visibleClusters << " visible, "
+				<< stats.pagedIn << " paged in, " << stats.evicted << " evicted, " << stats.skipped << " skipped, "
+				<< stats.occluded << " occluded)" << std::endl;
+		}
+		SetConsoleTextAttribute(hConsole, 15);
 	}
 
-	void Renderer::RenderTriangle(const std::vector<Vertex_Out>& vertices_ndc, const Mesh* pMesh)
+	void Renderer::ToggleVehicleFleet()
 	{
-		// Creating X and Y position containers
-		const std::vector<float> xPositions{ vertices_ndc[0].position.x,vertices_ndc[1].position.x,vertices_ndc[2].position.x };
-		const std::vector<float> yPositions{ vertices_ndc[0].position.y,vertices_ndc[1].position.y,vertices_ndc[2].position.y };
-
-		// Bounding box caculations
-		float minX{ *std::min_element(xPositions.begin(), xPositions.end()) };
-		float minY{ *std::min_element(yPositions.begin(), yPositions.end()) };
-		minX = std::floor(std::max(0.f, minX));
-		minY = std::floor(std::max(0.f, minY));
-
-		float maxX{ *std::max_element(xPositions.begin(), xPositions.end()) };
-		float maxY{ *std::max_element(yPositions.begin(), yPositions.end()) };
-		maxX = std::ceil(std::min((float)m_Width, maxX));
-		maxY = std::ceil(std::min((float)m_Height, maxY));
-
-		// Precaculating the area 
-		const Vector2 v0{ vertices_ndc[1].position.GetXY() - vertices_ndc[0].position.GetXY() };
-		const Vector2 v1{ vertices_ndc[2].position.GetXY() - vertices_ndc[0].position.GetXY() };
-
-		const float area{ std::fabs(Vector2::Cross(v0,v1)) };
+		HANDLE hConsole = GetStdHandle(STD_OUTPUT_HANDLE);
+		SetConsoleTextAttribute(hConsole, 6);
+		m_RenderFleet = !m_RenderFleet;
 
-		float weights[3]{};
+		// The fire gets the same list so every copy keeps its flames
+		const std::vector<Matrix> instances{ GetFleetInstances() };
+		if (m_pMesh) m_pMesh->SetInstances(instances);
+		if (m_pFireMesh) m_pFireMesh->SetInstances(instances);
 
-		for (int px = static_cast<int>(minX); px < static_cast<int>(maxX); ++px)
+		if (m_RenderFleet)
 		{
-			for (int py = static_cast<int>(minY); py < static_cast<int>(maxY); ++py)
-			{
-				uint32_t pixelIndex = px + py * m_Width;
-				if (!m_RenderBoundingBox)
-				{
-					PixelTriangleTest(pixelIndex, pMesh, vertices_ndc, area, weights);
-				}
-				else
-				{
-					ColorRGB finalColor{ 1,1,1 };
-
-					finalColor.MaxToOne();
-
-					m_pBackBufferPixels[pixelIndex] = SDL_MapRGB(m_pBackBuffer->format,
-						static_cast<uint8_t>(finalColor.r * 255),
-						static_cast<uint8_t>(finalColor.g * 255),
-						static_cast<uint8_t>(finalColor.b * 255));
-				}
-
-			}
+			std::cout << "**Vehicle Fleet = ON (" << instances.size() << " instances)**" << std::endl;
+		}
+		else
+		{
+			std::cout << "**Vehicle Fleet = OFF**" << std::endl;
 		}
+		SetConsoleTextAttribute(hConsole, 15);
 	}
 
-	void Renderer::PixelTriangleTest(uint32_t pixelIndex, const Mesh* pMesh, const std::vector<Vertex_Out>& vertices_ndc, const float& area, float* weights)
+	void Renderer::ToggleOcclusionCulling()
 	{
-		ColorRGB finalColor{ .25f,.25f,.25f };
-
-		const int px{ (int)pixelIndex % m_Width };
-		const int py{ (int)pixelIndex / m_Width };
-		const float pixel_x{ px + 0.5f };
-		const float pixel_y{ py + 0.5f };
+		HANDLE hConsole = GetStdHandle(STD_OUTPUT_HANDLE);
+		SetConsoleTextAttribute(hConsole, 6);
+		m_UseOcclusionCulling = !m_UseOcclusionCulling;
 
-		const Vector2& point{ pixel_x,pixel_y };
+		if (m_UseOcclusionCulling)
+		{
+			std::cout << "**Occlusion Culling = ON**" << std::endl;
+		}
+		else
+		{
+			const OcclusionBuffer::Stats& stats{ m_OcclusionBuffer.GetStats() };
+			std::cout << "**Occlusion Culling = OFF (last frame " << stats.occluderTriangles << " occluder triangles, "
+				<< stats.occluded << " of " << stats.tests << " tests occluded)**" << std::endl;
+		}
+		SetConsoleTextAttribute(hConsole, 15);
+	}
 
-		auto v0{ vertices_ndc[0].position.GetXY() };
-		auto v1{ vertices_ndc[1].position.GetXY() };
-		auto v2{ vertices_ndc[2].position.GetXY() };
+	void Renderer::ToggleSpecularPower()
+	{
+		if (m_RenderMethod != Software) return;
 
-		auto sin1{ Vector2::Cross(v1 - v0, point - v0) / area };
-		auto sin2{ Vector2::Cross(v2 - v1, point - v1) / area };
-		auto sin3{ Vector2::Cross(v0 - v2, point - v2) / area };
+		HANDLE hConsole = GetStdHandle(STD_OUTPUT_HANDLE);
+		SetConsoleTextAttribute(hConsole, 5);
+		switch (m_SpecularPowerMode)
+		{
+		case SpecularPowerMode::Exact:
+			m_SpecularPowerMode = SpecularPowerMode::Lookup;
+			std::cout << "**Specular Power = LOOKUP TABLE**" << std::endl;
+			break;
+		case SpecularPowerMode::Lookup:
+			m_SpecularPowerMode = SpecularPowerMode::Exact;
+			std::cout << "**Specular Power = STD::POW**" << std::endl;
+			break;
+		}
+		SetConsoleTextAttribute(hConsole, 15);
+	}
 
-		auto sum{ sin1 + sin2 + sin3 };
+	void Renderer::BenchmarkSpecularPower()
+	{
+		HANDLE hConsole = GetStdHandle(STD_OUTPUT_HANDLE);
+		SetConsoleTextAttribute(hConsole, 5);
+		std::cout << "**Specular Power benchmark, error against std::pow**" << std::endl;
 
-		//Triangle check if the point even is within the triangle
-		bool isInNotTriangle{ !(std::abs(sum - 1) <= EPS) && !(std::abs(sum + 1) <= EPS) };
-		if (isInNotTriangle) return;
+		const std::array<std::pair<SpecularPowerMode, const char*>, 2> modes{ {
+			{ SpecularPowerMode::Exact, "std::pow" },
+			{ SpecularPowerMode::Lookup, "lookup table" } } };
+		for (const auto& [mode, name] : modes)
+		{
+			const SpecularPowerReport report{ MeasureSpecularPower(mode, m_SpecularLut) };
+			std::cout << "  " << name << ": " << report.nanosecondsPerCall << " ns per call, max error " << report.maxError
+				<< " (cos " << report.maxErrorCosAngle << ", gloss " << report.maxErrorGloss << ")" << std::endl;
+		}
+		SetConsoleTextAttribute(hConsole, 15);
+	}
 
-		weights[0] = sin1;
-		weights[1] = sin2;
-		weights[2] = sin3;
+	void Renderer::TogglePointLights()
+	{
+		if (m_RenderMethod != Software) return;
 
-		//Culling checking
-		bool culling{ false };
-		if (m_CullMode != None)
+		HANDLE hConsole = GetStdHandle(STD_OUTPUT_HANDLE);
+		SetConsoleTextAttribute(hConsole, 5);
+		if (m_Lights.size() == 1)
 		{
-			if (m_CullMode == Back)
-			{
-				culling = !(weights[0] >= 0.f && weights[1] >= 0.f && weights[2] >= 0.f);
-			}
-			else
-			{
-				culling = !(weights[0] < 0.f && weights[1] < 0.f && weights[2] < 0.f);
-			}
+			CreatePointLights();
+			std::cout << "**Point Lights = ON (" << m_Lights.size() - 1 << " point and spot lights)**" << std::endl;
 		}
 		else
 		{
-			culling = !((weights[0] < 0.f && weights[1] < 0.f && weights[2] < 0.f) || (weights[0] >= 0.f && weights[1] >= 0.f && weights[2] >= 0.f));
-
+			const TiledLightCulling::Stats& stats{ m_pLightCulling->GetStats() };
+			std::cout << "**Point Lights = OFF (last frame " << stats.lights << " lights, " << static_cast<float>(stats.tileLights) / stats.tiles
+				<< " per tile on average, at most " << stats.maxTileLights << ")**" << std::endl;
+			m_Lights.resize(1);
+			m_PointLightAnchors.clear();
 		}
+		SetConsoleTextAttribute(hConsole, 15);
+	}
 
-		if (culling) return;
-
-		//Moving each weight to fit my design
-		weights[2] = std::abs(sin1);
-		weights[0] = std::abs(sin2);
-		weights[1] = std::abs(sin3);
-
-		//Depth caculation
-		float depth{ ((weights[0] / vertices_ndc[0].position.z) + (weights[1] / vertices_ndc[1].position.z) + (weights[2] / vertices_ndc[2].position.z)) };
-		depth = 1.f / depth;
-
-		//Making sure depth is within a valid range of [0,1]
-		if (m_pDepthBufferPixels[pixelIndex] < depth || (depth > 1 || depth < 0)) return;
-		m_pDepthBufferPixels[pixelIndex] = depth;
+	void Renderer::ToggleShadows()
+	{
+		if (m_RenderMethod != Software) return;
 
-		float w_interpolated{ 0 };
-		Vector2 caculated_uv{};
+		HANDLE hConsole = GetStdHandle(STD_OUTPUT_HANDLE);
+		SetConsoleTextAttribute(hConsole, 5);
+		m_UseShadows = !m_UseShadows;
 
-		if (m_RenderDepthBuffer)
+		if (m_UseShadows)
 		{
-			m_MinDepth = std::min(m_MinDepth, depth);
-			m_MaxDepth = std::max(m_MaxDepth, depth);
+			std::cout << "**Shadows = ON**" << std::endl;
 		}
 		else
 		{
-			for (int index{ 0 }; index < vertices_ndc.size(); ++index)
-			{
-				caculated_uv += (vertices_ndc[index].uv / vertices_ndc[index].position.w) * weights[index];
-				w_interpolated += (1.f / vertices_ndc[index].position.w) * weights[index];
-			}
+			std::cout << "**Shadows = OFF (last frame the shadow map took " << m_ShadowPassMs << " ms)**" << std::endl;
+		}
+		SetConsoleTextAttribute(hConsole, 15);
+	}
 
-			w_interpolated = 1.f / w_interpolated;
-			caculated_uv *= w_interpolated;
+	void Renderer::ToggleDepthPrepass()
+	{
+		if (m_RenderMethod != Software) return;
 
-			Vector3 normal{};
-			Vector3 tangent{};
-			Vector3 viewDirection{};
+		HANDLE hConsole = GetStdHandle(STD_OUTPUT_HANDLE);
+		SetConsoleTextAttribute(hConsole, 5);
 
-			for (int index{ 0 }; index < vertices_ndc.size(); ++index)
-			{
-				normal += vertices_ndc[index].normal * weights[index];
-				tangent += vertices_ndc[index].tangent * weights[index];
-				viewDirection += vertices_ndc[index].viewDirection * weights[index];
-			}
+		// Stats of the mode that was on, to compare against the next frames
+		const uint32_t shadedFragments{ m_ShadedFragments };
+		const float overdraw{ m_CoveredPixels > 0 ? static_cast<float>(shadedFragments) / m_CoveredPixels : 0.f };
+		m_UseDepthPrepass = !m_UseDepthPrepass;
 
-			const ColorRGB sampledColor{ m_pMesh->GetDiffuseMap()->Sample(caculated_uv) };
-			const Vertex_Out pixelVertex{ {},caculated_uv,normal.Normalized(),tangent.Normalized() };
+		std::cout << "**Depth Pre-pass = " << (m_UseDepthPrepass ? "ON" : "OFF") << " (last frame shaded " << shadedFragments
+			<< " fragments for " << m_CoveredPixels << " covered pixels, " << overdraw << " per pixel)**" << std::endl;
+		SetConsoleTextAttribute(hConsole, 15);
+	}
 
-			finalColor = PixelShading(pixelVertex, viewDirection.Normalized(), sampledColor, pMesh);
-		}
+	void Renderer::ToggleFrontToBack()
+	{
+		if (m_RenderMethod != Software) return;
 
-		finalColor.MaxToOne();
+		HANDLE hConsole = GetStdHandle(STD_OUTPUT_HANDLE);
+		SetConsoleTextAttribute(hConsole, 5);
 
-		m_pBackBufferPixels[pixelIndex] = SDL_MapRGB(m_pBackBuffer->format,
-			static_cast<uint8_t>(finalColor.r * 255),
-			static_cast<uint8_t>(finalColor.g * 255),
-			static_cast<uint8_t>(finalColor.b * 255));
+		// Stats of the mode that was on, to compare against the next frames
+		const uint32_t shadedFragments{ m_ShadedFragments };
+		const uint32_t rejectedFragments{ m_RejectedFragments };
+		const uint32_t testedFragments{ shadedFragments + rejectedFragments };
+		const float rejectRate{ testedFragments > 0 ? 100.f * rejectedFragments / testedFragments : 0.f };
+		m_SortFrontToBack = !m_SortFrontToBack;
 
+		std::cout << "**Front To Back = " << (m_SortFrontToBack ? "ON" : "OFF") << " (last frame took " << m_SoftwareFrameMs << " ms, shaded "
+			<< shadedFragments << " and rejected " << rejectedFragments << " fragments, " << rejectRate << "% rejected)**" << std::endl;
+		SetConsoleTextAttribute(hConsole, 15);
 	}
 
-	ColorRGB Renderer::PixelShading(const Vertex_Out& vertex, const Vector3& viewDirection, const ColorRGB& sampledColor, const Mesh* pMesh)
+	void Renderer::CycleShadingTier()
 	{
-		Vector3 normal{ vertex.normal };
-		if (m_UseNormalMap)
-		{
-			const Vector3 binormal{ Vector3::Cross(vertex.normal, vertex.tangent) };
-			const Matrix tangentSpaceAxis{ vertex.tangent, binormal, vertex.normal, Vector3::Zero };
-			const ColorRGB sampledNormal{ pMesh->GetNormalMap()->Sample(vertex.uv) / 255.f };
+		if (m_RenderMethod != Software) return;
 
-			Vector3 caculatedNormal{ sampledNormal.r, sampledNormal.g, sampledNormal.b };
-			caculatedNormal = 2.f * caculatedNormal - Vector3{ 1.f, 1.f, 1.f };
+		HANDLE hConsole = GetStdHandle(STD_OUTPUT_HANDLE);
+		SetConsoleTextAttribute(hConsole, 5);
 
-			Vector3 transformedNormal{ tangentSpaceAxis.TransformVector(caculatedNormal) };
-			transformedNormal.Normalize();
-			normal = transformedNormal;
+		switch (m_ShadingTier)
+		{
+		case ShadingTier::ByScreenSize:
+			m_ShadingTier = ShadingTier::PerVertex;
+			std::cout << "**Shading Tier = PER VERTEX**" << std::endl;
+			break;
+		case ShadingTier::PerVertex:
+			m_ShadingTier = ShadingTier::PerPixel;
+			std::cout << "**Shading Tier = PER PIXEL**" << std::endl;
+			break;
+		case ShadingTier::PerPixel:
+			m_ShadingTier = ShadingTier::ByScreenSize;
+			std::cout << "**Shading Tier = BY SCREEN SIZE**" << std::endl;
+			break;
 		}
+		SetConsoleTextAttribute(hConsole, 15);
+	}
 
+	std::vector<Matrix> Renderer::GetFleetInstances() const
+	{
+		// One grid of copies behind the vehicle, none when the fleet is off
+		std::vector<Matrix> instances{};
+		if (m_RenderFleet)
+		{
+			for (int row{ 0 }; row < m_FleetSize; ++row)
+			{
+				for (int column{ 0 }; column < m_FleetSize; ++column)
+				{
+					const float x{ (column - m_FleetSize / 2) * m_FleetSpacing };
+					instances.push_back(Matrix::CreateTranslation({ x, 0.f, row * m_FleetSpacing }));
+				}
+			}
+		}
+		return instances;
+	}
 
+	void Renderer::GatherBatches(Mesh* pMesh, const Frustum& frustum, std::vector<DrawBatch>& batches) const
+	{
+		// Whole mesh outside the view, skip walking its indices
+		if (!pMesh->IsVisible(frustum)) return;
 
-		const float observedArea{ std::max(Vector3::Dot(normal, m_InvLightDirection), 0.f) };
-		const ColorRGB lambert{ GetDiffuse(sampledColor) };
-		const ColorRGB specular{ GetSpecular(vertex,normal,viewDirection,pMesh) };
+		// Instances all read the same world space vertices, moved by their own matrix
+		pMesh->UpdateWorldVertices();
 
+		std::vector<uint32_t> instances{};
+		pMesh->GatherVisibleInstances(frustum, instances, &m_OcclusionBuffer);
 
-		switch (m_ShadingMode)
+		// Instances of a submesh stay next to each other, its vertices and maps stay in cache
+		const uint32_t activeLod{ pMesh->GetActiveLodIndex() };
+		for (const SubMesh& subMesh : pMesh->GetSubMeshes())
 		{
-		case dae::Combined:
-			return ((lambert * observedArea) / 255.f) + specular;
-		case dae::Observed:
-			return (colors::White * observedArea);
-		case dae::Diffuse:
-			return lambert / 255.f;
-		case dae::Specular:
-			return specular;
-		}
+			if (subMesh.lods[activeLod].indexCount == 0)
+				continue;
 
+			for (const uint32_t instance : instances)
+			{
+				const Matrix* pInstance{ pMesh->HasInstances() ? &pMesh->GetInstance(instance) : nullptr };
+				batches.push_back(DrawBatch{ pMesh, subMesh.lods[activeLod], pMesh->GetMaterial(subMesh.material), pInstance, SelectShadingTier(pMesh->GetInstanceSphere(instance)) });
+			}
+		}
 	}
 
-	void Renderer::ExtractFrustumPlanes(const Matrix& viewProjectionMatrix, Frustum& frustum) const
+	void Renderer::RenderShadowMap()
 	{
-		// Access the matrix rows
-		const Vector4& row0 = viewProjectionMatrix[0]; // x-axis
-		const Vector4& row1 = viewProjectionMatrix[1]; // y-axis
-		const Vector4& row2 = viewProjectionMatrix[2]; // z-axis
-		const Vector4& row3 = viewProjectionMatrix[3]; // translation
+		const auto start{ std::chrono::steady_clock::now() };
 
-		// Extract frustum planes from the view-projection matrix
-		frustum.nearFace = Plane{
-			Vector3(row3.x + row2.x, row3.y + row2.y, row3.z + row2.z), // Normal
-			row3.w + row2.w // Distance
-		};
+		// Around every vehicle, the ones outside the view still throw shadows into it
+		m_ShadowMap.Begin(m_Lights[0].direction, m_pMesh ? m_pMesh->GetWorldSphere() : BoundingSphere{});
+		if (!m_UseShadows || !m_pMesh)
+			return;
 
-		frustum.farFace = Plane{
-			Vector3(row3.x - row2.x, row3.y - row2.y, row3.z - row2.z), // Normal
-			row3.w - row2.w // Distance
+		Frustum lightFrustum;
+		ExtractFrustumPlanes(m_ShadowMap.GetViewProjection(), lightFrustum);
+
+		std::vector<uint32_t> instances{};
+		m_pMesh->GatherVisibleInstances(lightFrustum, instances);
+
+		m_pMesh->UpdateWorldVertices();
+		const std::vector<Vertex_In>& worldVertices{ m_pMesh->GetWorldVertices() };
+		const MeshGeometry& geometry{ m_pMesh->GetGeometry() };
+		const uint32_t activeLod{ m_pMesh->GetActiveLodIndex() };
+		const float size{ static_cast<float>(m_ShadowMap.GetSize()) };
+
+		// Only positions, straight into shadow map pixels and depth
+		std::vector<Vector4> positions(worldVertices.size());
+		std::vector<std::array<Vector4, 3>> triangles{};
+		for (const uint32_t instance : instances)
+		{
+			const Matrix lightViewProjection{ m_pMesh->HasInstances() ? m_pMesh->GetInstance(instance) * m_ShadowMap.GetViewProjection() : m_ShadowMap.GetViewProjection() };
+			std::transform(std::execution::par_unseq, worldVertices.begin(), worldVertices.end(), positions.begin(), [&](const Vertex_In& vertex)
+				{
+					const Vector4 clip{ lightViewProjection.TransformPoint(vertex.position.ToPoint4()) };
+					return Vector4{ ((clip.x + 1) / 2) * size, ((1 - clip.y) / 2) * size, clip.z, 1.f };
+				});
+
+			// Depth does not care about winding, strips only need their degenerate joins skipped
+			triangles.clear();
+			const size_t increment{ m_pMesh->m_PrimitiveTopology == dae::PrimitiveTopology::TriangleList ? 3u : 1u };
+			for (const SubMesh& subMesh : m_pMesh->GetSubMeshes())
+			{
+				const std::span<const uint32_t> indices{ geometry.GetIndices(subMesh.lods[activeLod]) };
+				for (size_t index{ 0 }; index + 2 < indices.size(); index += increment)
+				{
+					if (indices[index] == indices[index + 1] || indices[index + 1] == indices[index + 2] || indices[index] == indices[index + 2]) continue;
+					triangles.push_back({ positions[indices[index]], positions[indices[index + 1]], positions[indices[index + 2]] });
+				}
+			}
+
+			std::for_each(std::execution::par_unseq, triangles.begin(), triangles.end(), [this](const std::array<Vector4, 3>& triangle)
+				{
+					RenderShadowTriangle(triangle);
+				});
+		}
+
+		m_ShadowPassMs = std::chrono::duration<float, std::milli>(std::chrono::steady_clock::now() - start).count();
+	}
+
+	void Renderer::RenderOccluders(const Frustum& frustum, const Matrix& viewProjection)
+	{
+		m_OcclusionBuffer.Clear(viewProjection);
+		if (!m_UseOcclusionCulling || !m_pMesh || !m_pMesh->IsVisible(frustum))
+			return;
+		if (m_pMesh->m_PrimitiveTopology != dae::PrimitiveTopology::TriangleList)
+			return;
+
+		// The nearest vehicles hide the most, the fire is see-through and never occludes anything
+		std::vector<uint32_t> instances{};
+		m_pMesh->GatherVisibleInstances(frustum, instances);
+
+		const size_t occluderCount{ std::min(instances.size(), m_MaxOccluders) };
+		std::partial_sort(instances.begin(), instances.begin() + occluderCount, instances.end(), [this](uint32_t a, uint32_t b)
+			{
+				return (m_pMesh->GetInstanceSphere(a).center - m_pCamera->origin).SqrMagnitude() < (m_pMesh->GetInstanceSphere(b).center - m_pCamera->origin).SqrMagnitude();
+			});
+
+		// The LOD that is drawn, so nothing is hidden behind a silhouette that is not on screen
+		m_pMesh->UpdateWorldVertices();
+		const MeshGeometry& geometry{ m_pMesh->GetGeometry() };
+		const uint32_t activeLod{ m_pMesh->GetActiveLodIndex() };
+
+		for (size_t occluder{ 0 }; occluder < occluderCount; ++occluder)
+		{
+			const Matrix* pInstance{ m_pMesh->HasInstances() ? &m_pMesh->GetInstance(instances[occluder]) : nullptr };
+			m_OcclusionBuffer.SetOccluderVertices(m_pMesh->GetWorldVertices(), pInstance);
+
+			for (const SubMesh& subMesh : m_pMesh->GetSubMeshes())
+			{
+				m_OcclusionBuffer.RasterizeTriangles(geometry.GetIndices(subMesh.lods[activeLod]));
+			}
+		}
+
+		m_OcclusionBuffer.Finish();
+	}
+
+	void Renderer::TransformBatch(const DrawBatch& batch, std::vector<Triangle>& triangles) const
+	{
+		const Mesh* mesh{ batch.pMesh };
+		const MeshGeometry& geometry{ mesh->GetGeometry() };
+		const std::vector<Vertex_In>& worldVertices{ mesh->GetWorldVertices() };
+
+		const uint32_t firstIndex{ batch.range.startIndex };
+		const uint32_t endIndex{ batch.range.startIndex + batch.range.indexCount };
+
+		triangles.reserve(batch.range.indexCount / 3);
+
+		int increment = (mesh->m_PrimitiveTopology == dae::PrimitiveTopology::TriangleList) ? 3 : 1;
+		for (uint32_t indicesIndex = firstIndex; indicesIndex + 2 < endIndex; indicesIndex += increment)
+		{
+			bool isOdd = ((indicesIndex - firstIndex) % 2) != 0 && mesh->m_PrimitiveTopology == dae::PrimitiveTopology::TriangleStrip;
+
+			// Calculate indices for current triangle
+			const std::array<uint32_t, 3> indices{
+				geometry.indices[indicesIndex],
+				geometry.indices[indicesIndex + (isOdd ? 2 : 1)],
+				geometry.indices[indicesIndex + (isOdd ? 1 : 2)],
+			};
+
+			// Skip degenerate triangles
+			if (indices[0] == indices[1] || indices[1] == indices[2] || indices[0] == indices[2]) continue;
+
+			// Prepare vertices, already decoded and in world space
+			std::array<dae::Vertex_In, 3> in{ worldVertices[indices[0]], worldVertices[indices[1]], worldVertices[indices[2]] };
+			if (batch.pInstance)
+			{
+				for (dae::Vertex_In& vertex : in)
+				{
+					vertex = Mesh::ToWorldSpace(vertex, *batch.pInstance);
+				}
+			}
+			dae::Triangle triangle{};
+			triangle.indices = indices;
+
+			// Transform vertices and cull
+			bool culling{ false };
+			VertexTransformationFunction(in, triangle.vertices, culling);
+
+			if (culling) continue;
+
+			triangles.push_back(triangle);
+		}
+	}
+
+	void Renderer::TransformClusteredMesh(ClusteredMesh* pClusteredMesh, const Mesh* pMesh, const Frustum& frustum, std::vector<TriangleBatch>& batches) const
+	{
+		const Matrix& worldMatrix{ pMesh->GetWorldMatrix() };
+
+		std::vector<ResidentCluster> clusters{};
+		pClusteredMesh->GatherClusters(frustum, *m_pCamera, worldMatrix, static_cast<float>(m_Height), clusters, &m_OcclusionBuffer);
+
+		// Grouped by material, still nearest first within each group
+		std::stable_sort(clusters.begin(), clusters.end(), [](const ResidentCluster& a, const ResidentCluster& b) { return a.material < b.material; });
+
+		std::vector<dae::Triangle> triangles{};
+		// Cluster indices are local, the vertices of each cluster are numbered after the ones before it in the batch
+		uint32_t firstVertex{ 0 };
+		for (size_t clusterIndex{ 0 }; clusterIndex < clusters.size(); ++clusterIndex)
+		{
+			const ResidentCluster& cluster{ clusters[clusterIndex] };
+			uint32_t vertexCount{ 0 };
+			for (uint32_t index{ 0 }; index + 2 < cluster.indexCount; index += 3)
+			{
+				const std::array<uint32_t, 3> indices{ cluster.pIndices[index], cluster.pIndices[index + 1], cluster.pIndices[index + 2] };
+				vertexCount = std::max({ vertexCount, indices[0] + 1, indices[1] + 1, indices[2] + 1 });
+
+				const std::array<dae::Vertex_In, 3> in{
+					cluster.pVertices[indices[0]],
+					cluster.pVertices[indices[1]],
+					cluster.pVertices[indices[2]] };
+				dae::Triangle triangle{};
+				triangle.indices = { firstVertex + indices[0], firstVertex + indices[1], firstVertex + indices[2] };
+
+				bool culling{ false };
+				VertexTransformationFunction(in, triangle.vertices, culling, worldMatrix);
+
+				if (culling) continue;
+
+				triangles.push_back(triangle);
+			}
+			firstVertex += vertexCount;
+
+			// One batch per material
+			if (clusterIndex + 1 == clusters.size() || clusters[clusterIndex + 1].material != cluster.material)
+			{
+				batches.push_back(TriangleBatch{ pMesh->GetMaterial(cluster.material), std::move(triangles), worldMatrix, SelectShadingTier(pMesh->GetWorldSphere()) });
+				triangles = {};
+				firstVertex = 0;
+			}
+		}
+	}
+
+	void Renderer::CullLights(std::span<const TriangleBatch> batches)
+	{
+		m_pLightCulling->ResetDepthBounds();
+		for (const TriangleBatch& batch : batches)
+		{
+			for (const Triangle& triangle : batch.triangles)
+			{
+				// The pixels a triangle can touch lie inside its bounds and between its nearest and farthest corner
+				int minX{}, minY{}, maxX{}, maxY{};
+				GetPixelBounds(triangle.vertices, { 0, 0, m_Width, m_Height }, minX, minY, maxX, maxY);
+
+				const auto [nearest, farthest] { std::minmax({ triangle.vertices[0].position.w, triangle.vertices[1].position.w, triangle.vertices[2].position.w }) };
+				m_pLightCulling->AddDepthBounds(minX, minY, maxX, maxY, nearest, farthest);
+			}
+		}
+
+		m_pLightCulling->CullLights(m_Lights, m_pCamera->invViewMatrix, m_pCamera->ProjectionMatrix);
+	}
+
+	void Renderer::RasterizeBatch(const TriangleBatch& batch)
+	{
+		const PixelRect screen{ 0, 0, m_Width, m_Height };
+		std::for_each(std::execution::par_unseq, batch.triangles.begin(), batch.triangles.end(), [&](const dae::Triangle& triangle)
+			{
+				(this->*batch.pRasterize)(triangle.vertices, batch, screen);
+			});
+	}
+
+	ShadingTier Renderer::SelectShadingTier(const BoundingSphere& sphere) const
+	{
+		if (m_ShadingTier != ShadingTier::ByScreenSize)
+			return m_ShadingTier;
+
+		// Projected diameter in pixels, same projection as the LOD selection
+		const float distance{ (sphere.center - m_pCamera->origin).Magnitude() };
+		if (distance <= sphere.radius)
+			return ShadingTier::PerPixel;
+
+		const float screenSize{ sphere.radius * m_Height / (m_pCamera->fov * distance) };
+		return screenSize < m_VertexLightingScreenSize ? ShadingTier::PerVertex : ShadingTier::PerPixel;
+	}
+
+	template<SpecularPowerMode specularPowerMode>
+	void Renderer::LightVertices(TriangleBatch& batch) const
+	{
+		// Off screen or facing the culled way, the rasterizer would not cover a pixel of these
+		const PixelRect screen{ 0, 0, m_Width, m_Height };
+		std::erase_if(batch.triangles, [&](const Triangle& triangle)
+			{
+				int minX{}, minY{}, maxX{}, maxY{};
+				GetPixelBounds(triangle.vertices, screen, minX, minY, maxX, maxY);
+				if (minX >= maxX || minY >= maxY) return true;
+
+				// Positive is what GetPixelCoverage counts as front facing, zero covers nothing
+				const Vector2 v0{ triangle.vertices[1].position.GetXY() - triangle.vertices[0].position.GetXY() };
+				const Vector2 v1{ triangle.vertices[2].position.GetXY() - triangle.vertices[0].position.GetXY() };
+				const float area{ Vector2::Cross(v0, v1) };
+				switch (m_CullMode)
+				{
+				case Back:
+					return area <= 0.f;
+				case Front:
+					return area >= 0.f;
+				default:
+					return area == 0.f;
+				}
+			});
+
+		// Vertex in the high half and corner in the low half, sorting groups the corners sharing a vertex
+		std::vector<uint64_t> corners(batch.triangles.size() * 3);
+		for (size_t corner{ 0 }; corner < corners.size(); ++corner)
+		{
+			corners[corner] = static_cast<uint64_t>(batch.triangles[corner / 3].indices[corner % 3]) << 32 | corner;
+		}
+		std::sort(std::execution::par_unseq, corners.begin(), corners.end());
+
+		std::vector<size_t> firstCorners{};
+		for (size_t corner{ 0 }; corner < corners.size(); ++corner)
+		{
+			if (corner == 0 || corners[corner] >> 32 != corners[corner - 1] >> 32) firstCorners.push_back(corner);
+		}
+		firstCorners.push_back(corners.size());
+
+		const Material& material{ batch.material };
+		std::vector<size_t> vertices(firstCorners.size() - 1);
+		std::iota(vertices.begin(), vertices.end(), size_t{ 0 });
+		std::for_each(std::execution::par_unseq, vertices.begin(), vertices.end(), [&](size_t sharedVertex)
+			{
+				const size_t firstCorner{ firstCorners[sharedVertex] };
+				const size_t endCorner{ firstCorners[sharedVertex + 1] };
+				const auto getVertex = [&](size_t sorted) -> Vertex_Out&
+					{
+						const uint32_t corner{ static_cast<uint32_t>(corners[sorted]) };
+						return batch.triangles[corner / 3].vertices[corner % 3];
+					};
+
+				Vertex_Out& vertex{ getVertex(firstCorner) };
+				const float gloss{ material.pGlossinessMap->Sample(vertex.uv).r / 255.f };
+
+				vertex.irradiance = {};
+				vertex.specular = {};
+				const auto addLight = [&](const Light& light)
+					{
+						Vector3 toLight{};
+						float attenuation{ GetLightAttenuation(light, vertex.worldPosition, toLight) };
+						if (light.castsShadows && m_UseShadows)
+						{
+							attenuation *= m_ShadowMap.GetLitFraction(vertex.worldPosition, vertex.normal);
+						}
+						if (attenuation <= 0.f) return;
+
+						const ColorRGB radiance{ light.color * (light.intensity * attenuation) };
+						vertex.irradiance += radiance * std::max(Vector3::Dot(vertex.normal, toLight), 0.f);
+						vertex.specular += radiance * GetSpecular<specularPowerMode>(toLight, vertex.normal, vertex.viewDirection, gloss);
+					};
+
+				// A vertex on screen lies in a tile whose depth range holds it, so the tile's lights are all that reach it.
+				// No tile culled lights for one off screen, a light lighting only that corner still shows in its triangle.
+				const int px{ static_cast<int>(vertex.position.x) };
+				const int py{ static_cast<int>(vertex.position.y) };
+				if (px >= 0 && py >= 0 && px < m_Width && py < m_Height)
+				{
+					for (const uint32_t index : m_pLightCulling->GetLights(px, py))
+					{
+						addLight(m_Lights[index]);
+					}
+				}
+				else
+				{
+					for (const Light& light : m_Lights)
+					{
+						addLight(light);
+					}
+				}
+
+				vertex.specular *= material.pSpecularMap->Sample(vertex.uv) / 255.f;
+
+				for (size_t sorted{ firstCorner + 1 }; sorted < endCorner; ++sorted)
+				{
+					Vertex_Out& shared{ getVertex(sorted) };
+					shared.irradiance = vertex.irradiance;
+					shared.specular = vertex.specular;
+				}
+			});
+	}
+
+	void Renderer::LightVertices(TriangleBatch& batch) const
+	{
+		switch (m_SpecularPowerMode)
+		{
+		case SpecularPowerMode::Exact:
+			LightVertices<SpecularPowerMode::Exact>(batch);
+			break;
+		default:
+			LightVertices<SpecularPowerMode::Lookup>(batch);
+			break;
+		}
+	}
+
+	void Renderer::BinTriangles(std::span<const TriangleBatch> batches)
+	{
+		m_pTriangleBins->Clear();
+		const PixelRect screen{ 0, 0, m_Width, m_Height };
+		for (uint32_t batchIndex{ 0 }; batchIndex < batches.size(); ++batchIndex)
+		{
+			const std::vector<Triangle>& triangles{ batches[batchIndex].triangles };
+			for (uint32_t triangleIndex{ 0 }; triangleIndex < triangles.size(); ++triangleIndex)
+			{
+				const std::array<Vertex_Out, 3>& vertices{ triangles[triangleIndex].vertices };
+
+				PixelRect bounds{};
+				GetPixelBounds(vertices, screen, bounds.minX, bounds.minY, bounds.maxX, bounds.maxY);
+
+				// The nearest corner, a triangle in front of another is rarely behind it there
+				const float nearest{ std::min({ vertices[0].position.w, vertices[1].position.w, vertices[2].position.w }) };
+				m_pTriangleBins->Add({ batchIndex, triangleIndex }, bounds, nearest);
+			}
+		}
+
+		m_pTriangleBins->Sort();
+	}
+
+	void Renderer::RasterizeBins(std::span<const TriangleBatch> batches)
+	{
+		const bool useDepthPrepass{ m_UseDepthPrepass && !m_RenderBoundingBox };
+		const DepthRasterizer rasterizeDepth{ SelectDepthRasterizer() };
+
+		// No two tiles share a pixel, so the tiles need no locking and each one stays in cache for both passes
+		std::vector<size_t> tiles(m_pTriangleBins->GetTileCount());
+		std::iota(tiles.begin(), tiles.end(), size_t{ 0 });
+		std::for_each(std::execution::par_unseq, tiles.begin(), tiles.end(), [&](size_t tile)
+			{
+				const PixelRect clip{ m_pTriangleBins->GetTileRect(tile) };
+				const std::span<const TriangleBins::Reference> references{ m_pTriangleBins->GetTriangles(tile) };
+
+				if (useDepthPrepass)
+				{
+					for (const TriangleBins::Reference& reference : references)
+					{
+						(this->*rasterizeDepth)(batches[reference.batch].triangles[reference.triangle].vertices, clip);
+					}
+				}
+
+				for (const TriangleBins::Reference& reference : references)
+				{
+					const TriangleBatch& batch{ batches[reference.batch] };
+					(this->*batch.pRasterize)(batch.triangles[reference.triangle].vertices, batch, clip);
+				}
+			});
+	}
+
+	void Renderer::RenderTransparentMesh(Mesh* pMesh, const Frustum& frustum, const Matrix& viewProjection)
+	{
+		if (!pMesh->IsVisible(frustum)) return;
+
+		pMesh->UpdateWorldVertices();
+
+		std::vector<uint32_t> instances{};
+		pMesh->GatherVisibleInstances(frustum, instances, &m_OcclusionBuffer);
+
+		const RenderTarget target{ m_pBackBufferPixels, m_pDepthBufferPixels, m_pBackBuffer->format, m_Width, m_Height };
+		const MeshGeometry& geometry{ pMesh->GetGeometry() };
+		const uint32_t activeLod{ pMesh->GetActiveLodIndex() };
+
+		for (const uint32_t instance : instances)
+		{
+			// The world space vertices only miss the instance matrix, it is folded into the vertex shader's
+			const Matrix worldViewProjection{ pMesh->HasInstances() ? pMesh->GetInstance(instance) * viewProjection : viewProjection };
+
+			// The submeshes only differ in their diffuse map, the vertices of the LOD are shaded once for all of them
+			TransparentPipeline pipeline{ { worldViewProjection }, {}, target };
+			pipeline.ShadeVertices(pMesh->GetWorldVertices(), geometry.GetIndices(pMesh->GetLods()[activeLod]));
+
+			for (const SubMesh& subMesh : pMesh->GetSubMeshes())
+			{
+				if (subMesh.lods[activeLod].indexCount == 0)
+					continue;
+
+				pipeline.SetPixelShader({ pMesh->GetMaterial(subMesh.material).pDiffuseMap });
+				pipeline.DrawShaded(geometry.GetIndices(subMesh.lods[activeLod]), pMesh->m_PrimitiveTopology);
+			}
+		}
+	}
+
+	template<size_t... Indices>
+	constexpr auto Renderer::MakeRasterizers(std::index_sequence<Indices...>) -> std::array<TriangleRasterizer, sizeof...(Indices)>
+	{
+		// Index = (((cullMode * 2 + renderDepth) * NormalMapModeCount + normalMapMode) * SpecularPowerModeCount + specularPowerMode) * ShadingModeCount + shadingMode
+		return { &Renderer::RenderTriangle<
+			static_cast<CullMode>(Indices / (2 * NormalMapModeCount * SpecularPowerModeCount * ShadingModeCount)),
+			(Indices / (NormalMapModeCount * SpecularPowerModeCount * ShadingModeCount)) % 2 == 1,
+			static_cast<NormalMapMode>((Indices / (SpecularPowerModeCount * ShadingModeCount)) % NormalMapModeCount),
+			static_cast<SpecularPowerMode>((Indices / ShadingModeCount) % SpecularPowerModeCount),
+			static_cast<ShadingMode>(Indices % ShadingModeCount),
+			ShadingTier::PerPixel>... };
+	}
+
+	template<size_t... Indices>
+	constexpr auto Renderer::MakeVertexLitRasterizers(std::index_sequence<Indices...>) -> std::array<TriangleRasterizer, sizeof...(Indices)>
+	{
+		return { &Renderer::RenderTriangle<
+			static_cast<CullMode>(Indices / (2 * ShadingModeCount)),
+			(Indices / ShadingModeCount) % 2 == 1,
+			NormalMapMode::Off,
+			SpecularPowerMode::Lookup,
+			static_cast<ShadingMode>(Indices % ShadingModeCount),
+			ShadingTier::PerVertex>... };
+	}
+
+	Renderer::TriangleRasterizer Renderer::SelectRasterizer(const TriangleBatch& batch) const
+	{
+		static constexpr auto rasterizers{ MakeRasterizers(std::make_index_sequence<CullModeCount * 2 * NormalMapModeCount * SpecularPowerModeCount * ShadingModeCount>{}) };
+		static constexpr auto vertexLitRasterizers{ MakeVertexLitRasterizers(std::make_index_sequence<CullModeCount * 2 * ShadingModeCount>{}) };
+
+		if (m_RenderBoundingBox)
+			return &Renderer::RenderTriangleBounds;
+
+		if (batch.shadingTier == ShadingTier::PerVertex)
+		{
+			return vertexLitRasterizers[(static_cast<size_t>(m_CullMode) * 2 + m_RenderDepthBuffer) * ShadingModeCount + static_cast<size_t>(m_ShadingMode)];
+		}
+
+		const Material& material{ batch.material };
+
+		// Only the triangles the AssetCooker could bake have an object space map, the others keep the tangent frame
+		const NormalMapMode normalMapMode{ !m_UseNormalMap ? NormalMapMode::Off : material.pObjectNormalMap ? NormalMapMode::ObjectSpace : NormalMapMode::TangentSpace };
+		const size_t index{ (((static_cast<size_t>(m_CullMode) * 2 + m_RenderDepthBuffer) * NormalMapModeCount + static_cast<size_t>(normalMapMode)) * SpecularPowerModeCount + static_cast<size_t>(m_SpecularPowerMode)) * ShadingModeCount + static_cast<size_t>(m_ShadingMode) };
+		return rasterizers[index];
+	}
+
+	void Renderer::GetPixelBounds(std::span<const Vertex_Out, 3> vertices_ndc, const PixelRect& clip, int& minX, int& minY, int& maxX, int& maxY) const
+	{
+		GetPixelBounds(vertices_ndc[0].position, vertices_ndc[1].position, vertices_ndc[2].position, clip, minX, minY, maxX, maxY);
+	}
+
+	void Renderer::GetPixelBounds(const Vector4& v0, const Vector4& v1, const Vector4& v2, const PixelRect& clip, int& minX, int& minY, int& maxX, int& maxY)
+	{
+		// Bounding box caculations
+		minX = static_cast<int>(std::floor(std::max(static_cast<float>(clip.minX), std::min({ v0.x, v1.x, v2.x }))));
+		minY = static_cast<int>(std::floor(std::max(static_cast<float>(clip.minY), std::min({ v0.y, v1.y, v2.y }))));
+		maxX = static_cast<int>(std::ceil(std::min(static_cast<float>(clip.maxX), std::max({ v0.x, v1.x, v2.x }))));
+		maxY = static_cast<int>(std::ceil(std::min(static_cast<float>(clip.maxY), std::max({ v0.y, v1.y, v2.y }))));
+	}
+
+	template<CullMode cullMode, bool renderDepth, NormalMapMode normalMapMode, SpecularPowerMode specularPowerMode, ShadingMode shadingMode, ShadingTier shadingTier>
+	void Renderer::RenderTriangle(std::span<const Vertex_Out, 3> vertices_ndc, const TriangleBatch& batch, const PixelRect& clip)
+	{
+		int minX{}, minY{}, maxX{}, maxY{};
+		GetPixelBounds(vertices_ndc, clip, minX, minY, maxX, maxY);
+
+		// Precaculating the area 
+		const Vector2 v0{ vertices_ndc[1].position.GetXY() - vertices_ndc[0].position.GetXY() };
+		const Vector2 v1{ vertices_ndc[2].position.GetXY() - vertices_ndc[0].position.GetXY() };
+
+		const float area{ std::fabs(Vector2::Cross(v0,v1)) };
+
+		// Row by row, the same order the back buffer is laid out in
+		uint32_t shadedFragments{ 0 };
+		uint32_t rejectedFragments{ 0 };
+		for (int py{ minY }; py < maxY; ++py)
+		{
+			for (int px{ minX }; px < maxX; ++px)
+			{
+				const FragmentResult result{ PixelTriangleTest<cullMode, renderDepth, normalMapMode, specularPowerMode, shadingMode, shadingTier>(px, py, batch, vertices_ndc, area) };
+				shadedFragments += result == FragmentResult::Shaded;
+				rejectedFragments += result == FragmentResult::Rejected;
+			}
+		}
+
+		// Once per triangle, the threads would fight over the counters per pixel
+		m_ShadedFragments.fetch_add(shadedFragments, std::memory_order_relaxed);
+		m_RejectedFragments.fetch_add(rejectedFragments, std::memory_order_relaxed);
+	}
+
+	template<CullMode cullMode>
+	void Renderer::RenderTriangleDepth(std::span<const Vertex_Out, 3> vertices_ndc, const PixelRect& clip)
+	{
+		int minX{}, minY{}, maxX{}, maxY{};
+		GetPixelBounds(vertices_ndc, clip, minX, minY, maxX, maxY);
+
+		const Vector2 v0{ vertices_ndc[1].position.GetXY() - vertices_ndc[0].position.GetXY() };
+		const Vector2 v1{ vertices_ndc[2].position.GetXY() - vertices_ndc[0].position.GetXY() };
+		const float area{ std::fabs(Vector2::Cross(v0,v1)) };
+
+		for (int py{ minY }; py < maxY; ++py)
+		{
+			for (int px{ minX }; px < maxX; ++px)
+			{
+				float weights[3]{};
+				float depth{};
+				if (!GetPixelCoverage<cullMode>(px, py, vertices_ndc, area, weights, depth)) continue;
+
+				// The unbinned pre-pass runs triangles overlapping the same pixels in parallel
+				StoreMinDepth(m_pDepthBufferPixels[px + py * m_Width], depth);
+			}
+		}
+	}
+
+	Renderer::DepthRasterizer Renderer::SelectDepthRasterizer() const
+	{
+		switch (m_CullMode)
+		{
+		case Front:
+			return &Renderer::RenderTriangleDepth<Front>;
+		case None:
+			return &Renderer::RenderTriangleDepth<None>;
+		default:
+			return &Renderer::RenderTriangleDepth<Back>;
+		}
+	}
+
+	void Renderer::RenderTriangleBounds(std::span<const Vertex_Out, 3> vertices_ndc, const TriangleBatch&, const PixelRect& clip)
+	{
+		int minX{}, minY{}, maxX{}, maxY{};
+		GetPixelBounds(vertices_ndc, clip, minX, minY, maxX, maxY);
+
+		const uint32_t white{ SDL_MapRGB(m_pBackBuffer->format, 255, 255, 255) };
+		for (int py{ minY }; py < maxY; ++py)
+		{
+			std::fill(m_pBackBufferPixels + minX + py * m_Width, m_pBackBufferPixels + maxX + py * m_Width, white);
+		}
+	}
+
+	void Renderer::RenderShadowTriangle(const std::array<Vector4, 3>& vertices)
+	{
+		const int size{ m_ShadowMap.GetSize() };
+		int minX{}, minY{}, maxX{}, maxY{};
+		GetPixelBounds(vertices[0], vertices[1], vertices[2], { 0, 0, size, size }, minX, minY, maxX, maxY);
+
+		const Vector2 v0{ vertices[0].GetXY() };
+		const Vector2 v1{ vertices[1].GetXY() };
+		const Vector2 v2{ vertices[2].GetXY() };
+
+		// Signed, so the weights come out positive inside for either winding
+		const float area{ Vector2::Cross(v1 - v0, v2 - v0) };
+		if (area == 0.f) return;
+		const float invArea{ 1.f / area };
+
+		float* pDepth{ m_ShadowMap.GetDepth() };
+		for (int py{ minY }; py < maxY; ++py)
+		{
+			for (int px{ minX }; px < maxX; ++px)
+			{
+				const Vector2 point{ px + 0.5f, py + 0.5f };
+
+				const float weight0{ Vector2::Cross(v2 - v1, point - v1) * invArea };
+				const float weight1{ Vector2::Cross(v0 - v2, point - v2) * invArea };
+				const float weight2{ Vector2::Cross(v1 - v0, point - v0) * invArea };
+				if (weight0 < 0.f || weight1 < 0.f || weight2 < 0.f) continue;
+
+				// The projection is orthographic, depth is linear on screen
+				const float depth{ weight0 * vertices[0].z + weight1 * vertices[1].z + weight2 * vertices[2].z };
+				StoreMinDepth(pDepth[px + py * size], depth);
+			}
+		}
+	}
+
+	template<CullMode cullMode>
+	bool Renderer::GetPixelCoverage(int px, int py, std::span<const Vertex_Out, 3> vertices_ndc, float area, float(&weights)[3], float& depth) const
+	{
+		const Vector2 point{ px + 0.5f, py + 0.5f };
+
+		const Vector2 v0{ vertices_ndc[0].position.GetXY() };
+		const Vector2 v1{ vertices_ndc[1].position.GetXY() };
+		const Vector2 v2{ vertices_ndc[2].position.GetXY() };
+
+		const float sin1{ Vector2::Cross(v1 - v0, point - v0) / area };
+		const float sin2{ Vector2::Cross(v2 - v1, point - v1) / area };
+		const float sin3{ Vector2::Cross(v0 - v2, point - v2) / area };
+
+		const float sum{ sin1 + sin2 + sin3 };
+
+		//Triangle check if the point even is within the triangle
+		const bool isInNotTriangle{ !(std::abs(sum - 1) <= EPS) && !(std::abs(sum + 1) <= EPS) };
+		if (isInNotTriangle) return false;
+
+		//Culling checking
+		const bool isFrontFacing{ sin1 >= 0.f && sin2 >= 0.f && sin3 >= 0.f };
+		const bool isBackFacing{ sin1 < 0.f && sin2 < 0.f && sin3 < 0.f };
+		if constexpr (cullMode == Back)
+		{
+			if (!isFrontFacing) return false;
+		}
+		else if constexpr (cullMode == Front)
+		{
+			if (!isBackFacing) return false;
+		}
+		else
+		{
+			if (!isFrontFacing && !isBackFacing) return false;
+		}
+
+		//Moving each weight to fit my design
+		weights[0] = std::abs(sin2);
+		weights[1] = std::abs(sin3);
+		weights[2] = std::abs(sin1);
+
+		//Depth caculation
+		depth = ((weights[0] / vertices_ndc[0].position.z) + (weights[1] / vertices_ndc[1].position.z) + (weights[2] / vertices_ndc[2].position.z));
+		depth = 1.f / depth;
+
+		//Making sure depth is within a valid range of [0,1]
+		return depth <= 1 && depth >= 0;
+	}
+
+	template<CullMode cullMode, bool renderDepth, NormalMapMode normalMapMode, SpecularPowerMode specularPowerMode, ShadingMode shadingMode, ShadingTier shadingTier>
+	Renderer::FragmentResult Renderer::PixelTriangleTest(int px, int py, const TriangleBatch& batch, std::span<const Vertex_Out, 3> vertices_ndc, float area)
+	{
+		ColorRGB finalColor{ .25f,.25f,.25f };
+
+		float weights[3]{};
+		float depth{};
+		if (!GetPixelCoverage<cullMode>(px, py, vertices_ndc, area, weights, depth)) return FragmentResult::Outside;
+
+		// After a depth pre-pass the buffer holds the nearest depth already, only the fragments matching it pass
+		const uint32_t pixelIndex{ static_cast<uint32_t>(px + py * m_Width) };
+		if (m_pDepthBufferPixels[pixelIndex] < depth) return FragmentResult::Rejected;
+		m_pDepthBufferPixels[pixelIndex] = depth;
+
+		if constexpr (renderDepth)
+		{
+			m_MinDepth = std::min(m_MinDepth, depth);
+			m_MaxDepth = std::max(m_MaxDepth, depth);
+		}
+		else if constexpr (shadingTier == ShadingTier::PerVertex)
+		{
+			// The corners are lit already, only the diffuse map is left per pixel
+			float w_interpolated{ 0 };
+			Vector2 caculated_uv{};
+			ColorRGB irradiance{};
+			ColorRGB specular{};
+
+			for (int index{ 0 }; index < vertices_ndc.size(); ++index)
+			{
+				const float weight{ weights[index] / vertices_ndc[index].position.w };
+				caculated_uv += vertices_ndc[index].uv * weight;
+				irradiance += vertices_ndc[index].irradiance * weight;
+				specular += vertices_ndc[index].specular * weight;
+				w_interpolated += weight;
+			}
+
+			w_interpolated = 1.f / w_interpolated;
+			caculated_uv *= w_interpolated;
+			irradiance *= w_interpolated;
+			specular *= w_interpolated;
+
+			if constexpr (shadingMode == dae::Diffuse)
+			{
+				finalColor = GetDiffuse(batch.material.pDiffuseMap->Sample(caculated_uv)) / 255.f;
+			}
+			else if constexpr (shadingMode == dae::Observed)
+			{
+				finalColor = irradiance;
+			}
+			else if constexpr (shadingMode == dae::Specular)
+			{
+				finalColor = specular;
+			}
+			else
+			{
+				finalColor = GetDiffuse(batch.material.pDiffuseMap->Sample(caculated_uv)) * irradiance / 255.f + specular;
+			}
+		}
+		else
+		{
+			float w_interpolated{ 0 };
+			Vector2 caculated_uv{};
+			Vector3 worldPosition{};
+
+			for (int index{ 0 }; index < vertices_ndc.size(); ++index)
+			{
+				caculated_uv += (vertices_ndc[index].uv / vertices_ndc[index].position.w) * weights[index];
+				worldPosition += (vertices_ndc[index].worldPosition / vertices_ndc[index].position.w) * weights[index];
+				w_interpolated += (1.f / vertices_ndc[index].position.w) * weights[index];
+			}
+
+			w_interpolated = 1.f / w_interpolated;
+			caculated_uv *= w_interpolated;
+			worldPosition *= w_interpolated;
+
+			Vector3 normal{};
+			Vector3 tangent{};
+			Vector3 viewDirection{};
+
+			for (int index{ 0 }; index < vertices_ndc.size(); ++index)
+			{
+				normal += vertices_ndc[index].normal * weights[index];
+				viewDirection += vertices_ndc[index].viewDirection * weights[index];
+				if constexpr (normalMapMode == NormalMapMode::TangentSpace)
+				{
+					tangent += vertices_ndc[index].tangent * weights[index];
+				}
+			}
+			if constexpr (normalMapMode == NormalMapMode::TangentSpace)
+			{
+				tangent.Normalize();
+			}
+
+			// The sign is the same on all three corners, a triangle never spans a mirror seam
+			const Vertex_Out pixelVertex{ {},caculated_uv,normal.Normalized(),tangent,vertices_ndc[0].tangentSign,{},worldPosition };
+
+			finalColor = PixelShading<normalMapMode, specularPowerMode, shadingMode>(pixelVertex, viewDirection.Normalized(), batch, m_pLightCulling->GetLights(px, py));
+		}
+
+		finalColor.MaxToOne();
+
+		m_pBackBufferPixels[pixelIndex] = SDL_MapRGB(m_pBackBuffer->format,
+			static_cast<uint8_t>(finalColor.r * 255),
+			static_cast<uint8_t>(finalColor.g * 255),
+			static_cast<uint8_t>(finalColor.b * 255));
+
+		return FragmentResult::Shaded;
+	}
+
+	template<NormalMapMode normalMapMode, SpecularPowerMode specularPowerMode, ShadingMode shadingMode>
+	ColorRGB Renderer::PixelShading(const Vertex_Out& vertex, const Vector3& viewDirection, const TriangleBatch& batch, std::span<const uint32_t> lights)
+	{
+		const Material& material{ batch.material };
+
+		// Only the modes that show the diffuse map sample it
+		if constexpr (shadingMode == dae::Diffuse)
+		{
+			return GetDiffuse(material.pDiffuseMap->Sample(vertex.uv)) / 255.f;
+		}
+		else
+		{
+			Vector3 normal{ vertex.normal };
+			if constexpr (normalMapMode == NormalMapMode::TangentSpace)
+			{
+				const Vector3 binormal{ Vector3::Cross(vertex.normal, vertex.tangent) * vertex.tangentSign };
+				const Matrix tangentSpaceAxis{ vertex.tangent, binormal, vertex.normal, Vector3::Zero };
+				const ColorRGB sampledNormal{ material.pNormalMap->Sample(vertex.uv) / 255.f };
+
+				Vector3 caculatedNormal{ sampledNormal.r, sampledNormal.g, sampledNormal.b };
+				caculatedNormal = 2.f * caculatedNormal - Vector3{ 1.f, 1.f, 1.f };
+
+				Vector3 transformedNormal{ tangentSpaceAxis.TransformVector(caculatedNormal) };
+				transformedNormal.Normalize();
+				normal = transformedNormal;
+			}
+			else if constexpr (normalMapMode == NormalMapMode::ObjectSpace)
+			{
+				// Already the surface normal, only the world matrix of the batch is left
+				const ColorRGB sampledNormal{ material.pObjectNormalMap->Sample(vertex.uv) / 255.f };
+				const Vector3 objectNormal{ 2.f * Vector3{ sampledNormal.r, sampledNormal.g, sampledNormal.b } - Vector3{ 1.f, 1.f, 1.f } };
+				normal = batch.objectToWorld.TransformVector(objectNormal).Normalized();
+			}
+
+			// Only the lights of this pixel's tile, see TiledLightCulling
+			float gloss{};
+			if constexpr (shadingMode != dae::Observed)
+			{
+				gloss = material.pGlossinessMap->Sample(vertex.uv).r / 255.f;
+			}
+
+			ColorRGB irradiance{};
+			ColorRGB specularLight{};
+			for (const uint32_t index : lights)
+			{
+				const Light& light{ m_Lights[index] };
+
+				Vector3 toLight{};
+				float attenuation{ GetLightAttenuation(light, vertex.worldPosition, toLight) };
+				if (light.castsShadows && m_UseShadows)
+				{
+					attenuation *= m_ShadowMap.GetLitFraction(vertex.worldPosition, vertex.normal);
+				}
+				if (attenuation <= 0.f) continue;
+
+				const ColorRGB radiance{ light.color * (light.intensity * attenuation) };
+				if constexpr (shadingMode != dae::Specular)
+				{
+					irradiance += radiance * std::max(Vector3::Dot(normal, toLight), 0.f);
+				}
+				if constexpr (shadingMode != dae::Observed)
+				{
+					specularLight += radiance * GetSpecular<specularPowerMode>(toLight, normal, viewDirection, gloss);
+				}
+			}
+
+			if constexpr (shadingMode == dae::Observed)
+			{
+				return irradiance;
+			}
+			else
+			{
+				const ColorRGB specularColor{ material.pSpecularMap->Sample(vertex.uv) / 255.f };
+				if constexpr (shadingMode == dae::Specular)
+				{
+					return specularColor * specularLight;
+				}
+				else
+				{
+					const ColorRGB lambert{ GetDiffuse(material.pDiffuseMap->Sample(vertex.uv)) };
+					return ((lambert * irradiance) / 255.f) + specularColor * specularLight;
+				}
+			}
+		}
+	}
+
+	void Renderer::ExtractFrustumPlanes(const Matrix& viewProjectionMatrix, Frustum& frustum) const
+	{
+		// Points are transformed as row vectors (p * M), so the clip coordinates are dot products with the columns
+		const Matrix columns{ Matrix::Transpose(viewProjectionMatrix) };
+		const Vector4 col0 = columns[0]; // clip x
+		const Vector4 col1 = columns[1]; // clip y
+		const Vector4 col2 = columns[2]; // clip z
+		const Vector4 col3 = columns[3]; // clip w
+
+		// Extract frustum planes from the view-projection matrix (D3D depth range 0 <= z <= w)
+		frustum.nearFace = Plane{
+			Vector3(col2.x, col2.y, col2.z), // Normal
+			col2.w // Distance
+		};
+
+		frustum.farFace = Plane{
+			Vector3(col3.x - col2.x, col3.y - col2.y, col3.z - col2.z), // Normal
+			col3.w - col2.w // Distance
 		};
 
 		frustum.leftFace = Plane{
-			Vector3(row3.x + row0.x, row3.y + row0.y, row3.z + row0.z), // Normal
-			row3.w + row0.w // Distance
+			Vector3(col3.x + col0.x, col3.y + col0.y, col3.z + col0.z), // Normal
+			col3.w + col0.w // Distance
 		};
 
 		frustum.rightFace = Plane{
-			Vector3(row3.x - row0.x, row3.y - row0.y, row3.z - row0.z), // Normal
-			row3.w - row0.w // Distance
+			Vector3(col3.x - col0.x, col3.y - col0.y, col3.z - col0.z), // Normal
+			col3.w - col0.w // Distance
 		};
 
 		frustum.topFace = Plane{
-			Vector3(row3.x - row1.x, row3.y - row1.y, row3.z - row1.z), // Normal
-			row3.w - row1.w // Distance
+			Vector3(col3.x - col1.x, col3.y - col1.y, col3.z - col1.z), // Normal
+			col3.w - col1.w // Distance
 		};
 
 		frustum.bottomFace = Plane{
-			Vector3(row3.x + row1.x, row3.y + row1.y, row3.z + row1.z), // Normal
-			row3.w + row1.w // Distance
+			Vector3(col3.x + col1.x, col3.y + col1.y, col3.z + col1.z), // Normal
+			col3.w + col1.w // Distance
 		};
 
 		// Normalize the planes to ensure unit-length normals
@@ -666,19 +1681,15 @@ namespace dae {
 		}
 	}
 
-	void Renderer::VertexTransformationFunction(const std::vector<Vertex_In>& vertices_in, std::vector<Vertex_Out>& vertices_out, bool& culling, const Matrix& worldMatrix) const
+	void Renderer::VertexTransformationFunction(std::span<const Vertex_In> vertices_in, std::span<Vertex_Out> vertices_out, bool& culling) const
 	{
-		const float aspectRatio{ (float)m_Width / m_Height };
-		const Matrix projM{ m_pCamera->ProjectionMatrix };
-
-		const Matrix m{ worldMatrix * m_pCamera->invViewMatrix * projM };
-
-		Frustum frustum;
-		ExtractFrustumPlanes(m, frustum);
+		const Matrix m{ m_pCamera->invViewMatrix * m_pCamera->ProjectionMatrix };
 
 		int cullingCount = 0;
-		for (const auto& vertex : vertices_in)
+		for (size_t index{ 0 }; index < vertices_in.size(); ++index)
 		{
+			const Vertex_In& vertex{ vertices_in[index] };
+
 			// Transform to clip space
 			Vector4 transformedPosition = m.TransformPoint(Vector4{ vertex.position, vertex.position.z });
 
@@ -688,7 +1699,7 @@ namespace dae {
 			transformedPosition.y /= devision;
 			transformedPosition.z /= devision;
 
-			if (!frustum.IsInsideFrustum(transformedPosition))
+			if (!Frustum::IsInsideClipSpace(transformedPosition))
 			{
 				++cullingCount;
 			}
@@ -700,105 +1711,318 @@ namespace dae {
 			newVertex.position.z = transformedPosition.z;                       // NDC Depth (0 to 1)
 			newVertex.position.w = transformedPosition.w;
 
-			newVertex.viewDirection = (worldMatrix.TransformPoint(vertex.position) - m_pCamera->origin).Normalized();
+			newVertex.viewDirection = (vertex.position - m_pCamera->origin).Normalized();
+			newVertex.worldPosition = vertex.position;
 
 			// Pass additional attributes (UVs, color, etc.)
 			newVertex.uv = vertex.uv;
-			newVertex.normal = worldMatrix.TransformVector(vertex.normal).Normalized();
-			newVertex.tangent = worldMatrix.TransformVector(vertex.tangent).Normalized();
+			newVertex.normal = vertex.normal;
+			newVertex.tangent = vertex.tangent;
+			newVertex.tangentSign = vertex.tangentSign;
 
-			vertices_out.emplace_back(newVertex);
+			vertices_out[index] = newVertex;
 		}
 
 		culling = cullingCount == vertices_in.size();
 	}
 
+	void Renderer::VertexTransformationFunction(std::span<const Vertex_In, 3> vertices_in, std::span<Vertex_Out, 3> vertices_out, bool& culling, const Matrix& worldMatrix) const
+	{
+		const std::array<Vertex_In, 3> worldVertices{
+			Mesh::ToWorldSpace(vertices_in[0], worldMatrix),
+			Mesh::ToWorldSpace(vertices_in[1], worldMatrix),
+			Mesh::ToWorldSpace(vertices_in[2], worldMatrix) };
+
+		VertexTransformationFunction(worldVertices, vertices_out, culling);
+	}
+
 	ColorRGB Renderer::GetDiffuse(const ColorRGB& sampledColor) const
 	{
 		return ((m_LightIntensity * sampledColor) / static_cast<int>(M_PI));
 	}
 
-	ColorRGB Renderer::GetSpecular(const Vertex_Out& vertex, const Vector3& normal, const Vector3& viewDirection, const Mesh* pMesh) const
+	template<SpecularPowerMode specularPowerMode>
+	float Renderer::GetSpecular(const Vector3& toLight, const Vector3& normal, const Vector3& viewDirection, float gloss) const
 	{
-		ColorRGB gloss{ pMesh->GetGlossinessMap()->Sample(vertex.uv) / 255.f };
-		const float glossiness{ gloss.r * m_Shininess };
-		ColorRGB specularColor{ pMesh->GetSpecularMap()->Sample(vertex.uv) / 255.f };
-
-		const float dot{ Vector3::Dot(m_InvLightDirection, normal) };
-		const Vector3 reflect{ (m_InvLightDirection - (2.f * std::max(dot,0.f) * normal)) };
+		const float dot{ Vector3::Dot(toLight, normal) };
+		const Vector3 reflect{ (toLight - (2.f * std::max(dot,0.f) * normal)) };
 		const float angle{ std::max(Vector3::Dot(viewDirection,reflect),0.f) };
 
-		const float specReflection{ std::pow(angle, glossiness) };
+		if constexpr (specularPowerMode == SpecularPowerMode::Lookup)
+		{
+			return m_SpecularLut.Evaluate(angle, gloss);
+		}
+		else
+		{
+			return std::pow(angle, gloss * m_Shininess);
+		}
+	}
+
+	float Renderer::GetLightAttenuation(const Light& light, const Vector3& position, Vector3& toLight) const
+	{
+		if (light.type == LightType::Directional)
+		{
+			toLight = -light.direction;
+			return 1.f;
+		}
+
+		toLight = light.position - position;
+		const float distance{ toLight.Normalize() };
+		if (distance >= light.range) return 0.f;
+
+		// Smooth window, reaches 0 exactly at the range so the tile bounds are tight
+		const float ratio{ distance / light.range };
+		const float window{ (1.f - ratio * ratio) * (1.f - ratio * ratio) };
+		float attenuation{ window / (distance * distance + 1.f) };
 
-		return specularColor * specReflection;
+		if (light.type == LightType::Spot)
+		{
+			const float cosAngle{ Vector3::Dot(-toLight, light.direction) };
+			const float cone{ std::clamp((cosAngle - light.cosOuterCone) / (light.cosInnerCone - light.cosOuterCone), 0.f, 1.f) };
+			attenuation *= cone * cone * (3.f - 2.f * cone);
+		}
+
+		return attenuation;
 	}
 
-	void Renderer::CreateMeshes()
+	void Renderer::RequestAssets()
 	{
-		std::vector<Vertex_In> vertices;
-		std::vector<uint32_t> indices;
-		Utils::ParseOBJ("resources/vehicle.obj", vertices, indices);
+		// Parsing, decoding and compiling are independent of each other and run on worker threads
+		m_VehicleStream.name = "resources/vehicle.obj";
+		m_VehicleStream.node = m_Scene.AddNode(Transform{ { 0,0,50 } });
+		// Textures are requested as soon as the materials of a mesh are known
+		m_VehicleStream.mesh = m_pAssetLoader->LoadMesh(m_VehicleStream.name);
+		m_VehicleStream.effect = m_pAssetLoader->CompileEffect(L"resources/PosCol3D.fx");
+
+		m_FireStream.name = "resources/fireFX.obj";
+		m_FireStream.node = m_Scene.AddNode(Transform{}, m_VehicleStream.node);
+		m_FireStream.mesh = m_pAssetLoader->LoadMesh(m_FireStream.name);
+		m_FireStream.effect = m_pAssetLoader->CompileEffect(L"resources/Transparent.fx");
+		m_FireStream.isTransparent = true;
+	}
+
+	void Renderer::StreamAssets()
+	{
+		if (!m_IsStreaming || !m_IsInitialized)
+			return;
 
-		std::string texturePaths[4]
+		StreamMesh(m_VehicleStream, m_pMesh);
+		StreamMesh(m_FireStream, m_pFireMesh);
+
+		if (m_VehicleStream.hasGeometry && m_VehicleStream.hasTextures && m_FireStream.hasGeometry && m_FireStream.hasTextures)
 		{
-			"resources/vehicle_diffuse.png",
-			"resources/vehicle_normal.png",
-			"resources/vehicle_specular.png",
-			"resources/vehicle_gloss.png",
-		};
+			m_IsStreaming = false;
+			m_pAssetLoader->ClearTextureRequests();
+			m_pAssetLoader->PrintTimings();
+		}
+	}
+
+	void Renderer::StreamMesh(StreamedMesh& stream, std::unique_ptr<Mesh>& pMesh)
+	{
+		// Device uploads only ever happen here, on the main thread, and never wait on a worker
+		if (!pMesh)
+		{
+			if (!AssetLoader::IsReady(stream.effect) || !AssetLoader::IsReady(stream.mesh.bounds))
+				return;
+
+			// A failed load leaves an empty proxy box, a failed compile is handled like a compile error
+			BoundingBox bounds{};
+			try
+			{
+				bounds = stream.mesh.bounds.get();
+			}
+			catch (...)
+			{
+				ReportLoadFailure(stream.name);
+			}
+
+			ID3DBlob* pCompiledEffect{ nullptr };
+			try
+			{
+				pCompiledEffect = stream.effect.get();
+			}
+			catch (...)
+			{
+				ReportLoadFailure(stream.name + " effect");
+			}
 
-		m_pMesh = std::make_unique<Mesh>(
-			m_pDevice,
-			vertices,
-			indices,
-			texturePaths,
-			false,
-			new OpaqueEffect{ Effect::LoadEffect(m_pDevice,L"resources/PosCol3D.fx") ,m_pDevice,vertices,indices }
-		);
+			MeshAsset proxy{ AssetLoader::CreateProxy(bounds) };
+			ID3DX11Effect* pD3DEffect{ Effect::CreateEffect(m_pDevice, pCompiledEffect) };
 
-		m_pMesh->WorldMatrix = Matrix::CreateTranslation({ 0,0,50 });
+			Effect* pEffect{ nullptr };
+			if (stream.isTransparent)
+			{
+				pEffect = new TransparentEffect{ pD3DEffect, m_pDevice };
+			}
+			else
+			{
+				pEffect = new OpaqueEffect{ pD3DEffect, m_pDevice };
+			}
 
-		std::vector<Vertex_In> fireVertices;
-		std::vector<uint32_t> fireIndices;
+			pMesh = std::make_unique<Mesh>(m_pDevice, GeometryStore::Create(std::move(proxy), VertexFormat::Full), m_PlaceholderMaterial, pEffect);
+			m_Scene.AttachMesh(stream.node, pMesh.get());
+			pMesh->SetInstances(GetFleetInstances());
+			pMesh->SetCullingMode(m_CullMode);
+			pMesh->SetSamplerState(m_SampleState);
+		}
 
-		Utils::ParseOBJ("resources/fireFX.obj", fireVertices, fireIndices);
+		if (!stream.hasMaterials && AssetLoader::IsReady(stream.mesh.materials))
+		{
+			stream.hasMaterials = true;
+			try
+			{
+				stream.materials = stream.mesh.materials.get();
+			}
+			catch (...)
+			{
+				// Nothing to swap in, the placeholder materials stay
+				ReportLoadFailure(stream.name);
+				stream.hasTextures = true;
+			}
+
+			// Only maps neither cached nor already requested by this stream, the loader shares jobs between streams
+			for (const MaterialDesc& material : stream.materials)
+			{
+				for (const std::string* pPath : { &material.diffuseMap, &material.normalMap, &material.specularMap, &material.glossinessMap, &material.objectNormalMap })
+				{
+					const bool isRequested{ std::any_of(stream.textures.begin(), stream.textures.end(), [pPath](const auto& texture) { return texture.first == *pPath; }) };
+					if (!pPath->empty() && !m_Textures.contains(*pPath) && !isRequested)
+					{
+						stream.textures.emplace_back(*pPath, m_pAssetLoader->DecodeTexture(*pPath));
+					}
+				}
+			}
+		}
 
-		std::string fireTexturePaths[1]
+		if (!stream.hasGeometry && AssetLoader::IsReady(stream.mesh.asset))
 		{
-			"resources/fireFX_diffuse.png"
-		};
+			stream.hasGeometry = true;
+			try
+			{
+				pMesh->SetGeometry(m_pDevice, m_GeometryStore.Add(stream.name, stream.mesh.asset.get(), m_VertexFormat));
+
+				std::cout << stream.name << (m_VertexFormat == VertexFormat::Compact ? " (compact vertices)" : "") << " LOD triangles:";
+				for (const MeshLod& lod : pMesh->GetLods())
+				{
+					std::cout << " " << lod.indexCount / 3;
+				}
+				std::cout << ", " << pMesh->GetSubMeshes().size() << " material batches" << std::endl;
+			}
+			catch (...)
+			{
+				// The proxy stays
+				ReportLoadFailure(stream.name);
+			}
+			stream.mesh = MeshRequest{};
+		}
+
+		// Textures swap in together so a frame never mixes placeholder and real maps
+		const bool texturesReady{ stream.hasMaterials && std::all_of(stream.textures.begin(), stream.textures.end(),
+			[](const auto& texture) { return AssetLoader::IsReady(texture.second); }) };
+
+		if (!stream.hasTextures && texturesReady)
+		{
+			stream.hasTextures = true;
 
-		m_pFireMesh = std::make_unique<Mesh>(
+			// Another stream may have uploaded the same file in the meantime, failed decodes stay on the placeholders
+			for (const auto& [path, texture] : stream.textures)
+			{
+				if (!m_Textures.contains(path))
+				{
+					try
+					{
+						if (std::unique_ptr<Texture> pTexture{ Texture::Create(texture.get(), m_pDevice) })
+						{
+							m_Textures.emplace(path, std::move(pTexture));
+						}
+					}
+					catch (...)
+					{
+						ReportLoadFailure(path);
+					}
+				}
+			}
 
-			m_pDevice,
-			fireVertices,
-			fireIndices,
-			fireTexturePaths,
-			true,
-			new TransparentEffect{ Effect::LoadEffect(m_pDevice,L"resources/Transparent.fx") ,m_pDevice,fireVertices,fireIndices }
-		);
+			std::vector<Material> materials{};
+			for (const MaterialDesc& material : stream.materials)
+			{
+				materials.push_back(AssetLoader::ResolveMaterial(material, m_Textures, m_PlaceholderMaterial));
+			}
+			pMesh->SetMaterials(std::move(materials));
+			stream.textures.clear();
+		}
+	}
 
-		m_pFireMesh->WorldMatrix = Matrix::CreateTranslation({ 0,0,50 });
+	void Renderer::ReleaseStream(StreamedMesh& stream, const Mesh* pMesh)
+	{
+		// A compiled effect nobody took ownership of yet, waits for the job if it is still running
+		if (!pMesh && stream.effect.valid())
+		{
+			try
+			{
+				if (ID3DBlob* pCompiledEffect{ stream.effect.get() })
+				{
+					pCompiledEffect->Release();
+				}
+			}
+			catch (...)
+			{
+				ReportLoadFailure(stream.name + " effect");
+			}
+		}
 	}
 
 	void Renderer::RotateMesh(float elapsedSec)
 	{
 		if (!m_VehicleRotation) return;
 
-		auto translationMatrix = Matrix::CreateTranslation({ 0,0,-50 });
-
-		m_pMesh->WorldMatrix *= translationMatrix;
-		m_pFireMesh->WorldMatrix *= translationMatrix;
-
-		const auto rotationMatrix = Matrix::CreateRotationY(elapsedSec);
+		// Only the angle accumulates, the world matrices are rebuilt from it so no drift builds up
+		Transform vehicle{ m_Scene.GetLocalTransform(m_VehicleStream.node) };
+		vehicle.rotation.y = std::remainder(vehicle.rotation.y + elapsedSec, 2.f * static_cast<float>(M_PI));
+		m_Scene.SetLocalTransform(m_VehicleStream.node, vehicle);
+	}
 
-		m_pMesh->WorldMatrix *= rotationMatrix;
-		m_pFireMesh->WorldMatrix *= rotationMatrix;
+	void Renderer::CreatePointLights()
+	{
+		// Scattered over the area the fleet covers, the same lights every time
+		std::mt19937 generator{ 7 };
+		std::uniform_real_distribution<float> x{ -100.f, 100.f };
+		std::uniform_real_distribution<float> y{ -5.f, 10.f };
+		std::uniform_real_distribution<float> z{ 20.f, 230.f };
+		std::uniform_real_distribution<float> channel{ 0.2f, 1.f };
+		std::uniform_real_distribution<float> range{ 8.f, 14.f };
+
+		for (size_t index{ 0 }; index < m_PointLightCount; ++index)
+		{
+			Light light{ LightType::Point };
+			light.position = { x(generator), y(generator), z(generator) };
+			light.color = { channel(generator), channel(generator), channel(generator) };
+			light.intensity = 20.f;
+			light.range = range(generator);
+
+			// Every eighth one is a spot light shining down
+			if (index % 8 == 0)
+			{
+				light.type = LightType::Spot;
+				light.direction = { 0.f, -1.f, 0.f };
+				light.range *= 1.5f;
+				light.cosInnerCone = 0.9f;
+				light.cosOuterCone = 0.7f;
+			}
 
-		translationMatrix.Inverse();
+			m_Lights.push_back(light);
+			m_PointLightAnchors.push_back(light.position);
+		}
+	}
 
-		m_pMesh->WorldMatrix *= translationMatrix;
-		m_pFireMesh->WorldMatrix *= translationMatrix;
+	void Renderer::MovePointLights(float totalSec)
+	{
+		// Circles around the anchors, at a speed and phase of their own
+		for (size_t index{ 0 }; index < m_PointLightAnchors.size(); ++index)
+		{
+			const float angle{ totalSec * (0.5f + (index % 7) * 0.2f) + index * 2.4f };
+			m_Lights[index + 1].position = m_PointLightAnchors[index] + Vector3{ std::cos(angle) * 3.f, 0.f, std::sin(angle) * 3.f };
+		}
 	}
 
 	void Renderer::PrintOutKeys()
@@ -813,10 +2037,12 @@ namespace dae {
 		std::cout << "  [F9]  Cycle CullMode (BACK/FRONT/NONE)" << std::endl;
 		std::cout << "  [F10] Toggle Uniform ClearColor (ON/OFF)" << std::endl;
 		std::cout << "  [F11] Toggle Print FPS (ON/OFF)" << std::endl;
+		std::cout << "  [I]   Toggle Vehicle Fleet, instanced (ON/OFF)" << std::endl;
+		std::cout << "  [O]   Toggle Occlusion Culling (ON/OFF)" << std::endl;
+		std::cout << "  [F3]  Toggle FireFX (ON/OFF)" << std::endl;
 		std::cout << std::endl;
 		SetConsoleTextAttribute(hConsole, 2);
 		std::cout << "[Key bindings - HARDWARE]" << std::endl;
-		std::cout << "  [F3] Toggle FireFX (ON/OFF)" << std::endl;
 		std::cout << "  [F4] Cycle Sampler State (POINT/LINEAR/ANISOTROPIC)" << std::endl;
 		std::cout << std::endl;
 		SetConsoleTextAttribute(hConsole, 5);
@@ -825,6 +2051,14 @@ namespace dae {
 		std::cout << "  [F6] Toggle NormalMap (ON/OFF)" << std::endl;
 		std::cout << "  [F7] Tpggle DepthBuffer Visualization (ON/OFF)" << std::endl;
 		std::cout << "  [F8] Toggle BoundingBox visualization (ON/OFF)" << std::endl;
+		std::cout << "  [F12] Toggle Out-of-core Vehicle (ON/OFF)" << std::endl;
+		std::cout << "  [P]   Toggle Specular Power (LOOKUP/POW)" << std::endl;
+		std::cout << "  [B]   Benchmark Specular Power" << std::endl;
+		std::cout << "  [L]   Toggle Point Lights, tiled light culling (ON/OFF)" << std::endl;
+		std::cout << "  [H]   Toggle Shadows of the sun (ON/OFF)" << std::endl;
+		std::cout << "  [Z]   Toggle Depth Pre-pass (ON/OFF)" << std::endl;
+		std::cout << "  [F]   Toggle Front To Back Sorting (ON/OFF)" << std::endl;
+		std::cout << "  [G]   Cycle Shading Tier (BY SCREEN SIZE/PER VERTEX/PER PIXEL)" << std::endl;
 
 		SetConsoleTextAttribute(hConsole, 15);
 	}
@@ -9,6 +9,20 @@
 #include "DataTypes.h"
 #include "Mesh.h"
 #include "Effect.h"
+#include "AssetLoader.h"
+#include "ClusteredMesh.h"
+#include "SceneGraph.h"
+#include "OcclusionBuffer.h"
+#include "SoftwareShaders.h"
+#include "SpecularPower.h"
+#include "TiledLightCulling.h"
+#include "ShadowMap.h"
+#include "TriangleBins.h"
+#include <array>
+#include <span>
+#include <chrono>
+#include <utility>
+#include <atomic>
 
 struct SDL_Window;
 struct SDL_Surface;
@@ -49,6 +63,16 @@ namespace dae
 		void ToggleNormalMap();
 		void ToggleDepthBuffer();
 		void ToggleBoundingBox();
+		void ToggleClusteredMesh();
+		void ToggleVehicleFleet();
+		void ToggleOcclusionCulling();
+		void ToggleSpecularPower();
+		void BenchmarkSpecularPower();
+		void TogglePointLights();
+		void ToggleShadows();
+		void ToggleDepthPrepass();
+		void ToggleFrontToBack();
+		void CycleShadingTier();
 
 #pragma endregion
 
@@ -56,24 +80,136 @@ namespace dae
 
 #pragma region Software Rendering
 		//Software
-		void RenderMesh(Mesh* mesh);
-		void RenderTriangle(const std::vector<Vertex_Out>& vertices_ndc, const Mesh* pMesh);
-		void PixelTriangleTest(uint32_t pixelIndex, const Mesh* pMesh, const std::vector<Vertex_Out>& vertices_ndc, const float& area, float* weights);
+		// One submesh at the mesh's active LOD
+		struct DrawBatch
+		{
+			const Mesh* pMesh{ nullptr };
+			MeshLod range{};
+			Material material{};
+			const Matrix* pInstance{ nullptr };		// nullptr for meshes without instances
+			ShadingTier shadingTier{ ShadingTier::PerPixel };
+		};
+
+		// The per-pixel settings are template parameters, so nothing inside the pixel loop branches on them.
+		// Each frame Render_Software looks up the instantiation for the current settings and every batch's
+		// material in a table. They only touch the pixels inside clip.
+		struct TriangleBatch;
+		using TriangleRasterizer = void (Renderer::*)(std::span<const Vertex_Out, 3>, const TriangleBatch&, const PixelRect&);
+
+		// Screen space triangles of one material, ready to be rasterized
+		struct TriangleBatch
+		{
+			Material material{};
+			std::vector<Triangle> triangles{};
+			Matrix objectToWorld{};		// rotates the object space normal map
+			ShadingTier shadingTier{ ShadingTier::PerPixel };
+			TriangleRasterizer pRasterize{ nullptr };
+		};
+
+		void GatherBatches(Mesh* pMesh, const Frustum& frustum, std::vector<DrawBatch>& batches) const;
+		void TransformBatch(const DrawBatch& batch, std::vector<Triangle>& triangles) const;
+		void TransformClusteredMesh(ClusteredMesh* pClusteredMesh, const Mesh* pMesh, const Frustum& frustum, std::vector<TriangleBatch>& batches) const;
+		// All triangles of the frame are known before the first pixel is shaded, their depth ranges pick the lights per tile
+		void CullLights(std::span<const TriangleBatch> batches);
+		void RasterizeBatch(const TriangleBatch& batch);
+		// Per-vertex or per-pixel lighting for a mesh covering this sphere
+		ShadingTier SelectShadingTier(const BoundingSphere& sphere) const;
+		// Gouraud tier, once the tile light lists are known. Drops the triangles the rasterizer would reject,
+		// then lights every vertex the others share once and hands the result to all of its corners.
+		template<SpecularPowerMode specularPowerMode>
+		void LightVertices(TriangleBatch& batch) const;
+		void LightVertices(TriangleBatch& batch) const;
+		// Sorts the triangles of the frame front to back into screen tiles
+		void BinTriangles(std::span<const TriangleBatch> batches);
+		// One tile per task, nearest triangles first, so the depth test rejects as much as it can before shading
+		void RasterizeBins(std::span<const TriangleBatch> batches);
+		// Through the Transparent.fx port, after the opaque meshes
+		void RenderTransparentMesh(Mesh* pMesh, const Frustum& frustum, const Matrix& viewProjection);
+
+		static constexpr size_t CullModeCount{ 3 };
+		static constexpr size_t NormalMapModeCount{ 3 };
+		static constexpr size_t SpecularPowerModeCount{ 2 };
+		static constexpr size_t ShadingModeCount{ 4 };
+		template<size_t... Indices>
+		static constexpr auto MakeRasterizers(std::index_sequence<Indices...>) -> std::array<TriangleRasterizer, sizeof...(Indices)>;
+		// The Gouraud tier ignores the normal map and the specular power per pixel, Index = (cullMode * 2 + renderDepth) * ShadingModeCount + shadingMode
+		template<size_t... Indices>
+		static constexpr auto MakeVertexLitRasterizers(std::index_sequence<Indices...>) -> std::array<TriangleRasterizer, sizeof...(Indices)>;
+		TriangleRasterizer SelectRasterizer(const TriangleBatch& batch) const;
+
+		void GetPixelBounds(std::span<const Vertex_Out, 3> vertices_ndc, const PixelRect& clip, int& minX, int& minY, int& maxX, int& maxY) const;
+		static void GetPixelBounds(const Vector4& v0, const Vector4& v1, const Vector4& v2, const PixelRect& clip, int& minX, int& minY, int& maxX, int& maxY);
+		template<CullMode cullMode, bool renderDepth, NormalMapMode normalMapMode, SpecularPowerMode specularPowerMode, ShadingMode shadingMode, ShadingTier shadingTier>
+		void RenderTriangle(std::span<const Vertex_Out, 3> vertices_ndc, const TriangleBatch& batch, const PixelRect& clip);
+		void RenderTriangleBounds(std::span<const Vertex_Out, 3> vertices_ndc, const TriangleBatch& batch, const PixelRect& clip);
+		// Depth pre-pass, writes the nearest depth without shading. Same coverage and depth as the shading pass.
+		using DepthRasterizer = void (Renderer::*)(std::span<const Vertex_Out, 3>, const PixelRect&);
+		template<CullMode cullMode>
+		void RenderTriangleDepth(std::span<const Vertex_Out, 3> vertices_ndc, const PixelRect& clip);
+		DepthRasterizer SelectDepthRasterizer() const;
+		// Depth-only variant for the shadow map: no culling, no attributes, no shading, no colour
+		void RenderShadowTriangle(const std::array<Vector4, 3>& vertices);
+		// Inside the triangle, facing the way cullMode keeps and in the depth range. Weights and depth are only set then.
+		template<CullMode cullMode>
+		bool GetPixelCoverage(int px, int py, std::span<const Vertex_Out, 3> vertices_ndc, float area, float(&weights)[3], float& depth) const;
+		enum class FragmentResult
+		{
+			Outside,	// not covered, culled or out of the depth range
+			Rejected,	// covered but behind what is in the depth buffer
+			Shaded
+		};
+		template<CullMode cullMode, bool renderDepth, NormalMapMode normalMapMode, SpecularPowerMode specularPowerMode, ShadingMode shadingMode, ShadingTier shadingTier>
+		FragmentResult PixelTriangleTest(int px, int py, const TriangleBatch& batch, std::span<const Vertex_Out, 3> vertices_ndc, float area);
 
 		void ExtractFrustumPlanes(const dae::Matrix& viewProjectionMatrix, dae::Frustum& frustum) const;
-		void VertexTransformationFunction(const std::vector<Vertex_In>& vertices_in, std::vector<Vertex_Out>& vertices_out, bool& culling, const Matrix& worldMatrix) const;
-
-		ColorRGB PixelShading(const Vertex_Out& vertex, const Vector3& vieDirection, const ColorRGB& sampledColor, const Mesh* pMesh);
+		// Draws the vehicles into the shadow map of the sun, the first light
+		void RenderShadowMap();
+		// Fills the occlusion buffer with the nearest vehicles, both render methods test against it
+		void RenderOccluders(const Frustum& frustum, const Matrix& viewProjection);
+		// Writes one output per input, vertices_out has to be as large as vertices_in.
+		// Input vertices are in world space (see Mesh::GetWorldVertices), only the view projection is left.
+		void VertexTransformationFunction(std::span<const Vertex_In> vertices_in, std::span<Vertex_Out> vertices_out, bool& culling) const;
+		// For triangles without a cached world space copy (clusters)
+		void VertexTransformationFunction(std::span<const Vertex_In, 3> vertices_in, std::span<Vertex_Out, 3> vertices_out, bool& culling, const Matrix& worldMatrix) const;
+
+		template<NormalMapMode normalMapMode, SpecularPowerMode specularPowerMode, ShadingMode shadingMode>
+		ColorRGB PixelShading(const Vertex_Out& vertex, const Vector3& viewDirection, const TriangleBatch& batch, std::span<const uint32_t> lights);
 		ColorRGB GetDiffuse(const ColorRGB& sampledColor) const;
-		ColorRGB GetSpecular(const Vertex_Out& vertex, const Vector3& normal, const Vector3& viewDirection, const Mesh* pMesh) const;
+		// Phong lobe of one light, toLight is normalized
+		template<SpecularPowerMode specularPowerMode>
+		float GetSpecular(const Vector3& toLight, const Vector3& normal, const Vector3& viewDirection, float gloss) const;
+		// Direction to the light and how much of it reaches the point, 0 outside its range or cone
+		float GetLightAttenuation(const Light& light, const Vector3& position, Vector3& toLight) const;
 
 #pragma endregion
 
 #pragma region Util Functions
 
-		void CreateMeshes();
+		// A mesh that is drawn as a proxy box with placeholder textures until its parts have streamed in
+		struct StreamedMesh
+		{
+			std::string name{};
+			MeshRequest mesh{};
+			std::vector<MaterialDesc> materials{};
+			std::vector<std::pair<std::string, std::shared_future<TextureData>>> textures{};	// maps not in the texture cache yet
+			std::shared_future<ID3DBlob*> effect{};
+			bool isTransparent{ false };
+			SceneGraph::NodeId node{};		// the mesh is attached to it as soon as it exists
+
+			bool hasGeometry{ false };
+			bool hasMaterials{ false };
+			bool hasTextures{ false };
+		};
+
+		void RequestAssets();
+		void StreamAssets();
+		void StreamMesh(StreamedMesh& stream, std::unique_ptr<Mesh>& pMesh);
+		void ReleaseStream(StreamedMesh& stream, const Mesh* pMesh);
 
 		void RotateMesh(float elapsedSec);
+		void CreatePointLights();
+		void MovePointLights(float totalSec);
+		std::vector<Matrix> GetFleetInstances() const;
 		void PrintOutKeys();
 		float Remap(float value, float min, float max) const;
 
@@ -100,9 +236,19 @@ namespace dae
 		bool m_VehicleRotation{ true };
 		CullMode m_CullMode{ CullMode::Back };
 		bool m_ClearColor{ false };
+#ifdef DAE_COMPACT_VERTICES
+		VertexFormat m_VertexFormat{ VertexFormat::Compact };	// applied when geometry streams in
+#else
+		VertexFormat m_VertexFormat{ VertexFormat::Full };
+#endif
+		bool m_RenderFleet{ false };
+		const int m_FleetSize{ 5 };		// vehicles per side of the grid
+		const float m_FleetSpacing{ 40.f };
+		bool m_UseOcclusionCulling{ true };
+		const size_t m_MaxOccluders{ 4 };
+		bool m_RenderFireFX{ true };
 
 		//DirectX Settings
-		bool m_RenderFireFX{ true };
 		Effect::SampleState m_SampleState{ Effect::SampleState::Point };
 
 		//Software Settings
@@ -110,6 +256,13 @@ namespace dae
 		bool m_UseNormalMap{ true };
 		bool m_RenderDepthBuffer{ false };
 		bool m_RenderBoundingBox{ false };
+		bool m_UseClusteredMesh{ false };
+		SpecularPowerMode m_SpecularPowerMode{ SpecularPowerMode::Lookup };
+		bool m_UseShadows{ true };
+		bool m_UseDepthPrepass{ false };
+		bool m_SortFrontToBack{ true };
+		ShadingTier m_ShadingTier{ ShadingTier::ByScreenSize };
+		const float m_VertexLightingScreenSize{ 96.f };		// pixels, meshes smaller on screen are lit per vertex
 
 #pragma endregion
 
@@ -131,14 +284,53 @@ namespace dae
 		float* m_pDepthBufferPixels{ nullptr };
 		float m_MinDepth{ 0.f };
 		float m_MaxDepth{ 0.f };
+		std::atomic<uint32_t> m_ShadedFragments{ 0 };
+		std::atomic<uint32_t> m_RejectedFragments{ 0 };
+		uint32_t m_CoveredPixels{ 0 };
 
 		const dae::Vector3 m_InvLightDirection{ -0.577f, 0.577f, -0.577f };
 		const float m_KS{ .5f };
 		const float m_LightIntensity{ 7.f };
 		const float m_Shininess{ 25.f };
+		const SpecularLut m_SpecularLut{ m_Shininess };
+
+		// The first light is the sun, the point lights follow it when they are on. Intensities are relative
+		// to the sun's, m_LightIntensity scales the diffuse term of all of them.
+		std::vector<Light> m_Lights{ Light{ LightType::Directional, {}, -m_InvLightDirection, colors::White, 1.f, true } };
+		std::vector<Vector3> m_PointLightAnchors{};		// each point light circles around its anchor
+		const size_t m_PointLightCount{ 256 };
+		std::unique_ptr<TiledLightCulling> m_pLightCulling;
+		ShadowMap m_ShadowMap{ 1024 };
+		float m_ShadowPassMs{};
+		std::unique_ptr<TriangleBins> m_pTriangleBins;
+		float m_SoftwareFrameMs{};
+
+		// Declared before the streams, the jobs behind their futures report back to it
+		std::unique_ptr<AssetLoader> m_pAssetLoader;
+		StreamedMesh m_VehicleStream{};
+		StreamedMesh m_FireStream{};
+		bool m_IsStreaming{ true };
+
+		const std::chrono::steady_clock::time_point m_StartTime{ std::chrono::steady_clock::now() };
+		bool m_HasPresented{ false };
+
+		// Declared before the meshes, their materials point into it
+		TextureCache m_Textures{};
+		GeometryStore m_GeometryStore{};
+		Material m_PlaceholderMaterial{};
+
+		// The fire is a child of the vehicle and follows it without being moved itself
+		SceneGraph m_Scene{};
 
 		std::unique_ptr<Mesh> m_pMesh;
 		std::unique_ptr<Mesh> m_pFireMesh;
+
+		// Depth of the occluders at a fraction of the screen resolution
+		OcclusionBuffer m_OcclusionBuffer{ 256, 128 };
+
+		// Out-of-core version of the vehicle, only there when the AssetCooker wrote its clusters
+		std::unique_ptr<ClusteredMesh> m_pClusteredMesh;
+		const size_t m_ClusterMemoryBudget{ 16 * 1024 * 1024 };
 		std::unique_ptr<Camera> m_pCamera;
 	};
 }
@@ -0,0 +1,87 @@
+#include "pch.h"
+#include "SceneGraph.h"
+#include "Mesh.h"
+#include <algorithm>
+
+namespace dae
+{
+	Matrix Transform::ToMatrix() const
+	{
+		return Matrix::CreateScale(scale) * Matrix::CreateRotation(rotation) * Matrix::CreateTranslation(translation);
+	}
+
+	SceneGraph::NodeId SceneGraph::AddNode(const Transform& localTransform, NodeId parent)
+	{
+		const NodeId node{ static_cast<NodeId>(m_Parents.size()) };
+
+		m_Parents.push_back(parent);
+		m_LocalTransforms.push_back(localTransform);
+		m_WorldMatrices.push_back(Matrix{});
+		m_Dirty.push_back(true);
+		m_Meshes.push_back(nullptr);
+
+		m_HasDirtyNodes = true;
+		return node;
+	}
+
+	void SceneGraph::SetLocalTransform(NodeId node, const Transform& localTransform)
+	{
+		m_LocalTransforms[node] = localTransform;
+		m_Dirty[node] = true;
+		m_HasDirtyNodes = true;
+	}
+
+	const Transform& SceneGraph::GetLocalTransform(NodeId node) const
+	{
+		return m_LocalTransforms[node];
+	}
+
+	const Matrix& SceneGraph::GetWorldMatrix(NodeId node) const
+	{
+		return m_WorldMatrices[node];
+	}
+
+	void SceneGraph::AttachMesh(NodeId node, Mesh* pMesh)
+	{
+		m_Meshes[node] = pMesh;
+
+		// A clean node already has its final matrix, a dirty one hands it over in Update
+		if (pMesh && !m_Dirty[node])
+		{
+			pMesh->SetWorldMatrix(m_WorldMatrices[node]);
+		}
+	}
+
+	void SceneGraph::Update()
+	{
+		if (!m_HasDirtyNodes)
+			return;
+
+		// Parents come first, so a dirty parent is recomputed before any of its children look at it
+		for (NodeId node{ 0 }; node < m_Parents.size(); ++node)
+		{
+			const NodeId parent{ m_Parents[node] };
+			if (parent != NoParent && m_Dirty[parent])
+			{
+				m_Dirty[node] = true;
+			}
+
+			if (!m_Dirty[node])
+				continue;
+
+			m_WorldMatrices[node] = m_LocalTransforms[node].ToMatrix();
+			if (parent != NoParent)
+			{
+				m_WorldMatrices[node] = m_WorldMatrices[node] * m_WorldMatrices[parent];
+			}
+
+			if (m_Meshes[node])
+			{
+				m_Meshes[node]->SetWorldMatrix(m_WorldMatrices[node]);
+			}
+		}
+
+		std::fill(m_Dirty.begin(), m_Dirty.end(), uint8_t{ false });
+		m_HasDirtyNodes = false;
+	}
+}
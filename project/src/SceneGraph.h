@@ -0,0 +1,63 @@
+#pragma once
+#include <vector>
+#include <cstdint>
+#include "DataTypes.h"
+
+class Mesh;
+
+namespace dae
+{
+	// Local transform of a scene node, applied as scale, then rotation, then translation
+	struct Transform
+	{
+		Vector3 translation{};
+		Vector3 rotation{};		// pitch, yaw, roll in radians
+		Vector3 scale{ 1.f, 1.f, 1.f };
+
+		Matrix ToMatrix() const;
+	};
+
+	// Transform hierarchy. Nodes live in flat arrays and are only ever appended, so a parent
+	// always comes before its children and a single forward pass reaches every dirty subtree.
+	// World matrices are rebuilt from the local transforms, nothing accumulates between frames.
+	class SceneGraph final
+	{
+	public:
+		using NodeId = uint32_t;
+		static constexpr NodeId NoParent{ UINT32_MAX };
+
+		SceneGraph() = default;
+		~SceneGraph() = default;
+
+		SceneGraph(const SceneGraph&) = delete;
+		SceneGraph(SceneGraph&&) noexcept = delete;
+		SceneGraph& operator=(const SceneGraph&) = delete;
+		SceneGraph& operator=(SceneGraph&&) noexcept = delete;
+
+		NodeId AddNode(const Transform& localTransform, NodeId parent = NoParent);
+
+		// Marks the node dirty, its subtree is recomputed on the next Update
+		void SetLocalTransform(NodeId node, const Transform& localTransform);
+		const Transform& GetLocalTransform(NodeId node) const;
+
+		// As of the last Update
+		const Matrix& GetWorldMatrix(NodeId node) const;
+
+		// The mesh follows the node's world matrix from now on, nullptr detaches it.
+		// The mesh is not owned and has to be detached before it is destroyed.
+		void AttachMesh(NodeId node, Mesh* pMesh);
+
+		// Recomputes the world matrices of dirty nodes and their descendants and passes them on
+		// to attached meshes. Returns right away when nothing changed since the last call.
+		void Update();
+
+	private:
+		std::vector<NodeId> m_Parents{};
+		std::vector<Transform> m_LocalTransforms{};
+		std::vector<Matrix> m_WorldMatrices{};
+		std::vector<uint8_t> m_Dirty{};
+		std::vector<Mesh*> m_Meshes{};
+
+		bool m_HasDirtyNodes{ false };
+	};
+}
@@ -0,0 +1,32 @@
+#include "ShadowMap.h"
+#include <algorithm>
+#include <cmath>
+
+namespace dae
+{
+	ShadowMap::ShadowMap(int size) :
+		m_Size{ size },
+		m_DepthBias{ 1.f / size },
+		m_Depth(static_cast<size_t>(size) * size, 1.f)
+	{
+	}
+
+	void ShadowMap::Begin(const Vector3& lightDirection, const BoundingSphere& casters)
+	{
+		// Any up vector that is not parallel to the light will do
+		const Vector3 forward{ lightDirection.Normalized() };
+		const Vector3 up{ std::abs(forward.y) < 0.99f ? Vector3::UnitY : Vector3::UnitZ };
+		const Vector3 right{ Vector3::Cross(up, forward).Normalized() };
+		const Vector3 trueUp{ Vector3::Cross(forward, right) };
+
+		// Placed on the sphere, the whole sphere fits between the near and far plane
+		const float radius{ std::max(casters.radius, 0.001f) };
+		const Matrix lightToWorld{ right, trueUp, forward, casters.center - forward * radius };
+		m_ViewProjection = Matrix::Inverse(lightToWorld) * Matrix::CreateOrthographicLH(2.f * radius, 2.f * radius, 0.f, 2.f * radius);
+
+		// The map spans the sphere's diameter in x, y and depth
+		m_TexelSize = 2.f * radius / m_Size;
+
+		std::fill(m_Depth.begin(), m_Depth.end(), 1.f);
+	}
+}
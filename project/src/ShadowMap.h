@@ -0,0 +1,63 @@
+#pragma once
+#include <vector>
+#include <cstdint>
+#include "DataTypes.h"
+
+namespace dae
+{
+	// Depth of the shadow casters as seen from a directional light, through an orthographic projection
+	// fitted around the casters. The Renderer rasterizes into it with its depth-only triangle loop.
+	class ShadowMap final
+	{
+	public:
+		explicit ShadowMap(int size);
+		~ShadowMap() = default;
+
+		ShadowMap(const ShadowMap&) = delete;
+		ShadowMap(ShadowMap&&) noexcept = delete;
+		ShadowMap& operator=(const ShadowMap&) = delete;
+		ShadowMap& operator=(ShadowMap&&) noexcept = delete;
+
+		// Looks along lightDirection at the casters and clears the depth, nothing is in shadow until triangles are drawn
+		void Begin(const Vector3& lightDirection, const BoundingSphere& casters);
+
+		// World to shadow map clip space, x and y in [-1, 1], z in [0, 1]
+		const Matrix& GetViewProjection() const { return m_ViewProjection; }
+		int GetSize() const { return m_Size; }
+		float* GetDepth() { return m_Depth.data(); }
+
+		// 3x3 percentage closer filter, 1 when the point is lit and 0 when all nine texels around it are in shadow.
+		// The point is pushed a texel along its normal first, which keeps surfaces from shadowing themselves.
+		float GetLitFraction(const Vector3& worldPosition, const Vector3& normal) const
+		{
+			const Vector4 clip{ m_ViewProjection.TransformPoint((worldPosition + normal * m_TexelSize).ToPoint4()) };
+			const float depth{ clip.z - m_DepthBias };
+			const int centerX{ static_cast<int>(((clip.x + 1) / 2) * m_Size) };
+			const int centerY{ static_cast<int>(((1 - clip.y) / 2) * m_Size) };
+
+			int litCount{ 0 };
+			for (int y{ centerY - 1 }; y <= centerY + 1; ++y)
+			{
+				for (int x{ centerX - 1 }; x <= centerX + 1; ++x)
+				{
+					// Outside the map nothing was drawn, so it is lit
+					if (x < 0 || y < 0 || x >= m_Size || y >= m_Size || depth <= m_Depth[y * m_Size + x])
+					{
+						++litCount;
+					}
+				}
+			}
+
+			return litCount / 9.f;
+		}
+
+	private:
+		const int m_Size;
+		// Both one texel, the depth bias in [0, 1] depth and the normal offset in world units
+		const float m_DepthBias;
+		float m_TexelSize{};
+
+		Matrix m_ViewProjection{};
+		std::vector<float> m_Depth{};
+	};
+}
@@ -0,0 +1,229 @@
+#pragma once
+#include "DataTypes.h"
+#include "SDL.h"
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <execution>
+#include <span>
+#include <vector>
+
+namespace dae
+{
+	// Colour and depth buffer a pipeline draws into, owned by the Renderer
+	struct RenderTarget
+	{
+		uint32_t* pPixels{ nullptr };
+		float* pDepth{ nullptr };
+		const SDL_PixelFormat* pFormat{ nullptr };
+		int width{};
+		int height{};
+	};
+
+	// The fixed function part of a pass, the software version of the state objects in the .fx files
+	struct PipelineState
+	{
+		CullMode cullMode{ CullMode::Back };
+		bool depthWrite{ true };
+		bool alphaBlend{ false };	// src_alpha, inv_src_alpha
+	};
+
+	// Vertex shader output, the position is in clip space
+	template<typename Varyings>
+	struct ShadedVertex
+	{
+		Vector4 position{};
+		Varyings varyings{};
+	};
+
+	// Pixel shader output, colour and alpha in [0, 1]
+	struct PixelOutput
+	{
+		ColorRGB color{};
+		float alpha{ 1.f };
+	};
+
+	// Software counterpart of an effect pass. The shaders are functors whose calls inline into the pixel loop:
+	//   VertexShader: ShadedVertex<Varyings> operator()(const Vertex_In&) const
+	//   PixelShader:  PixelOutput operator()(const Varyings&) const
+	// Varyings can be any struct with operator+ and operator*(float), they are interpolated perspective correct.
+	template<typename VertexShader, typename PixelShader, typename Varyings, PipelineState state = PipelineState{}>
+	class Pipeline final
+	{
+	public:
+		Pipeline(const VertexShader& vertexShader, const PixelShader& pixelShader, const RenderTarget& target) :
+			m_VertexShader{ vertexShader },
+			m_PixelShader{ pixelShader },
+			m_Target{ target }
+		{
+		}
+
+		// Both stages for one draw
+		void Draw(std::span<const Vertex_In> vertices, std::span<const uint32_t> indices, PrimitiveTopology topology = PrimitiveTopology::TriangleList)
+		{
+			ShadeVertices(vertices, indices);
+			DrawShaded(indices, topology);
+		}
+
+		// Vertex stage only, every vertex inside the range the indices reach is shaded once. Shading the
+		// indices of a whole LOD lets all its submeshes draw from one pass over the vertices.
+		void ShadeVertices(std::span<const Vertex_In> vertices, std::span<const uint32_t> indices)
+		{
+			m_Vertices.clear();
+			if (indices.empty()) return;
+
+			const auto [minIndex, maxIndex] = std::minmax_element(indices.begin(), indices.end());
+			m_FirstVertex = *minIndex;
+			const std::span<const Vertex_In> usedVertices{ vertices.subspan(m_FirstVertex, *maxIndex - m_FirstVertex + 1) };
+
+			m_Vertices.resize(usedVertices.size());
+			std::transform(std::execution::par_unseq, usedVertices.begin(), usedVertices.end(), m_Vertices.begin(), [this](const Vertex_In& vertex)
+				{
+					return ToScreenSpace(m_VertexShader(vertex));
+				});
+		}
+
+		// Per submesh state, the shaded vertices stay valid
+		void SetPixelShader(const PixelShader& pixelShader)
+		{
+			m_PixelShader = pixelShader;
+		}
+
+		// Assembles and rasterizes from the last ShadeVertices, the indices have to lie inside the range it shaded
+		void DrawShaded(std::span<const uint32_t> indices, PrimitiveTopology topology = PrimitiveTopology::TriangleList)
+		{
+			m_Triangles.clear();
+			const size_t increment{ topology == PrimitiveTopology::TriangleList ? 3u : 1u };
+			for (size_t index{ 0 }; index + 2 < indices.size(); index += increment)
+			{
+				const bool isOdd{ topology == PrimitiveTopology::TriangleStrip && index % 2 != 0 };
+				const std::array<uint32_t, 3> corners{ indices[index], indices[index + (isOdd ? 2 : 1)], indices[index + (isOdd ? 1 : 2)] };
+
+				// Skip degenerate triangles
+				if (corners[0] == corners[1] || corners[1] == corners[2] || corners[0] == corners[2]) continue;
+
+				const ScreenVertex& v0{ m_Vertices[corners[0] - m_FirstVertex] };
+				const ScreenVertex& v1{ m_Vertices[corners[1] - m_FirstVertex] };
+				const ScreenVertex& v2{ m_Vertices[corners[2] - m_FirstVertex] };
+				if (!v0.isInside && !v1.isInside && !v2.isInside) continue;
+
+				m_Triangles.push_back({ &v0, &v1, &v2 });
+			}
+
+			// Blending depends on what is underneath, so blended triangles keep their submission order like on the GPU
+			if constexpr (state.alphaBlend)
+			{
+				std::for_each(m_Triangles.begin(), m_Triangles.end(), [this](const ScreenTriangle& triangle) { RasterizeTriangle(triangle); });
+			}
+			else
+			{
+				std::for_each(std::execution::par_unseq, m_Triangles.begin(), m_Triangles.end(), [this](const ScreenTriangle& triangle) { RasterizeTriangle(triangle); });
+			}
+		}
+
+	private:
+		// Pixel coordinates, depth and 1 / w. The varyings are divided by w, which makes them linear on screen.
+		struct ScreenVertex
+		{
+			Vector2 position{};
+			float depth{};
+			float invW{};
+			Varyings varyings{};
+			bool isInside{};
+		};
+		using ScreenTriangle = std::array<const ScreenVertex*, 3>;
+
+		ScreenVertex ToScreenSpace(const ShadedVertex<Varyings>& vertex) const
+		{
+			// Same divide and viewport as Renderer::VertexTransformationFunction
+			const float w{ std::fmax(0.0001f, vertex.position.w) };
+			const Vector4 ndc{ vertex.position.x / w, vertex.position.y / w, vertex.position.z / w, w };
+
+			return ScreenVertex{
+				{ ((ndc.x + 1) / 2) * m_Target.width, ((1 - ndc.y) / 2) * m_Target.height },
+				ndc.z,
+				1.f / w,
+				vertex.varyings * (1.f / w),
+				Frustum::IsInsideClipSpace(ndc) };
+		}
+
+		void RasterizeTriangle(const ScreenTriangle& triangle) const
+		{
+			const ScreenVertex& v0{ *triangle[0] };
+			const ScreenVertex& v1{ *triangle[1] };
+			const ScreenVertex& v2{ *triangle[2] };
+
+			// Positive when the corners run clockwise on screen, the front face
+			const float area{ Vector2::Cross(v1.position - v0.position, v2.position - v0.position) };
+			if constexpr (state.cullMode == CullMode::Back)
+			{
+				if (area <= 0.f) return;
+			}
+			else if constexpr (state.cullMode == CullMode::Front)
+			{
+				if (area >= 0.f) return;
+			}
+			else
+			{
+				if (area == 0.f) return;
+			}
+			const float invArea{ 1.f / area };
+
+			const int minX{ static_cast<int>(std::floor(std::max(0.f, std::min({ v0.position.x, v1.position.x, v2.position.x })))) };
+			const int minY{ static_cast<int>(std::floor(std::max(0.f, std::min({ v0.position.y, v1.position.y, v2.position.y })))) };
+			const int maxX{ static_cast<int>(std::ceil(std::min(static_cast<float>(m_Target.width), std::max({ v0.position.x, v1.position.x, v2.position.x })))) };
+			const int maxY{ static_cast<int>(std::ceil(std::min(static_cast<float>(m_Target.height), std::max({ v0.position.y, v1.position.y, v2.position.y })))) };
+
+			for (int py{ minY }; py < maxY; ++py)
+			{
+				for (int px{ minX }; px < maxX; ++px)
+				{
+					const Vector2 point{ px + 0.5f, py + 0.5f };
+
+					// Each weight belongs to the corner opposite of its edge
+					const float weight0{ Vector2::Cross(v2.position - v1.position, point - v1.position) * invArea };
+					const float weight1{ Vector2::Cross(v0.position - v2.position, point - v2.position) * invArea };
+					const float weight2{ Vector2::Cross(v1.position - v0.position, point - v0.position) * invArea };
+					if (weight0 < 0.f || weight1 < 0.f || weight2 < 0.f) continue;
+
+					// Interpolated like the fixed function path, so both can share the depth buffer
+					const float depth{ 1.f / (weight0 / v0.depth + weight1 / v1.depth + weight2 / v2.depth) };
+					const int pixelIndex{ px + py * m_Target.width };
+					if (depth < 0.f || depth > 1.f || !(depth < m_Target.pDepth[pixelIndex])) continue;
+
+					if constexpr (state.depthWrite)
+					{
+						m_Target.pDepth[pixelIndex] = depth;
+					}
+
+					const float w{ 1.f / (weight0 * v0.invW + weight1 * v1.invW + weight2 * v2.invW) };
+					const Varyings varyings{ (v0.varyings * weight0 + v1.varyings * weight1 + v2.varyings * weight2) * w };
+
+					const PixelOutput output{ m_PixelShader(varyings) };
+					ColorRGB color{ output.color };
+					if constexpr (state.alphaBlend)
+					{
+						uint8_t r{}, g{}, b{};
+						SDL_GetRGB(m_Target.pPixels[pixelIndex], m_Target.pFormat, &r, &g, &b);
+						const ColorRGB destination{ ColorRGB{ static_cast<float>(r), static_cast<float>(g), static_cast<float>(b) } / 255.f };
+						color = color * output.alpha + destination * (1.f - output.alpha);
+					}
+					color.MaxToOne();
+
+					m_Target.pPixels[pixelIndex] = SDL_MapRGB(m_Target.pFormat,
+						static_cast<uint8_t>(color.r * 255),
+						static_cast<uint8_t>(color.g * 255),
+						static_cast<uint8_t>(color.b * 255));
+				}
+			}
+		}
+
+		VertexShader m_VertexShader;
+		PixelShader m_PixelShader;
+		RenderTarget m_Target;
+
+		std::vector<ScreenVertex> m_Vertices{};	// m_Vertices[0] is vertex m_FirstVertex
+		uint32_t m_FirstVertex{};
+		std::vector<ScreenTriangle> m_Triangles{};
+	};
+}
@@ -0,0 +1,48 @@
+#pragma once
+#include "SoftwarePipeline.h"
+#include "Texture.h"
+
+namespace dae
+{
+	// CPU ports of the effects in resources/, drawn through a Pipeline
+
+#pragma region Transparent.fx
+	struct TransparentVaryings
+	{
+		Vector2 uv{};
+
+		TransparentVaryings operator+(const TransparentVaryings& other) const
+		{
+			return { uv + other.uv };
+		}
+
+		TransparentVaryings operator*(float scale) const
+		{
+			return { uv * scale };
+		}
+	};
+
+	struct TransparentVertexShader
+	{
+		Matrix worldViewProjection{};
+
+		ShadedVertex<TransparentVaryings> operator()(const Vertex_In& vertex) const
+		{
+			return { worldViewProjection.TransformPoint(vertex.position.ToPoint4()), { vertex.uv } };
+		}
+	};
+
+	struct TransparentPixelShader
+	{
+		const Texture* pDiffuseMap{ nullptr };
+
+		PixelOutput operator()(const TransparentVaryings& pixel) const
+		{
+			return { pDiffuseMap->Sample(pixel.uv) / 255.f, pDiffuseMap->SampleAlpha(pixel.uv) / 255.f };
+		}
+	};
+
+	// Cull none, depth test without writing, alpha blended
+	using TransparentPipeline = Pipeline<TransparentVertexShader, TransparentPixelShader, TransparentVaryings, PipelineState{ CullMode::None, false, true }>;
+#pragma endregion
+}
@@ -0,0 +1,102 @@
+#include "SpecularPower.h"
+#include <chrono>
+#include <random>
+
+namespace dae
+{
+	SpecularLut::SpecularLut(float maxExponent, uint32_t glossSteps, uint32_t angleSteps) :
+		m_MaxExponent{ maxExponent },
+		m_GlossSteps{ glossSteps },
+		m_AngleSteps{ angleSteps },
+		m_Values(static_cast<size_t>(glossSteps) * (angleSteps + 1))
+	{
+		for (uint32_t row{ 0 }; row < m_GlossSteps; ++row)
+		{
+			const float exponent{ static_cast<float>(row) / (m_GlossSteps - 1) * m_MaxExponent };
+			m_SteepRows += exponent < 1.f;
+			for (uint32_t column{ 0 }; column <= m_AngleSteps; ++column)
+			{
+				m_Values[row * (m_AngleSteps + 1) + column] = std::pow(static_cast<float>(column) / m_AngleSteps, exponent);
+			}
+		}
+	}
+
+	namespace
+	{
+		template<SpecularPowerMode mode>
+		float Evaluate(const SpecularLut& lut, float cosAngle, float gloss)
+		{
+			if constexpr (mode == SpecularPowerMode::Lookup)
+			{
+				return lut.Evaluate(cosAngle, gloss);
+			}
+			else
+			{
+				return std::pow(cosAngle, gloss * lut.GetMaxExponent());
+			}
+		}
+
+		template<SpecularPowerMode mode>
+		SpecularPowerReport Measure(const SpecularLut& lut)
+		{
+			SpecularPowerReport report{};
+
+			// Gloss comes from an 8 bit map, so these are all the exponents a pixel can use
+			constexpr int glossLevels{ 256 };
+			constexpr int cosineSteps{ 4096 };
+			for (int level{ 0 }; level < glossLevels; ++level)
+			{
+				const float gloss{ static_cast<float>(level) / (glossLevels - 1) };
+				for (int step{ 0 }; step <= cosineSteps; ++step)
+				{
+					const float cosAngle{ static_cast<float>(step) / cosineSteps };
+					const float error{ std::abs(Evaluate<mode>(lut, cosAngle, gloss) - std::pow(cosAngle, gloss * lut.GetMaxExponent())) };
+					if (error > report.maxError)
+					{
+						report.maxError = error;
+						report.maxErrorCosAngle = cosAngle;
+						report.maxErrorGloss = gloss;
+					}
+				}
+			}
+
+			// Random inputs, so neither the branch predictor nor the cache get an easier time than in a frame
+			constexpr size_t sampleCount{ 1 << 22 };
+			std::vector<float> cosAngles(sampleCount);
+			std::vector<float> glosses(sampleCount);
+			std::mt19937 generator{ 42 };
+			std::uniform_real_distribution<float> distribution{ 0.f, 1.f };
+			for (size_t sample{ 0 }; sample < sampleCount; ++sample)
+			{
+				cosAngles[sample] = distribution(generator);
+				glosses[sample] = std::round(distribution(generator) * (glossLevels - 1)) / (glossLevels - 1);
+			}
+
+			const auto start{ std::chrono::steady_clock::now() };
+			float sum{ 0.f };
+			for (size_t sample{ 0 }; sample < sampleCount; ++sample)
+			{
+				sum += Evaluate<mode>(lut, cosAngles[sample], glosses[sample]);
+			}
+			const std::chrono::duration<double, std::nano> elapsed{ std::chrono::steady_clock::now() - start };
+
+			// Keeps the loop from being optimized away
+			volatile float sink{ sum };
+			(void)sink;
+
+			report.nanosecondsPerCall = elapsed.count() / sampleCount;
+			return report;
+		}
+	}
+
+	SpecularPowerReport MeasureSpecularPower(SpecularPowerMode mode, const SpecularLut& lut)
+	{
+		switch (mode)
+		{
+		case SpecularPowerMode::Lookup:
+			return Measure<SpecularPowerMode::Lookup>(lut);
+		default:
+			return Measure<SpecularPowerMode::Exact>(lut);
+		}
+	}
+}
@@ -0,0 +1,58 @@
+#pragma once
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <vector>
+
+namespace dae
+{
+	// How the software shading raises the specular cosine to the glossiness exponent
+	enum class SpecularPowerMode
+	{
+		Exact,	// std::pow
+		Lookup	// SpecularLut
+	};
+
+	// pow(cosAngle, gloss * maxExponent) for the 256 gloss levels of an 8 bit gloss map.
+	// Each row is sampled at angleSteps + 1 cosines and linearly interpolated between them. Rows with
+	// an exponent below 1 have an infinite slope at 0, no line fits their first cell, so it calls std::pow.
+	// With the renderer's exponent of 25 the result stays within one 8 bit step, see tests/SpecularPowerTest.cpp.
+	class SpecularLut final
+	{
+	public:
+		explicit SpecularLut(float maxExponent, uint32_t glossSteps = 256, uint32_t angleSteps = 256);
+
+		// gloss in [0, 1], as read from the gloss map
+		float Evaluate(float cosAngle, float gloss) const
+		{
+			const uint32_t row{ static_cast<uint32_t>(std::clamp(gloss, 0.f, 1.f) * (m_GlossSteps - 1) + 0.5f) };
+			const float position{ std::clamp(cosAngle, 0.f, 1.f) * m_AngleSteps };
+			const uint32_t column{ std::min(static_cast<uint32_t>(position), m_AngleSteps - 1) };
+			if (column == 0 && row < m_SteepRows)
+				return std::pow(std::clamp(cosAngle, 0.f, 1.f), static_cast<float>(row) / (m_GlossSteps - 1) * m_MaxExponent);
+
+			const float* pValues{ &m_Values[row * (m_AngleSteps + 1) + column] };
+			return pValues[0] + (pValues[1] - pValues[0]) * (position - column);
+		}
+
+		float GetMaxExponent() const { return m_MaxExponent; }
+
+	private:
+		const float m_MaxExponent;
+		const uint32_t m_GlossSteps;
+		const uint32_t m_AngleSteps;
+		uint32_t m_SteepRows{};		// rows with an exponent below 1
+		std::vector<float> m_Values{};
+	};
+
+	// Error against std::pow over every gloss level and a fine sweep of cosines, plus the cost per call
+	struct SpecularPowerReport
+	{
+		float maxError{};
+		float maxErrorCosAngle{};
+		float maxErrorGloss{};
+		double nanosecondsPerCall{};
+	};
+
+	SpecularPowerReport MeasureSpecularPower(SpecularPowerMode mode, const SpecularLut& lut);
+}
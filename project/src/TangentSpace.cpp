@@ -0,0 +1,256 @@
+#include "TangentSpace.h"
+#include <algorithm>
+#include <execution>
+#include <numeric>
+#include <array>
+#include <atomic>
+#include <cmath>
+
+namespace dae
+{
+	namespace
+	{
+		constexpr uint32_t TrianglesPerChunk{ 16384 };
+		constexpr uint32_t VerticesPerBlock{ 65536 };
+		constexpr uint32_t NoCopy{ UINT32_MAX };
+
+		// One corner's weighted tangent, key is vertex * 2 + side (0 unmirrored, 1 mirrored)
+		struct Contribution
+		{
+			uint32_t key{};
+			Vector3 tangent{};
+		};
+
+		// Tangent sums of one chunk of triangles. Dense over the vertex range those triangles use when it is
+		// compact, otherwise (remapped or LOD ordered index buffers can span the whole mesh from every chunk)
+		// the corners are listed and sorted by vertex, so memory never exceeds 3 entries per triangle.
+		struct ChunkSums
+		{
+			uint32_t firstVertex{};
+			std::vector<std::array<Vector3, 2>> tangents{};	// unmirrored, mirrored
+			std::vector<Contribution> contributions{};
+		};
+
+		float CornerAngle(const Vector3& edge0, const Vector3& edge1)
+		{
+			const float lengths{ std::sqrt(edge0.SqrMagnitude() * edge1.SqrMagnitude()) };
+			if (lengths <= 0.f)
+				return 0.f;
+
+			return std::acos(std::clamp(Vector3::Dot(edge0, edge1) / lengths, -1.f, 1.f));
+		}
+
+		void SetFrame(Vertex_In& vertex, const Vector3& tangentSum, float sign)
+		{
+			Vector3 tangent{ Vector3::Reject(tangentSum, vertex.normal) };
+			if (tangent.SqrMagnitude() <= 0.f)
+			{
+				// Nothing usable around this vertex, any direction in the surface will do
+				const Vector3 axis{ std::abs(vertex.normal.x) < 0.9f ? Vector3::UnitX : Vector3::UnitY };
+				tangent = Vector3::Reject(axis, vertex.normal);
+			}
+
+			vertex.tangent = tangent.Normalized();
+			vertex.tangentSign = sign;
+		}
+	}
+
+	std::vector<uint32_t> TangentSpace::Generate(std::vector<Vertex_In>& vertices, std::vector<uint32_t>& indices)
+	{
+		const uint32_t vertexCount{ static_cast<uint32_t>(vertices.size()) };
+		const uint32_t triangleCount{ static_cast<uint32_t>(indices.size() / 3) };
+
+		// 0 unmirrored, 1 mirrored, -1 until decided for triangles without a usable uv mapping
+		std::vector<int8_t> triangleSides(triangleCount, -1);
+
+		// Every chunk sums into its own arrays, nothing is shared between threads
+		const uint32_t chunkCount{ (triangleCount + TrianglesPerChunk - 1) / TrianglesPerChunk };
+		std::vector<ChunkSums> chunks(chunkCount);
+		std::vector<uint32_t> chunkIndices(chunkCount);
+		std::iota(chunkIndices.begin(), chunkIndices.end(), 0);
+
+		std::for_each(std::execution::par, chunkIndices.begin(), chunkIndices.end(), [&](uint32_t chunk)
+			{
+				const uint32_t firstTriangle{ chunk * TrianglesPerChunk };
+				const uint32_t endTriangle{ std::min(firstTriangle + TrianglesPerChunk, triangleCount) };
+
+				// Dense while it costs no more than the listed corners would
+				const auto [minIndex, maxIndex] = std::minmax_element(indices.begin() + firstTriangle * 3, indices.begin() + endTriangle * 3);
+				const size_t span{ static_cast<size_t>(*maxIndex - *minIndex) + 1 };
+				const size_t cornerCount{ static_cast<size_t>(endTriangle - firstTriangle) * 3 };
+				const bool isDense{ span * sizeof(std::array<Vector3, 2>) <= cornerCount * sizeof(Contribution) };
+
+				ChunkSums& sums{ chunks[chunk] };
+				sums.firstVertex = *minIndex;
+				if (isDense)
+				{
+					sums.tangents.resize(span);
+				}
+				else
+				{
+					sums.contributions.reserve(cornerCount);
+				}
+
+				for (uint32_t triangle{ firstTriangle }; triangle < endTriangle; ++triangle)
+				{
+					const uint32_t* pCorners{ &indices[triangle * 3] };
+					const std::array<const Vertex_In*, 3> corners{ &vertices[pCorners[0]], &vertices[pCorners[1]], &vertices[pCorners[2]] };
+
+					const Vector3 edge0{ corners[1]->position - corners[0]->position };
+					const Vector3 edge1{ corners[2]->position - corners[0]->position };
+					const Vector2 uvEdge0{ corners[1]->uv - corners[0]->uv };
+					const Vector2 uvEdge1{ corners[2]->uv - corners[0]->uv };
+
+					// Only the directions are needed, so the uv determinant just contributes its sign
+					// instead of being divided by. Zero means the triangle has no uv area at all.
+					const float determinant{ Vector2::Cross(uvEdge0, uvEdge1) };
+					if (determinant == 0.f || !std::isfinite(determinant))
+						continue;
+
+					const float uvSign{ determinant > 0.f ? 1.f : -1.f };
+					const Vector3 tangent{ (edge0 * uvEdge1.y - edge1 * uvEdge0.y) * uvSign };
+					const Vector3 bitangent{ (edge1 * uvEdge0.x - edge0 * uvEdge1.x) * uvSign };
+
+					// Handedness against the vertex normals, so the index winding does not matter
+					const Vector3 normal{ corners[0]->normal + corners[1]->normal + corners[2]->normal };
+					const int8_t side{ static_cast<int8_t>(Vector3::Dot(Vector3::Cross(normal, tangent), bitangent) < 0.f ? 1 : 0) };
+					triangleSides[triangle] = side;
+
+					for (uint32_t corner{ 0 }; corner < 3; ++corner)
+					{
+						const Vertex_In& vertex{ *corners[corner] };
+						Vector3 projected{ Vector3::Reject(tangent, vertex.normal) };
+						if (projected.SqrMagnitude() <= 0.f)
+							continue;
+						projected.Normalize();
+
+						const float angle{ CornerAngle(corners[(corner + 1) % 3]->position - vertex.position, corners[(corner + 2) % 3]->position - vertex.position) };
+						if (isDense)
+						{
+							sums.tangents[pCorners[corner] - sums.firstVertex][side] += projected * angle;
+						}
+						else
+						{
+							sums.contributions.push_back({ pCorners[corner] * 2 + side, projected * angle });
+						}
+					}
+				}
+
+				// Stable, so each vertex still sums its triangles in index order
+				std::stable_sort(sums.contributions.begin(), sums.contributions.end(), [](const Contribution& a, const Contribution& b) { return a.key < b.key; });
+			});
+
+		// Merge per block of vertices, always in chunk order so the result does not depend on the thread count
+		std::vector<std::array<Vector3, 2>> tangents(vertexCount);
+		std::vector<uint32_t> blocks((vertexCount + VerticesPerBlock - 1) / VerticesPerBlock);
+		std::iota(blocks.begin(), blocks.end(), 0);
+
+		std::for_each(std::execution::par, blocks.begin(), blocks.end(), [&](uint32_t block)
+			{
+				const uint32_t firstVertex{ block * VerticesPerBlock };
+				const uint32_t endVertex{ std::min(firstVertex + VerticesPerBlock, vertexCount) };
+
+				for (const ChunkSums& sums : chunks)
+				{
+					const uint32_t overlapBegin{ std::max(firstVertex, sums.firstVertex) };
+					const uint32_t overlapEnd{ std::min(endVertex, sums.firstVertex + static_cast<uint32_t>(sums.tangents.size())) };
+					for (uint32_t vertex{ overlapBegin }; vertex < overlapEnd; ++vertex)
+					{
+						tangents[vertex][0] += sums.tangents[vertex - sums.firstVertex][0];
+						tangents[vertex][1] += sums.tangents[vertex - sums.firstVertex][1];
+					}
+
+					const auto byKey{ [](const Contribution& contribution, uint32_t key) { return contribution.key < key; } };
+					const auto begin{ std::lower_bound(sums.contributions.begin(), sums.contributions.end(), firstVertex * 2, byKey) };
+					const auto end{ std::lower_bound(begin, sums.contributions.end(), endVertex * 2, byKey) };
+					for (auto contribution{ begin }; contribution != end; ++contribution)
+					{
+						tangents[contribution->key / 2][contribution->key % 2] += contribution->tangent;
+					}
+				}
+			});
+
+		// Triangles without uv area take the side most of their corners ended up on
+		std::vector<uint32_t> triangles(triangleCount);
+		std::iota(triangles.begin(), triangles.end(), 0);
+
+		const auto isMirroredOnly{ [&](uint32_t vertex)
+			{
+				return tangents[vertex][0].SqrMagnitude() <= 0.f && tangents[vertex][1].SqrMagnitude() > 0.f;
+			} };
+
+		std::vector<std::atomic<uint8_t>> usedSides(vertexCount);
+		std::for_each(std::execution::par, triangles.begin(), triangles.end(), [&](uint32_t triangle)
+			{
+				const uint32_t* pCorners{ &indices[triangle * 3] };
+				if (triangleSides[triangle] < 0)
+				{
+					const int mirroredCorners{ isMirroredOnly(pCorners[0]) + isMirroredOnly(pCorners[1]) + isMirroredOnly(pCorners[2]) };
+					triangleSides[triangle] = mirroredCorners >= 2 ? 1 : 0;
+				}
+
+				for (uint32_t corner{ 0 }; corner < 3; ++corner)
+				{
+					usedSides[pCorners[corner]].fetch_or(static_cast<uint8_t>(1 << triangleSides[triangle]), std::memory_order_relaxed);
+				}
+			});
+
+		// Vertices on a mirror seam get a copy for the mirrored side
+		std::vector<uint32_t> mirroredCopies(vertexCount, NoCopy);
+		std::vector<uint32_t> sources{};
+		for (uint32_t vertex{ 0 }; vertex < vertexCount; ++vertex)
+		{
+			if (usedSides[vertex].load(std::memory_order_relaxed) == 3)
+			{
+				mirroredCopies[vertex] = vertexCount + static_cast<uint32_t>(sources.size());
+				sources.push_back(vertex);
+			}
+		}
+
+		vertices.reserve(vertexCount + sources.size());
+		for (const uint32_t source : sources)
+		{
+			vertices.push_back(vertices[source]);
+		}
+
+		std::vector<uint32_t> vertexIndices(vertexCount);
+		std::iota(vertexIndices.begin(), vertexIndices.end(), 0);
+
+		std::for_each(std::execution::par, vertexIndices.begin(), vertexIndices.end(), [&](uint32_t vertex)
+			{
+				// A side only reached through triangles without uv area borrows the other side's direction
+				const auto& [unmirrored, mirrored] = tangents[vertex];
+				const Vector3& unmirroredSum{ unmirrored.SqrMagnitude() > 0.f ? unmirrored : mirrored };
+				const Vector3& mirroredSum{ mirrored.SqrMagnitude() > 0.f ? mirrored : unmirrored };
+
+				const uint8_t sides{ usedSides[vertex].load(std::memory_order_relaxed) };
+				const bool isMirrored{ sides == 2 || (sides == 0 && isMirroredOnly(vertex)) };
+				SetFrame(vertices[vertex], isMirrored ? mirroredSum : unmirroredSum, isMirrored ? -1.f : 1.f);
+
+				if (mirroredCopies[vertex] != NoCopy)
+				{
+					SetFrame(vertices[mirroredCopies[vertex]], mirroredSum, -1.f);
+				}
+			});
+
+		if (!sources.empty())
+		{
+			std::for_each(std::execution::par, triangles.begin(), triangles.end(), [&](uint32_t triangle)
+				{
+					if (triangleSides[triangle] != 1)
+						return;
+
+					for (uint32_t corner{ 0 }; corner < 3; ++corner)
+					{
+						uint32_t& index{ indices[triangle * 3 + corner] };
+						if (mirroredCopies[index] != NoCopy)
+						{
+							index = mirroredCopies[index];
+						}
+					}
+				});
+		}
+
+		return sources;
+	}
+}
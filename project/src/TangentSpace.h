@@ -0,0 +1,18 @@
+#pragma once
+#include <vector>
+#include <cstdint>
+#include "DataTypes.h"
+
+namespace dae
+{
+	// MikkTSpace style per-vertex tangent frames, meant to run on welded meshes
+	namespace TangentSpace
+	{
+		// Fills tangent and tangentSign (bitangent = tangentSign * cross(normal, tangent)).
+		// Triangle tangents are projected onto the vertex normal and angle weighted, triangles
+		// without a usable uv mapping do not contribute. Vertices shared by mirrored and
+		// unmirrored triangles are split, the copies are appended to vertices and the returned
+		// list holds the vertex each copy was made from, so per-vertex data can follow along.
+		std::vector<uint32_t> Generate(std::vector<Vertex_In>& vertices, std::vector<uint32_t>& indices);
+	}
+}
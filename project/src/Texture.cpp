@@ -1,43 +1,53 @@
 #include "Texture.h"
 #include <iostream>
-#include <SDL_image.h>
+#include <algorithm>
 #include "Math.h"
 
 namespace dae
 {
-	Texture::Texture(SDL_Surface* pSurface, ID3D11Device* pDevice) :
+	Texture::Texture(const TextureData& data, ID3D11Device* pDevice) :
 		m_pResource{ nullptr },
 		m_pShaderResourceView{ nullptr },
-		m_pSurface{ pSurface },
-		m_pSurfacePixels{ static_cast<uint32_t*>(pSurface->pixels) }
+		m_Width{ data.width },
+		m_Height{ data.height },
+		m_Texels{ data.texels.begin(), data.texels.begin() + static_cast<size_t>(data.width) * data.height }
 	{
 		DXGI_FORMAT format{ DXGI_FORMAT_R8G8B8A8_UNORM };
 		D3D11_TEXTURE2D_DESC desc{};
-		desc.Width = pSurface->w;
-		desc.Height = pSurface->h;
-		desc.MipLevels = 1;
+		desc.Width = data.width;
+		desc.Height = data.height;
+		desc.MipLevels = data.mipCount;
 		desc.ArraySize = 1;
 		desc.Format = format;
 		desc.SampleDesc.Count = 1;
 		desc.SampleDesc.Quality = 0;
-		desc.Usage = D3D11_USAGE_DEFAULT;
-		desc.BindFlags = D3D11_BIND_SHADER_RESOURCE | D3D11_BIND_RENDER_TARGET;
+		desc.Usage = D3D11_USAGE_IMMUTABLE;
+		desc.BindFlags = D3D11_BIND_SHADER_RESOURCE;
 		desc.CPUAccessFlags = 0;
-		desc.MiscFlags = D3D11_RESOURCE_MISC_GENERATE_MIPS;
+		desc.MiscFlags = 0;
 
-		D3D11_SUBRESOURCE_DATA initData;
-		initData.pSysMem = pSurface->pixels;
-		initData.SysMemPitch = static_cast<UINT>(pSurface->pitch);
-		initData.SysMemSlicePitch = static_cast<UINT>(pSurface->h * pSurface->pitch);
+		// One entry per mip level, cooked textures bring their whole chain
+		std::vector<D3D11_SUBRESOURCE_DATA> initData(data.mipCount);
+		size_t offset{ 0 };
+		for (uint32_t mip{ 0 }; mip < data.mipCount; ++mip)
+		{
+			const uint32_t mipWidth{ std::max(data.width >> mip, 1u) };
+			const uint32_t mipHeight{ std::max(data.height >> mip, 1u) };
+
+			initData[mip].pSysMem = &data.texels[offset];
+			initData[mip].SysMemPitch = mipWidth * sizeof(uint32_t);
+			initData[mip].SysMemSlicePitch = mipWidth * mipHeight * sizeof(uint32_t);
+			offset += static_cast<size_t>(mipWidth) * mipHeight;
+		}
 
-		HRESULT hr = pDevice->CreateTexture2D(&desc, &initData, &m_pResource);
+		HRESULT hr = pDevice->CreateTexture2D(&desc, initData.data(), &m_pResource);
 
 		if (FAILED(hr)) std::wcout << L"Loading texture failed!" << std::endl;
 
 		D3D11_SHADER_RESOURCE_VIEW_DESC SRVdesc{};
 		SRVdesc.Format = format;
 		SRVdesc.ViewDimension = D3D11_SRV_DIMENSION_TEXTURE2D;
-		SRVdesc.Texture2D.MipLevels = 1;
+		SRVdesc.Texture2D.MipLevels = data.mipCount;
 
 		hr = pDevice->CreateShaderResourceView(m_pResource, &SRVdesc, &m_pShaderResourceView);
 
@@ -46,45 +56,64 @@ namespace dae
 
 	Texture::~Texture()
 	{
-		if (m_pSurface)
-		{
-			SDL_FreeSurface(m_pSurface);
-			m_pSurface = nullptr;
-		}
-
 		m_pShaderResourceView->Release();
 		m_pResource->Release();
 	}
 
 	std::unique_ptr<Texture> Texture::LoadFromFile(const std::string& path, ID3D11Device* pDevice)
 	{
-		SDL_Surface* pSurface = IMG_Load(path.c_str());
+		TextureData data{};
+		if (!AssetFormat::DecodeImage(path, data))
+		{
+			return nullptr;
+		}
+
+		return Create(data, pDevice);
+	}
 
-		if (pSurface == nullptr)
+	std::unique_ptr<Texture> Texture::Create(const TextureData& data, ID3D11Device* pDevice)
+	{
+		if (data.texels.empty())
 		{
 			return nullptr;
 		}
 
-		return std::unique_ptr<Texture>(new Texture(pSurface, pDevice));
+		return std::make_unique<Texture>(data, pDevice);
+	}
+
+	std::unique_ptr<Texture> Texture::CreateSolid(uint8_t r, uint8_t g, uint8_t b, ID3D11Device* pDevice)
+	{
+		// RGBA8 in memory order, alpha in the high byte
+		const uint32_t texel{ r | (g << 8) | (b << 16) | (255u << 24) };
+		return Create(TextureData{ 1, 1, 1, { texel } }, pDevice);
 	}
 
 	ColorRGB Texture::Sample(const Vector2& uv) const
+	{
+		const uint32_t texel{ GetTexel(uv) };
+		const uint32_t r{ texel & 0xFF };
+		const uint32_t g{ (texel >> 8) & 0xFF };
+		const uint32_t b{ (texel >> 16) & 0xFF };
+		return ColorRGB{ static_cast<float>(r), static_cast<float>(g), static_cast<float>(b) };
+
+	}
+
+	float Texture::SampleAlpha(const Vector2& uv) const
+	{
+		return static_cast<float>(GetTexel(uv) >> 24);
+	}
+
+	uint32_t Texture::GetTexel(const Vector2& uv) const
 	{
 		float x = uv.x > 1.f ? 1.f : uv.x;
 		float y = uv.y > 1.f ? 1.f : uv.y;
 		//return ColorRGB{ x,y,0 };
 		//TODO
 		//Sample the correct texel for the given uv
-		int xPixel{ (int)(x * m_pSurface->w) };
-		int yPixel{ (int)(y * m_pSurface->h) };
-
-		Uint8 r{ 0 };
-		Uint8 g{ 0 };
-		Uint8 b{ 0 };
-
-		SDL_GetRGB(m_pSurfacePixels[xPixel + (yPixel * m_pSurface->w)], m_pSurface->format, &r, &g, &b);
-		return ColorRGB{ static_cast<float>(r), static_cast<float>(g), static_cast<float>(b) };
+		int xPixel{ (int)(x * m_Width) };
+		int yPixel{ (int)(y * m_Height) };
 
+		return m_Texels[xPixel + (yPixel * m_Width)];
 	}
 
 	ID3D11ShaderResourceView* Texture::GetShaderResourceView() const
@@ -1,9 +1,10 @@
 #pragma once
 #include <d3d11.h>
 #include <memory>
-#include <SDL_surface.h>
 #include <string>
+#include <vector>
 #include "ColorRGB.h"
+#include "AssetFormat.h"
 
 namespace dae
 {
@@ -12,20 +13,31 @@ namespace dae
 	class Texture
 	{
 	public:
-		Texture(SDL_Surface* pSurface, ID3D11Device* pDevice);
+		Texture(const TextureData& data, ID3D11Device* pDevice);
 		~Texture();
 
 		static std::unique_ptr<Texture> LoadFromFile(const std::string& path, ID3D11Device* pDevice);
+
+		// Creating touches the device, decoding (AssetFormat) can happen on any thread
+		static std::unique_ptr<Texture> Create(const TextureData& data, ID3D11Device* pDevice);
+
+		// 1x1 texture, used as a placeholder while the real one is streaming in
+		static std::unique_ptr<Texture> CreateSolid(uint8_t r, uint8_t g, uint8_t b, ID3D11Device* pDevice);
 		ColorRGB Sample(const Vector2& uv) const;
+		// In [0, 255] like the colour channels
+		float SampleAlpha(const Vector2& uv) const;
 
 		ID3D11ShaderResourceView* GetShaderResourceView() const;
 
 	private:
+		uint32_t GetTexel(const Vector2& uv) const;
 
 		ID3D11Texture2D* m_pResource;
 		ID3D11ShaderResourceView* m_pShaderResourceView;
 
-		SDL_Surface* m_pSurface;
-		uint32_t* m_pSurfacePixels;
+		// Full size level only, the software rasterizer does not filter
+		uint32_t m_Width;
+		uint32_t m_Height;
+		std::vector<uint32_t> m_Texels;
 	};
 }
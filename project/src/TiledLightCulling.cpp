@@ -0,0 +1,139 @@
+#include "TiledLightCulling.h"
+#include <algorithm>
+#include <cfloat>
+#include <cmath>
+
+namespace dae
+{
+	TiledLightCulling::TiledLightCulling(int width, int height, int tileSize) :
+		m_Width{ width },
+		m_Height{ height },
+		m_TileSize{ tileSize },
+		m_TilesX{ (width + tileSize - 1) / tileSize },
+		m_TilesY{ (height + tileSize - 1) / tileSize },
+		m_DepthRanges(static_cast<size_t>(m_TilesX) * m_TilesY),
+		m_TileOffsets(static_cast<size_t>(m_TilesX) * m_TilesY + 1)
+	{
+		ResetDepthBounds();
+	}
+
+	void TiledLightCulling::ResetDepthBounds()
+	{
+		std::fill(m_DepthRanges.begin(), m_DepthRanges.end(), DepthRange{ FLT_MAX, -FLT_MAX });
+	}
+
+	void TiledLightCulling::AddDepthBounds(int minX, int minY, int maxX, int maxY, float minDepth, float maxDepth)
+	{
+		if (minX >= maxX || minY >= maxY) return;
+
+		const int firstTileX{ std::max(minX, 0) / m_TileSize };
+		const int firstTileY{ std::max(minY, 0) / m_TileSize };
+		const int lastTileX{ (std::min(maxX, m_Width) - 1) / m_TileSize };
+		const int lastTileY{ (std::min(maxY, m_Height) - 1) / m_TileSize };
+
+		for (int tileY{ firstTileY }; tileY <= lastTileY; ++tileY)
+		{
+			for (int tileX{ firstTileX }; tileX <= lastTileX; ++tileX)
+			{
+				DepthRange& range{ m_DepthRanges[tileY * m_TilesX + tileX] };
+				range.min = std::min(range.min, minDepth);
+				range.max = std::max(range.max, maxDepth);
+			}
+		}
+	}
+
+	template<typename Function>
+	void TiledLightCulling::ForEachTile(const Light& light, const Matrix& view, const Matrix& projection, Function&& function) const
+	{
+		int firstTileX{ 0 };
+		int firstTileY{ 0 };
+		int lastTileX{ m_TilesX - 1 };
+		int lastTileY{ m_TilesY - 1 };
+		float nearestDepth{ -FLT_MAX };
+		float farthestDepth{ FLT_MAX };
+
+		if (light.type != LightType::Directional)
+		{
+			// Spot lights are bounded by the sphere of a point light with the same range
+			const Vector3 center{ view.TransformPoint(light.position) };
+			nearestDepth = center.z - light.range;
+			farthestDepth = center.z + light.range;
+			if (farthestDepth <= 0.f) return;
+
+			// A sphere reaching behind the camera can cover any part of the screen
+			if (nearestDepth > 0.f)
+			{
+				// The screen rectangle of the view space box around the sphere
+				float minX{ FLT_MAX }, minY{ FLT_MAX }, maxX{ -FLT_MAX }, maxY{ -FLT_MAX };
+				for (int corner{ 0 }; corner < 8; ++corner)
+				{
+					const Vector3 position{
+						center.x + ((corner & 1) ? light.range : -light.range),
+						center.y + ((corner & 2) ? light.range : -light.range),
+						center.z + ((corner & 4) ? light.range : -light.range) };
+					const Vector4 clip{ projection.TransformPoint(position.ToPoint4()) };
+
+					const float x{ ((clip.x / clip.w + 1) / 2) * m_Width };
+					const float y{ ((1 - clip.y / clip.w) / 2) * m_Height };
+					minX = std::min(minX, x);
+					minY = std::min(minY, y);
+					maxX = std::max(maxX, x);
+					maxY = std::max(maxY, y);
+				}
+
+				if (maxX < 0.f || maxY < 0.f || minX >= m_Width || minY >= m_Height) return;
+
+				firstTileX = static_cast<int>(std::max(minX, 0.f)) / m_TileSize;
+				firstTileY = static_cast<int>(std::max(minY, 0.f)) / m_TileSize;
+				lastTileX = static_cast<int>(std::min(maxX, m_Width - 1.f)) / m_TileSize;
+				lastTileY = static_cast<int>(std::min(maxY, m_Height - 1.f)) / m_TileSize;
+			}
+		}
+
+		for (int tileY{ firstTileY }; tileY <= lastTileY; ++tileY)
+		{
+			for (int tileX{ firstTileX }; tileX <= lastTileX; ++tileX)
+			{
+				const size_t tile{ static_cast<size_t>(tileY) * m_TilesX + tileX };
+				const DepthRange& range{ m_DepthRanges[tile] };
+
+				// Empty tiles fail this as well
+				if (farthestDepth < range.min || nearestDepth > range.max) continue;
+
+				function(tile);
+			}
+		}
+	}
+
+	void TiledLightCulling::CullLights(std::span<const Light> lights, const Matrix& view, const Matrix& projection)
+	{
+		// Counted first, then every tile gets its slice of one shared index list
+		std::vector<uint32_t>& counts{ m_TileOffsets };
+		std::fill(counts.begin(), counts.end(), 0);
+		for (const Light& light : lights)
+		{
+			ForEachTile(light, view, projection, [&counts](size_t tile) { ++counts[tile + 1]; });
+		}
+
+		m_Stats = Stats{ static_cast<uint32_t>(lights.size()), static_cast<uint32_t>(m_DepthRanges.size()) };
+		for (size_t tile{ 1 }; tile < m_TileOffsets.size(); ++tile)
+		{
+			m_Stats.maxTileLights = std::max(m_Stats.maxTileLights, m_TileOffsets[tile]);
+			m_TileOffsets[tile] += m_TileOffsets[tile - 1];
+		}
+		m_Stats.tileLights = m_TileOffsets.back();
+
+		// Filled in light order, so every tile lists its lights in the order they were passed in
+		m_LightIndices.resize(m_TileOffsets.back());
+		std::vector<uint32_t> cursors(m_TileOffsets.begin(), m_TileOffsets.end() - 1);
+		for (uint32_t index{ 0 }; index < lights.size(); ++index)
+		{
+			ForEachTile(lights[index], view, projection, [&](size_t tile) { m_LightIndices[cursors[tile]++] = index; });
+		}
+	}
+
+	const TiledLightCulling::Stats& TiledLightCulling::GetStats() const
+	{
+		return m_Stats;
+	}
+}
@@ -0,0 +1,95 @@
+#pragma once
+#include <vector>
+#include <span>
+#include <cstdint>
+#include "DataTypes.h"
+
+namespace dae
+{
+	enum class LightType
+	{
+		Directional,
+		Point,
+		Spot
+	};
+
+	// World space light for the software shading
+	struct Light
+	{
+		LightType type{ LightType::Directional };
+		Vector3 position{};				// point and spot
+		Vector3 direction{ 0.f, 0.f, 1.f };	// the way the light shines, directional and spot
+		ColorRGB color{ 1.f, 1.f, 1.f };
+		float intensity{ 1.f };
+		bool castsShadows{ false };		// only the sun, the first light, has a shadow map
+		float range{};					// point and spot, nothing is lit past it
+		float cosInnerCone{};			// spot, full intensity inside
+		float cosOuterCone{};			// spot, no light outside
+	};
+
+	// Splits the screen into tiles and lists for every tile the lights that can reach the geometry in it.
+	// Each frame the tile depth ranges are collected first, then CullLights tests the bounding sphere of
+	// every point and spot light against the tiles under its screen rectangle and their depth range.
+	// Directional lights reach everything and are listed in every tile holding geometry.
+	class TiledLightCulling final
+	{
+	public:
+		struct Stats
+		{
+			uint32_t lights{};
+			uint32_t tiles{};
+			uint32_t tileLights{};		// summed over all tiles
+			uint32_t maxTileLights{};
+		};
+
+		TiledLightCulling(int width, int height, int tileSize = 16);
+		~TiledLightCulling() = default;
+
+		TiledLightCulling(const TiledLightCulling&) = delete;
+		TiledLightCulling(TiledLightCulling&&) noexcept = delete;
+		TiledLightCulling& operator=(const TiledLightCulling&) = delete;
+		TiledLightCulling& operator=(TiledLightCulling&&) noexcept = delete;
+
+		// Starts a frame, all tiles are empty
+		void ResetDepthBounds();
+		// Widens the view depth range of the tiles under the pixel rectangle [minX, maxX) x [minY, maxY)
+		void AddDepthBounds(int minX, int minY, int maxX, int maxY, float minDepth, float maxDepth);
+
+		void CullLights(std::span<const Light> lights, const Matrix& view, const Matrix& projection);
+
+		// Indices into the light span passed to CullLights
+		std::span<const uint32_t> GetLights(int px, int py) const
+		{
+			const size_t tile{ static_cast<size_t>(py / m_TileSize) * m_TilesX + px / m_TileSize };
+			return { m_LightIndices.data() + m_TileOffsets[tile], m_TileOffsets[tile + 1] - m_TileOffsets[tile] };
+		}
+
+		const Stats& GetStats() const;
+
+	private:
+		struct DepthRange
+		{
+			float min{};
+			float max{};
+		};
+
+		// Calls function(tile) for every tile the light can reach
+		template<typename Function>
+		void ForEachTile(const Light& light, const Matrix& view, const Matrix& projection, Function&& function) const;
+
+		const int m_Width;
+		const int m_Height;
+		const int m_TileSize;
+		const int m_TilesX;
+		const int m_TilesY;
+
+		// View space depth, min > max while no geometry covers the tile
+		std::vector<DepthRange> m_DepthRanges{};
+
+		// Lights of tile t are m_LightIndices[m_TileOffsets[t], m_TileOffsets[t + 1])
+		std::vector<uint32_t> m_TileOffsets{};
+		std::vector<uint32_t> m_LightIndices{};
+
+		Stats m_Stats{};
+	};
+}
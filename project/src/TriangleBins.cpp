@@ -0,0 +1,128 @@
+#include "TriangleBins.h"
+#include <algorithm>
+#include <cfloat>
+#include <array>
+
+namespace dae
+{
+	// One counting pass of the LSD radix sort on 8 bits of the key, stable so the lower byte keeps its order
+	template<typename Entry>
+	static void RadixPass(const std::vector<Entry>& source, std::vector<Entry>& destination, int shift)
+	{
+		std::array<uint32_t, 256> offsets{};
+		for (const Entry& entry : source)
+		{
+			++offsets[(entry.key >> shift) & 0xFF];
+		}
+
+		uint32_t total{ 0 };
+		for (uint32_t& offset : offsets)
+		{
+			const uint32_t count{ offset };
+			offset = total;
+			total += count;
+		}
+
+		for (const Entry& entry : source)
+		{
+			destination[offsets[(entry.key >> shift) & 0xFF]++] = entry;
+		}
+	}
+
+	TriangleBins::TriangleBins(int width, int height, int tileSize) :
+		m_Width{ width },
+		m_Height{ height },
+		m_TileSize{ tileSize },
+		m_TilesX{ (width + tileSize - 1) / tileSize },
+		m_TilesY{ (height + tileSize - 1) / tileSize },
+		m_TileOffsets(static_cast<size_t>(m_TilesX) * m_TilesY + 1)
+	{
+	}
+
+	void TriangleBins::Clear()
+	{
+		m_Entries.clear();
+	}
+
+	void TriangleBins::Add(const Reference& reference, const PixelRect& bounds, float depth)
+	{
+		const int minX{ std::max(bounds.minX, 0) };
+		const int minY{ std::max(bounds.minY, 0) };
+		const int maxX{ std::min(bounds.maxX, m_Width) };
+		const int maxY{ std::min(bounds.maxY, m_Height) };
+		if (minX >= maxX || minY >= maxY) return;
+
+		Entry entry{};
+		entry.reference = reference;
+		entry.depth = depth;
+		entry.firstTileX = static_cast<uint16_t>(minX / m_TileSize);
+		entry.firstTileY = static_cast<uint16_t>(minY / m_TileSize);
+		entry.lastTileX = static_cast<uint16_t>((maxX - 1) / m_TileSize);
+		entry.lastTileY = static_cast<uint16_t>((maxY - 1) / m_TileSize);
+		m_Entries.push_back(entry);
+	}
+
+	void TriangleBins::Sort()
+	{
+		// 16 bits spread over this frame's depth range is plenty to order triangles, exact order is not needed
+		float nearest{ FLT_MAX };
+		float farthest{ -FLT_MAX };
+		for (const Entry& entry : m_Entries)
+		{
+			nearest = std::min(nearest, entry.depth);
+			farthest = std::max(farthest, entry.depth);
+		}
+
+		const float scale{ farthest > nearest ? 65535.f / (farthest - nearest) : 0.f };
+		for (Entry& entry : m_Entries)
+		{
+			entry.key = static_cast<uint16_t>((entry.depth - nearest) * scale);
+		}
+
+		m_Scratch.resize(m_Entries.size());
+		RadixPass(m_Entries, m_Scratch, 0);
+		RadixPass(m_Scratch, m_Entries, 8);
+
+		// Count per tile, then deal the sorted triangles out so every tile list stays nearest first
+		std::fill(m_TileOffsets.begin(), m_TileOffsets.end(), 0);
+		for (const Entry& entry : m_Entries)
+		{
+			for (int tileY{ entry.firstTileY }; tileY <= entry.lastTileY; ++tileY)
+			{
+				for (int tileX{ entry.firstTileX }; tileX <= entry.lastTileX; ++tileX)
+				{
+					++m_TileOffsets[tileY * m_TilesX + tileX + 1];
+				}
+			}
+		}
+
+		for (size_t tile{ 1 }; tile < m_TileOffsets.size(); ++tile)
+		{
+			m_TileOffsets[tile] += m_TileOffsets[tile - 1];
+		}
+
+		m_Binned.resize(m_TileOffsets.back());
+		m_TileCursors.assign(m_TileOffsets.begin(), m_TileOffsets.end() - 1);
+		for (const Entry& entry : m_Entries)
+		{
+			for (int tileY{ entry.firstTileY }; tileY <= entry.lastTileY; ++tileY)
+			{
+				for (int tileX{ entry.firstTileX }; tileX <= entry.lastTileX; ++tileX)
+				{
+					m_Binned[m_TileCursors[tileY * m_TilesX + tileX]++] = entry.reference;
+				}
+			}
+		}
+	}
+
+	PixelRect TriangleBins::GetTileRect(size_t tile) const
+	{
+		const int tileX{ static_cast<int>(tile % m_TilesX) };
+		const int tileY{ static_cast<int>(tile / m_TilesX) };
+		return {
+			tileX * m_TileSize,
+			tileY * m_TileSize,
+			std::min((tileX + 1) * m_TileSize, m_Width),
+			std::min((tileY + 1) * m_TileSize, m_Height) };
+	}
+}
@@ -0,0 +1,70 @@
+#pragma once
+#include <vector>
+#include <span>
+#include <cstdint>
+#include "DataTypes.h"
+
+namespace dae
+{
+	// Screen tiles listing the triangles that overlap them, nearest first. The triangles of the frame
+	// are radix sorted once on their quantized nearest depth and then dealt out to the tiles in that
+	// order, so every tile is drawn front to back and no two threads ever write the same pixel.
+	class TriangleBins final
+	{
+	public:
+		// Which triangle of which batch
+		struct Reference
+		{
+			uint32_t batch{};
+			uint32_t triangle{};
+		};
+
+		TriangleBins(int width, int height, int tileSize = 64);
+		~TriangleBins() = default;
+
+		TriangleBins(const TriangleBins&) = delete;
+		TriangleBins(TriangleBins&&) noexcept = delete;
+		TriangleBins& operator=(const TriangleBins&) = delete;
+		TriangleBins& operator=(TriangleBins&&) noexcept = delete;
+
+		// Starts a frame without any triangles
+		void Clear();
+		// bounds are the pixels the triangle can touch, depth its nearest view depth
+		void Add(const Reference& reference, const PixelRect& bounds, float depth);
+		// Sorts everything added since Clear and fills the tiles
+		void Sort();
+
+		size_t GetTileCount() const { return m_TileOffsets.size() - 1; }
+		PixelRect GetTileRect(size_t tile) const;
+		std::span<const Reference> GetTriangles(size_t tile) const
+		{
+			return { m_Binned.data() + m_TileOffsets[tile], m_TileOffsets[tile + 1] - m_TileOffsets[tile] };
+		}
+
+	private:
+		struct Entry
+		{
+			Reference reference{};
+			float depth{};
+			uint16_t key{};
+			uint16_t firstTileX{};
+			uint16_t firstTileY{};
+			uint16_t lastTileX{};
+			uint16_t lastTileY{};
+		};
+
+		const int m_Width;
+		const int m_Height;
+		const int m_TileSize;
+		const int m_TilesX;
+		const int m_TilesY;
+
+		std::vector<Entry> m_Entries{};
+		std::vector<Entry> m_Scratch{};
+
+		// Triangles of tile t are m_Binned[m_TileOffsets[t], m_TileOffsets[t + 1])
+		std::vector<uint32_t> m_TileOffsets{};
+		std::vector<Reference> m_Binned{};
+		std::vector<uint32_t> m_TileCursors{};
+	};
+}
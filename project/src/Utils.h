@@ -1,7 +1,10 @@
 #pragma once
 #include <fstream>
+#include <sstream>
+#include <filesystem>
 #include "Math.h"
 #include "DataTypes.h"
+#include "AssetFormat.h"
 
 
 
@@ -9,10 +12,65 @@ namespace dae
 {
 	namespace Utils
 	{
-		//Just parses vertices and indices
 #pragma warning(push)
 #pragma warning(disable : 4505) //Warning unreferenced local function
-		static bool ParseOBJ(const std::string& filename, std::vector<Vertex_In>& vertices, std::vector<uint32_t>& indices, bool flipAxisAndWinding = true)
+		//Appends the materials of an MTL file, map paths are resolved relative to the file
+		static bool ParseMTL(const std::string& filename, std::vector<MaterialDesc>& materials)
+		{
+			std::ifstream file(filename);
+			if (!file)
+				return false;
+
+			const std::filesystem::path directory{ std::filesystem::path{ filename }.parent_path() };
+
+			std::string line;
+			while (std::getline(file, line))
+			{
+				std::istringstream stream{ line };
+				std::string sCommand;
+				stream >> sCommand;
+
+				// Map options (-bm, -s, ...) come before the file name, which is always the last word
+				std::string mapPath;
+				for (std::string word; stream >> word;)
+				{
+					mapPath = word;
+				}
+
+				if (sCommand == "newmtl")
+				{
+					materials.push_back(MaterialDesc{ mapPath });
+					continue;
+				}
+
+				if (materials.empty() || mapPath.empty())
+					continue;
+
+				const std::string path{ (directory / mapPath).generic_string() };
+				if (sCommand == "map_Kd")
+				{
+					materials.back().diffuseMap = path;
+				}
+				else if (sCommand == "map_Bump" || sCommand == "map_bump" || sCommand == "bump" || sCommand == "norm")
+				{
+					materials.back().normalMap = path;
+				}
+				else if (sCommand == "map_Ks")
+				{
+					materials.back().specularMap = path;
+				}
+				else if (sCommand == "map_Ns")
+				{
+					materials.back().glossinessMap = path;
+				}
+			}
+
+			return true;
+		}
+
+		//Parses vertices and indices, plus the material of every vertex (usemtl) and the referenced MTL files (mtllib)
+		static bool ParseOBJ(const std::string& filename, std::vector<Vertex_In>& vertices, std::vector<uint32_t>& indices,
+			std::vector<uint32_t>& vertexMaterials, std::vector<MaterialDesc>& materials, bool flipAxisAndWinding = true)
 		{
 			std::ifstream file(filename);
 			if (!file)
@@ -24,6 +82,11 @@ namespace dae
 
 			vertices.clear();
 			indices.clear();
+			vertexMaterials.clear();
+			materials.clear();
+
+			const std::filesystem::path directory{ std::filesystem::path{ filename }.parent_path() };
+			uint32_t currentMaterial{ UINT32_MAX };
 
 			std::string sCommand;
 			// start a while iteration ending when the end of file is reached (ios::eof)
@@ -59,8 +122,44 @@ namespace dae
 
 					normals.emplace_back(x, y, z);
 				}
+				else if (sCommand == "mtllib")
+				{
+					// Rest of the line lists the files, the newline is consumed here
+					std::string line;
+					std::getline(file, line);
+					std::istringstream libraries{ line };
+					for (std::string library; libraries >> library;)
+					{
+						ParseMTL((directory / library).generic_string(), materials);
+					}
+					continue;
+				}
+				else if (sCommand == "usemtl")
+				{
+					std::string name;
+					file >> name;
+
+					const auto material{ std::find_if(materials.begin(), materials.end(), [&name](const MaterialDesc& desc) { return desc.name == name; }) };
+					currentMaterial = static_cast<uint32_t>(material - materials.begin());
+					if (material == materials.end())
+					{
+						// Unknown to the MTL files, still its own batch, drawn with placeholders
+						materials.push_back(MaterialDesc{ name });
+					}
+				}
+				else if (sCommand == "o" || sCommand == "g")
+				{
+					// Objects and groups do not split anything, draws are batched per material
+				}
 				else if (sCommand == "f")
 				{
+					// Faces before the first usemtl get a default material
+					if (currentMaterial == UINT32_MAX)
+					{
+						currentMaterial = static_cast<uint32_t>(materials.size());
+						materials.push_back(MaterialDesc{});
+					}
+
 					//if a face is read:
 					//construct the 3 vertices, add them to the vertex array
 					//add three indices to the index array
@@ -99,6 +198,7 @@ namespace dae
 						}
 
 						vertices.push_back(vertex);
+						vertexMaterials.push_back(currentMaterial);
 						tempIndices[iFace] = uint32_t(vertices.size()) - 1;
 						//indices.push_back(uint32_t(vertices.size()) - 1);
 					}
@@ -119,44 +219,14 @@ namespace dae
 				file.ignore(1000, '\n');
 			}
 
-			//Cheap Tangent Calculations
-			for (uint32_t i = 0; i < indices.size(); i += 3)
-			{
-				uint32_t index0 = indices[i];
-				uint32_t index1 = indices[size_t(i) + 1];
-				uint32_t index2 = indices[size_t(i) + 2];
-
-				const Vector3& p0 = vertices[index0].position;
-				const Vector3& p1 = vertices[index1].position;
-				const Vector3& p2 = vertices[index2].position;
-				const Vector2& uv0 = vertices[index0].uv;
-				const Vector2& uv1 = vertices[index1].uv;
-				const Vector2& uv2 = vertices[index2].uv;
-
-				const Vector3 edge0 = p1 - p0;
-				const Vector3 edge1 = p2 - p0;
-				const Vector2 diffX = Vector2(uv1.x - uv0.x, uv2.x - uv0.x);
-				const Vector2 diffY = Vector2(uv1.y - uv0.y, uv2.y - uv0.y);
-				float r = 1.f / Vector2::Cross(diffX, diffY);
-
-				Vector3 tangent = (edge0 * diffY.y - edge1 * diffY.x) * r;
-				vertices[index0].tangent += tangent;
-				vertices[index1].tangent += tangent;
-				vertices[index2].tangent += tangent;
-			}
-
-			//Create the Tangents (reject)
-			for (auto& v : vertices)
+			// Tangents are left to TangentSpace::Generate, it needs the welded mesh
+			if (flipAxisAndWinding)
 			{
-				v.tangent = Vector3::Reject(v.tangent, v.normal).Normalized();
-
-				if(flipAxisAndWinding)
+				for (auto& v : vertices)
 				{
 					v.position.z *= -1.f;
 					v.normal.z *= -1.f;
-					v.tangent.z *= -1.f;
 				}
-
 			}
 
 			return true;
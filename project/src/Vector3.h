@@ -1,9 +1,14 @@
 #pragma once
+#include <cassert>
+#include <cmath>
+#include "Vector2.h"
 
 namespace dae
 {
-	struct Vector2;
 	struct Vector4;
+
+	// Header only so the per-pixel loops can inline it, the members that need
+	// Vector4 are defined at the end of Vector4.h
 	struct Vector3
 	{
 		float x{};
@@ -11,39 +16,148 @@ namespace dae
 		float z{};
 
 		Vector3() = default;
-		Vector3(float _x, float _y, float _z);
-		Vector3(const Vector3& from, const Vector3& to);
-		Vector3(const Vector4& v);
+		constexpr Vector3(float _x, float _y, float _z) : x(_x), y(_y), z(_z) {}
+		constexpr Vector3(const Vector3& from, const Vector3& to) : x(to.x - from.x), y(to.y - from.y), z(to.z - from.z) {}
+		constexpr Vector3(const Vector4& v);
+
+		float Magnitude() const
+		{
+			return std::sqrt(x * x + y * y + z * z);
+		}
+
+		constexpr float SqrMagnitude() const
+		{
+			return x * x + y * y + z * z;
+		}
+
+		float Normalize()
+		{
+			const float m = Magnitude();
+			x /= m;
+			y /= m;
+			z /= m;
+
+			return m;
+		}
+
+		Vector3 Normalized() const
+		{
+			const float m = Magnitude();
+			return { x / m, y / m, z / m };
+		}
 
-		float Magnitude() const;
-		float SqrMagnitude() const;
-		float Normalize();
-		Vector3 Normalized() const;
+		static constexpr float Dot(const Vector3& v1, const Vector3& v2)
+		{
+			return v1.x * v2.x + v1.y * v2.y + v1.z * v2.z;
+		}
 
-		static float Dot(const Vector3& v1, const Vector3& v2);
-		static Vector3 Cross(const Vector3& v1, const Vector3& v2);
-		static Vector3 Project(const Vector3& v1, const Vector3& v2);
-		static Vector3 Reject(const Vector3& v1, const Vector3& v2);
-		static Vector3 Reflect(const Vector3& v1, const Vector3& v2);
+		static constexpr Vector3 Cross(const Vector3& v1, const Vector3& v2)
+		{
+			return Vector3{
+				v1.y * v2.z - v1.z * v2.y,
+				v1.z * v2.x - v1.x * v2.z,
+				v1.x * v2.y - v1.y * v2.x
+			};
+		}
 
-		Vector4 ToPoint4() const;
-		Vector4 ToVector4() const;
+		static constexpr Vector3 Project(const Vector3& v1, const Vector3& v2)
+		{
+			return (v2 * (Dot(v1, v2) / Dot(v2, v2)));
+		}
 
-		Vector2 GetXY() const;
+		static constexpr Vector3 Reject(const Vector3& v1, const Vector3& v2)
+		{
+			return (v1 - v2 * (Dot(v1, v2) / Dot(v2, v2)));
+		}
+
+		static constexpr Vector3 Reflect(const Vector3& v1, const Vector3& v2)
+		{
+			return v1 - v2 * (2.f * Dot(v1, v2));
+		}
+
+		constexpr Vector4 ToPoint4() const;
+		constexpr Vector4 ToVector4() const;
+
+		constexpr Vector2 GetXY() const
+		{
+			return { x, y };
+		}
 
 		//Member Operators
-		Vector3 operator*(float scale) const;
-		Vector3 operator/(float scale) const;
-		Vector3 operator+(const Vector3& v) const;
-		Vector3 operator-(const Vector3& v) const;
-		Vector3 operator-() const;
-		//Vector3& operator-();
-		Vector3& operator+=(const Vector3& v);
-		Vector3& operator-=(const Vector3& v);
-		Vector3& operator/=(float scale);
-		Vector3& operator*=(float scale);
-		float& operator[](int index);
-		float operator[](int index) const;
+		constexpr Vector3 operator*(float scale) const
+		{
+			return { x * scale, y * scale, z * scale };
+		}
+
+		constexpr Vector3 operator/(float scale) const
+		{
+			return { x / scale, y / scale, z / scale };
+		}
+
+		constexpr Vector3 operator+(const Vector3& v) const
+		{
+			return { x + v.x, y + v.y, z + v.z };
+		}
+
+		constexpr Vector3 operator-(const Vector3& v) const
+		{
+			return { x - v.x, y - v.y, z - v.z };
+		}
+
+		constexpr Vector3 operator-() const
+		{
+			return { -x ,-y,-z };
+		}
+
+		constexpr Vector3& operator+=(const Vector3& v)
+		{
+			x += v.x;
+			y += v.y;
+			z += v.z;
+			return *this;
+		}
+
+		constexpr Vector3& operator-=(const Vector3& v)
+		{
+			x -= v.x;
+			y -= v.y;
+			z -= v.z;
+			return *this;
+		}
+
+		constexpr Vector3& operator/=(float scale)
+		{
+			x /= scale;
+			y /= scale;
+			z /= scale;
+			return *this;
+		}
+
+		constexpr Vector3& operator*=(float scale)
+		{
+			x *= scale;
+			y *= scale;
+			z *= scale;
+			return *this;
+		}
+
+		constexpr float& operator[](int index)
+		{
+			assert(index <= 2 && index >= 0);
+
+			if (index == 0) return x;
+			if (index == 1) return y;
+			return z;
+		}
+
+		constexpr float operator[](int index) const
+		{
+			assert(index <= 2 && index >= 0);
+
+			if (index == 0) return x;
+			if (index == 1) return y;
+			return z;
+		}
 
 		static const Vector3 UnitX;
 		static const Vector3 UnitY;
@@ -51,9 +165,17 @@ namespace dae
 		static const Vector3 Zero;
 	};
 
+	inline constexpr Vector3 Vector3::UnitX{ 1, 0, 0 };
+	inline constexpr Vector3 Vector3::UnitY{ 0, 1, 0 };
+	inline constexpr Vector3 Vector3::UnitZ{ 0, 0, 1 };
+	inline constexpr Vector3 Vector3::Zero{ 0, 0, 0 };
+
 	//Global Operators
-	inline Vector3 operator*(float scale, const Vector3& v)
+	constexpr Vector3 operator*(float scale, const Vector3& v)
 	{
 		return { v.x * scale, v.y * scale, v.z * scale };
 	}
 }
+
+// Completes the Vector3 members above, whichever of the two headers is included first
+#include "Vector4.h"
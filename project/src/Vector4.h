@@ -1,10 +1,16 @@
 #pragma once
+#include <cassert>
+#include <cmath>
+#include <type_traits>
+#include "MathHelpers.h"
+#include "Vector2.h"
+#include "Vector3.h"
 
 namespace dae
 {
-	struct Vector2;
-	struct Vector3;
-	struct Vector4
+	// 16 byte aligned so it loads straight into an SSE register. Every operation has a scalar
+	// path as well, taken in constant expressions and in DAE_MATH_SCALAR builds.
+	struct alignas(16) Vector4
 	{
 		float x;
 		float y;
@@ -12,25 +18,136 @@ namespace dae
 		float w;
 
 		Vector4() = default;
-		Vector4(float _x, float _y, float _z, float _w);
-		Vector4(const Vector3& v, float _w);
+		constexpr Vector4(float _x, float _y, float _z, float _w) : x(_x), y(_y), z(_z), w(_w) {}
+		constexpr Vector4(const Vector3& v, float _w) : x(v.x), y(v.y), z(v.z), w(_w) {}
 
-		float Magnitude() const;
-		float SqrMagnitude() const;
-		float Normalize();
-		Vector4 Normalized() const;
+#if DAE_MATH_SSE
+		explicit Vector4(__m128 v)
+		{
+			_mm_store_ps(&x, v);
+		}
 
-		Vector2 GetXY() const;
-		Vector3 GetXYZ() const;
+		__m128 Load() const
+		{
+			return _mm_load_ps(&x);
+		}
+#endif
 
-		static float Dot(const Vector4& v1, const Vector4& v2);
+		float Magnitude() const
+		{
+			return std::sqrt(SqrMagnitude());
+		}
+
+		constexpr float SqrMagnitude() const
+		{
+			return Dot(*this, *this);
+		}
+
+		float Normalize()
+		{
+			const float m = Magnitude();
+			x /= m;
+			y /= m;
+			z /= m;
+			w /= m;
+
+			return m;
+		}
+
+		Vector4 Normalized() const
+		{
+			const float m = Magnitude();
+			return { x / m, y / m, z / m, w / m };
+		}
+
+		constexpr Vector2 GetXY() const
+		{
+			return { x, y };
+		}
+
+		constexpr Vector3 GetXYZ() const
+		{
+			return { x, y, z };
+		}
+
+		static constexpr float Dot(const Vector4& v1, const Vector4& v2)
+		{
+#if DAE_MATH_SSE
+			if (!std::is_constant_evaluated())
+			{
+				const __m128 product{ _mm_mul_ps(v1.Load(), v2.Load()) };
+				const __m128 pairs{ _mm_add_ps(product, _mm_movehl_ps(product, product)) };
+				return _mm_cvtss_f32(_mm_add_ss(pairs, _mm_shuffle_ps(pairs, pairs, _MM_SHUFFLE(1, 1, 1, 1))));
+			}
+#endif
+			return v1.x * v2.x + v1.y * v2.y + v1.z * v2.z + v1.w * v2.w;
+		}
 
 		// operator overloading
-		Vector4 operator*(float scale) const;
-		Vector4 operator+(const Vector4& v) const;
-		Vector4 operator-(const Vector4& v) const;
-		Vector4& operator+=(const Vector4& v);
-		float& operator[](int index);
-		float operator[](int index) const;
+		constexpr Vector4 operator*(float scale) const
+		{
+#if DAE_MATH_SSE
+			if (!std::is_constant_evaluated())
+				return Vector4{ _mm_mul_ps(Load(), _mm_set1_ps(scale)) };
+#endif
+			return { x * scale, y * scale, z * scale, w * scale };
+		}
+
+		constexpr Vector4 operator+(const Vector4& v) const
+		{
+#if DAE_MATH_SSE
+			if (!std::is_constant_evaluated())
+				return Vector4{ _mm_add_ps(Load(), v.Load()) };
+#endif
+			return { x + v.x, y + v.y, z + v.z, w + v.w };
+		}
+
+		constexpr Vector4 operator-(const Vector4& v) const
+		{
+#if DAE_MATH_SSE
+			if (!std::is_constant_evaluated())
+				return Vector4{ _mm_sub_ps(Load(), v.Load()) };
+#endif
+			return { x - v.x, y - v.y, z - v.z, w - v.w };
+		}
+
+		constexpr Vector4& operator+=(const Vector4& v)
+		{
+			*this = *this + v;
+			return *this;
+		}
+
+		constexpr float& operator[](int index)
+		{
+			assert(index <= 3 && index >= 0);
+
+			if (index == 0)return x;
+			if (index == 1)return y;
+			if (index == 2)return z;
+			return w;
+		}
+
+		constexpr float operator[](int index) const
+		{
+			assert(index <= 3 && index >= 0);
+
+			if (index == 0)return x;
+			if (index == 1)return y;
+			if (index == 2)return z;
+			return w;
+		}
 	};
+
+	// Vector3 members that need the complete Vector4
+	constexpr Vector3::Vector3(const Vector4& v) : x(v.x), y(v.y), z(v.z) {}
+
+	constexpr Vector4 Vector3::ToPoint4() const
+	{
+		return { x, y, z, 1 };
+	}
+
+	constexpr Vector4 Vector3::ToVector4() const
+	{
+		return { x, y, z, 0 };
+	}
 }
@@ -0,0 +1,87 @@
+#include "VertexCompression.h"
+
+namespace dae
+{
+	namespace
+	{
+		uint16_t ToUnorm16(float value, float offset, float scale)
+		{
+			if (scale <= 0.f)
+				return 0;
+
+			const float normalized{ std::clamp((value - offset) / scale, 0.f, 1.f) };
+			return static_cast<uint16_t>(std::lround(normalized * 65535.f));
+		}
+
+		int16_t ToSnorm16(float value)
+		{
+			return static_cast<int16_t>(std::lround(std::clamp(value, -1.f, 1.f) * 32767.f));
+		}
+	}
+
+	VertexQuantization VertexCompression::GetQuantization(const BoundingBox& bounds)
+	{
+		return VertexQuantization{ bounds.min, bounds.max - bounds.min };
+	}
+
+	void VertexCompression::Encode(const std::vector<Vertex_In>& vertices, const VertexQuantization& quantization, std::vector<Vertex_Compact>& compactVertices)
+	{
+		compactVertices.resize(vertices.size());
+		for (size_t index{ 0 }; index < vertices.size(); ++index)
+		{
+			const Vertex_In& vertex{ vertices[index] };
+			Vertex_Compact& compact{ compactVertices[index] };
+
+			compact.position[0] = ToUnorm16(vertex.position.x, quantization.offset.x, quantization.scale.x);
+			compact.position[1] = ToUnorm16(vertex.position.y, quantization.offset.y, quantization.scale.y);
+			compact.position[2] = ToUnorm16(vertex.position.z, quantization.offset.z, quantization.scale.z);
+			compact.position[3] = vertex.tangentSign < 0.f ? 0 : 65535;
+
+			compact.uv[0] = FloatToHalf(vertex.uv.x);
+			compact.uv[1] = FloatToHalf(vertex.uv.y);
+
+			const Vector2 normal{ OctEncode(vertex.normal) };
+			compact.normal[0] = ToSnorm16(normal.x);
+			compact.normal[1] = ToSnorm16(normal.y);
+
+			const Vector2 tangent{ OctEncode(vertex.tangent) };
+			compact.tangent[0] = ToSnorm16(tangent.x);
+			compact.tangent[1] = ToSnorm16(tangent.y);
+		}
+	}
+
+	uint16_t VertexCompression::FloatToHalf(float value)
+	{
+		uint32_t bits{};
+		std::memcpy(&bits, &value, sizeof(float));
+
+		const uint32_t sign{ (bits >> 16) & 0x8000 };
+		const int32_t exponent{ static_cast<int32_t>((bits >> 23) & 0xFF) - 112 };
+		const uint32_t mantissa{ bits & 0x7FFFFF };
+
+		// Too small for a normal half flushes to zero, too large (or inf/nan) saturates to infinity
+		if (exponent <= 0) return static_cast<uint16_t>(sign);
+		if (exponent >= 31) return static_cast<uint16_t>(sign | 0x7C00);
+
+		// Round to nearest, a mantissa carry correctly bumps the exponent
+		uint32_t half{ sign | (static_cast<uint32_t>(exponent) << 10) | (mantissa >> 13) };
+		half += (mantissa >> 12) & 1;
+		return static_cast<uint16_t>(half);
+	}
+
+	Vector2 VertexCompression::OctEncode(const Vector3& normal)
+	{
+		const float length{ std::abs(normal.x) + std::abs(normal.y) + std::abs(normal.z) };
+		if (length <= 0.f)
+			return Vector2{ 0.f, 0.f };
+
+		Vector2 encoded{ normal.x / length, normal.y / length };
+		if (normal.z < 0.f)
+		{
+			encoded = Vector2{
+				(1.f - std::abs(encoded.y)) * (encoded.x >= 0.f ? 1.f : -1.f),
+				(1.f - std::abs(encoded.x)) * (encoded.y >= 0.f ? 1.f : -1.f) };
+		}
+		return encoded;
+	}
+}
@@ -0,0 +1,65 @@
+#pragma once
+#include <vector>
+#include <cstdint>
+#include <cstring>
+#include <cmath>
+#include <algorithm>
+#include "DataTypes.h"
+
+namespace dae
+{
+	// Vertex_In <-> Vertex_Compact. Encoding happens once at load, decoding is inline so the
+	// software vertex stage can fuse it with the transform (the shaders decode the same way).
+	namespace VertexCompression
+	{
+		VertexQuantization GetQuantization(const BoundingBox& bounds);
+		void Encode(const std::vector<Vertex_In>& vertices, const VertexQuantization& quantization, std::vector<Vertex_Compact>& compactVertices);
+
+		uint16_t FloatToHalf(float value);
+		Vector2 OctEncode(const Vector3& normal);
+
+		inline float HalfToFloat(uint16_t half)
+		{
+			const uint32_t sign{ static_cast<uint32_t>(half & 0x8000) << 16 };
+			const uint32_t exponent{ static_cast<uint32_t>(half >> 10) & 0x1F };
+			const uint32_t mantissa{ static_cast<uint32_t>(half & 0x3FF) };
+
+			// Encoding never produces denormals, so exponent 0 is always a (signed) zero
+			uint32_t bits{ sign };
+			if (exponent == 31) bits |= 0x7F800000 | (mantissa << 13);
+			else if (exponent != 0) bits |= ((exponent + 112) << 23) | (mantissa << 13);
+
+			float value{};
+			std::memcpy(&value, &bits, sizeof(float));
+			return value;
+		}
+
+		inline Vector3 OctDecode(int16_t x, int16_t y)
+		{
+			Vector3 normal{ std::max(x / 32767.f, -1.f), std::max(y / 32767.f, -1.f), 0.f };
+			normal.z = 1.f - std::abs(normal.x) - std::abs(normal.y);
+
+			// Fold the lower hemisphere back out of the corners
+			const float fold{ std::max(-normal.z, 0.f) };
+			normal.x += normal.x >= 0.f ? -fold : fold;
+			normal.y += normal.y >= 0.f ? -fold : fold;
+			return normal.Normalized();
+		}
+
+		inline Vertex_In Decode(const Vertex_Compact& vertex, const VertexQuantization& quantization)
+		{
+			constexpr float unorm{ 1.f / 65535.f };
+
+			Vertex_In decoded{};
+			decoded.position = {
+				quantization.offset.x + vertex.position[0] * unorm * quantization.scale.x,
+				quantization.offset.y + vertex.position[1] * unorm * quantization.scale.y,
+				quantization.offset.z + vertex.position[2] * unorm * quantization.scale.z };
+			decoded.uv = { HalfToFloat(vertex.uv[0]), HalfToFloat(vertex.uv[1]) };
+			decoded.normal = OctDecode(vertex.normal[0], vertex.normal[1]);
+			decoded.tangent = OctDecode(vertex.tangent[0], vertex.tangent[1]);
+			decoded.tangentSign = vertex.position[3] < 32768 ? -1.f : 1.f;
+			return decoded;
+		}
+	}
+}
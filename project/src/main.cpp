@@ -96,6 +96,46 @@ int main(int argc, char* args[])
 				{
 					pRenderer->ToggleBoundingBox();
 				}
+				else if (e.key.keysym.scancode == SDL_SCANCODE_F12)
+				{
+					pRenderer->ToggleClusteredMesh();
+				}
+				else if (e.key.keysym.scancode == SDL_SCANCODE_I)
+				{
+					pRenderer->ToggleVehicleFleet();
+				}
+				else if (e.key.keysym.scancode == SDL_SCANCODE_O)
+				{
+					pRenderer->ToggleOcclusionCulling();
+				}
+				else if (e.key.keysym.scancode == SDL_SCANCODE_P)
+				{
+					pRenderer->ToggleSpecularPower();
+				}
+				else if (e.key.keysym.scancode == SDL_SCANCODE_B)
+				{
+					pRenderer->BenchmarkSpecularPower();
+				}
+				else if (e.key.keysym.scancode == SDL_SCANCODE_L)
+				{
+					pRenderer->TogglePointLights();
+				}
+				else if (e.key.keysym.scancode == SDL_SCANCODE_H)
+				{
+					pRenderer->ToggleShadows();
+				}
+				else if (e.key.keysym.scancode == SDL_SCANCODE_Z)
+				{
+					pRenderer->ToggleDepthPrepass();
+				}
+				else if (e.key.keysym.scancode == SDL_SCANCODE_F)
+				{
+					pRenderer->ToggleFrontToBack();
+				}
+				else if (e.key.keysym.scancode == SDL_SCANCODE_G)
+				{
+					pRenderer->CycleShadingTier();
+				}
 				else if (e.key.keysym.scancode == SDL_SCANCODE_F10)
 				{
 					pRenderer->ToggleUniformClearColor();
@@ -0,0 +1,42 @@
+// Checks SpecularLut against std::pow over every gloss level of an 8 bit gloss map and a fine sweep of
+// cosines, the lookup has to stay within one 8 bit colour step everywhere. Exits with 1 when it does not.
+
+#include <cmath>
+#include <iostream>
+#include "SpecularPower.h"
+
+using namespace dae;
+
+int main()
+{
+	// Same exponent as the renderer's shininess
+	constexpr float maxExponent{ 25.f };
+	constexpr int glossLevels{ 256 };
+	constexpr int cosineSteps{ 1 << 16 };
+	constexpr float tolerance{ 1.f / 255.f };
+
+	const SpecularLut lut{ maxExponent };
+
+	float maxError{};
+	float maxErrorCosAngle{};
+	float maxErrorGloss{};
+	for (int level{ 0 }; level < glossLevels; ++level)
+	{
+		const float gloss{ static_cast<float>(level) / (glossLevels - 1) };
+		for (int step{ 0 }; step <= cosineSteps; ++step)
+		{
+			const float cosAngle{ static_cast<float>(step) / cosineSteps };
+			const float error{ std::abs(lut.Evaluate(cosAngle, gloss) - std::pow(cosAngle, gloss * maxExponent)) };
+			if (error > maxError)
+			{
+				maxError = error;
+				maxErrorCosAngle = cosAngle;
+				maxErrorGloss = gloss;
+			}
+		}
+	}
+
+	std::cout << "SpecularLut max error " << maxError << " (" << maxError * 255.f << " 8 bit steps) at cos "
+		<< maxErrorCosAngle << ", gloss " << maxErrorGloss << std::endl;
+	return maxError < tolerance ? 0 : 1;
+}
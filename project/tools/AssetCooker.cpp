@@ -0,0 +1,477 @@
+// Offline asset cooker: converts every OBJ and PNG inside a resources folder into the
+// binary formats of AssetFormat.h, so the runtime skips parsing, welding, LOD generation,
+// png decoding and mip generation at launch. Meshes are also written as spatial clusters
+// that the software renderer can page in on demand, and normal maps of rigid meshes are baked
+// to object space for the software renderer (see NormalMapBaker).
+//
+// usage: AssetCooker [resources folder]     (defaults to "resources")
+//
+// resources/cooked/manifest.txt keeps one "<source> <hash>" line per cooked asset. A source is
+// skipped when its content hash did not change since the last run and every file it cooks to is
+// still there and passes the runtime's own source time check.
+
+#include <SDL.h>
+#include <SDL_image.h>
+#include <algorithm>
+#include <chrono>
+#include <execution>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <iterator>
+#include <map>
+#include <sstream>
+#include <unordered_map>
+#include <string>
+#include <vector>
+#include "AssetFormat.h"
+#include "MeshSimplifier.h"
+#include "Utils.h"
+#include "TangentSpace.h"
+#include "NormalMapBaker.h"
+
+#undef main
+
+using namespace dae;
+namespace fs = std::filesystem;
+
+namespace
+{
+	struct CookJob
+	{
+		fs::path source{};
+		fs::path output{};
+		uint64_t hash{};
+
+		bool isUpToDate{ false };
+		bool succeeded{ false };
+		float milliseconds{};
+	};
+
+	// 64 bit FNV-1a over the file content, seeded with the format version so a format change re-cooks everything
+	uint64_t HashFile(const fs::path& path, uint64_t hash = 14695981039346656037ull ^ AssetFormat::Version)
+	{
+		std::ifstream file{ path, std::ios::binary };
+		const std::vector<char> bytes{ std::istreambuf_iterator<char>{ file }, std::istreambuf_iterator<char>{} };
+
+		for (const char byte : bytes)
+		{
+			hash ^= static_cast<uint8_t>(byte);
+			hash *= 1099511628211ull;
+		}
+		return hash;
+	}
+
+	// The object space normal maps are baked from the tangent space ones, editing those has to re-cook the OBJ
+	uint64_t HashNormalMaps(const fs::path& library, uint64_t hash)
+	{
+		std::ifstream file{ library };
+		std::string line{};
+		while (std::getline(file, line))
+		{
+			std::istringstream words{ line };
+			std::string command{};
+			if (words >> command && (command == "map_Bump" || command == "map_bump" || command == "bump" || command == "norm"))
+			{
+				// Same as Utils::ParseOBJ, the file name is the last word
+				std::string map{};
+				for (std::string word{}; words >> word;)
+				{
+					map = word;
+				}
+				hash = HashFile(library.parent_path() / map, hash);
+			}
+		}
+		return hash;
+	}
+
+	// Cooked meshes embed their material texture paths, so an edited MTL file has to re-cook the OBJ as well
+	uint64_t HashMesh(const fs::path& path)
+	{
+		uint64_t hash{ HashFile(path) };
+
+		std::ifstream file{ path };
+		std::string line{};
+		while (std::getline(file, line))
+		{
+			std::istringstream words{ line };
+			std::string command{};
+			if (words >> command && command == "mtllib")
+			{
+				for (std::string library{}; words >> library;)
+				{
+					hash = HashFile(path.parent_path() / library, hash);
+					hash = HashNormalMaps(path.parent_path() / library, hash);
+				}
+			}
+		}
+		return hash;
+	}
+
+	std::map<std::string, uint64_t> ReadManifest(const fs::path& path)
+	{
+		std::map<std::string, uint64_t> manifest{};
+		std::ifstream file{ path };
+
+		std::string name{};
+		uint64_t hash{};
+		while (file >> name >> std::hex >> hash)
+		{
+			manifest[name] = hash;
+		}
+		return manifest;
+	}
+
+	void WriteManifest(const fs::path& path, const std::vector<CookJob>& jobs)
+	{
+		std::ofstream file{ path, std::ios::trunc };
+		for (const CookJob& job : jobs)
+		{
+			if (job.succeeded)
+			{
+				file << job.source.filename().string() << " " << std::hex << job.hash << std::dec << "\n";
+			}
+		}
+	}
+
+	// Recursive median split on triangle centroids until every leaf fits in one cluster
+	void SplitClusters(const MeshAsset& mesh, const MeshLod& lod, uint32_t lodIndex, uint32_t material, std::vector<uint32_t>& triangles, size_t first, size_t last, std::vector<ClusterData>& clusters)
+	{
+		constexpr size_t maxTrianglesPerCluster{ 1024 };
+
+		const auto centroid = [&mesh](uint32_t triangleStart)
+			{
+				return (mesh.vertices[mesh.indices[triangleStart]].position
+					+ mesh.vertices[mesh.indices[triangleStart + 1]].position
+					+ mesh.vertices[mesh.indices[triangleStart + 2]].position) / 3.f;
+			};
+
+		if (last - first > maxTrianglesPerCluster)
+		{
+			BoundingBox centroidBounds{ centroid(triangles[first]), centroid(triangles[first]) };
+			for (size_t triangle{ first }; triangle < last; ++triangle)
+			{
+				centroidBounds.Grow(centroid(triangles[triangle]));
+			}
+
+			const Vector3 size{ centroidBounds.max - centroidBounds.min };
+			const int axis{ size.x >= size.y && size.x >= size.z ? 0 : size.y >= size.z ? 1 : 2 };
+
+			const size_t middle{ first + (last - first) / 2 };
+			std::nth_element(triangles.begin() + first, triangles.begin() + middle, triangles.begin() + last,
+				[&centroid, axis](uint32_t a, uint32_t b) { return centroid(a)[axis] < centroid(b)[axis]; });
+
+			SplitClusters(mesh, lod, lodIndex, material, triangles, first, middle, clusters);
+			SplitClusters(mesh, lod, lodIndex, material, triangles, middle, last, clusters);
+			return;
+		}
+
+		ClusterData cluster{};
+		cluster.info.lod = lodIndex;
+		cluster.info.material = material;
+		cluster.info.geometricError = lod.geometricError;
+
+		std::unordered_map<uint32_t, uint16_t> localIndices{};
+		for (size_t triangle{ first }; triangle < last; ++triangle)
+		{
+			for (uint32_t corner{ 0 }; corner < 3; ++corner)
+			{
+				const uint32_t index{ mesh.indices[triangles[triangle] + corner] };
+				const auto [it, isNew] { localIndices.try_emplace(index, static_cast<uint16_t>(cluster.vertices.size())) };
+				if (isNew)
+				{
+					cluster.vertices.push_back(mesh.vertices[index]);
+				}
+				cluster.indices.push_back(it->second);
+			}
+		}
+
+		cluster.info.bounds = BoundingBox{ cluster.vertices[0].position, cluster.vertices[0].position };
+		for (const Vertex_In& vertex : cluster.vertices)
+		{
+			cluster.info.bounds.Grow(vertex.position);
+		}
+
+		cluster.info.sphere.center = (cluster.info.bounds.min + cluster.info.bounds.max) * 0.5f;
+		for (const Vertex_In& vertex : cluster.vertices)
+		{
+			cluster.info.sphere.radius = std::max(cluster.info.sphere.radius, (vertex.position - cluster.info.sphere.center).Magnitude());
+		}
+
+		clusters.push_back(std::move(cluster));
+	}
+
+	// Box filtered chain down to 1x1, appended behind the top level
+	void BuildMipChain(TextureData& texture)
+	{
+		uint32_t width{ texture.width };
+		uint32_t height{ texture.height };
+		size_t sourceOffset{ 0 };
+
+		while (width > 1 || height > 1)
+		{
+			const uint32_t mipWidth{ std::max(width / 2, 1u) };
+			const uint32_t mipHeight{ std::max(height / 2, 1u) };
+			const size_t mipOffset{ texture.texels.size() };
+			texture.texels.resize(mipOffset + static_cast<size_t>(mipWidth) * mipHeight);
+
+			for (uint32_t y{ 0 }; y < mipHeight; ++y)
+			{
+				for (uint32_t x{ 0 }; x < mipWidth; ++x)
+				{
+					// Odd sizes clamp, the last row/column gets sampled twice
+					const uint32_t x0{ std::min(x * 2, width - 1) }, x1{ std::min(x * 2 + 1, width - 1) };
+					const uint32_t y0{ std::min(y * 2, height - 1) }, y1{ std::min(y * 2 + 1, height - 1) };
+					const uint32_t samples[4]
+					{
+						texture.texels[sourceOffset + y0 * width + x0], texture.texels[sourceOffset + y0 * width + x1],
+						texture.texels[sourceOffset + y1 * width + x0], texture.texels[sourceOffset + y1 * width + x1]
+					};
+
+					uint32_t texel{ 0 };
+					for (uint32_t shift{ 0 }; shift < 32; shift += 8)
+					{
+						uint32_t sum{ 2 };
+						for (const uint32_t sample : samples)
+						{
+							sum += (sample >> shift) & 0xFF;
+						}
+						texel |= (sum / 4) << shift;
+					}
+					texture.texels[mipOffset + static_cast<size_t>(y) * mipWidth + x] = texel;
+				}
+			}
+
+			sourceOffset = mipOffset;
+			width = mipWidth;
+			height = mipHeight;
+			++texture.mipCount;
+		}
+	}
+
+	// Triangles whose normals bake cleanly move to a copy of their material that also has the object space map,
+	// the rest keeps the tangent space one. Vertices shared with the rest are copied, so the material border
+	// stays a seam for the simplifier like any other.
+	bool BakeObjectNormalMaps(const CookJob& job, MeshAsset& mesh, std::vector<uint32_t>& vertexMaterials)
+	{
+		const uint32_t materialCount{ static_cast<uint32_t>(mesh.materials.size()) };
+		for (uint32_t material{ 0 }; material < materialCount; ++material)
+		{
+			TextureData tangentSpaceMap{};
+			if (mesh.materials[material].normalMap.empty() || !AssetFormat::DecodeImage(mesh.materials[material].normalMap, tangentSpaceMap))
+				continue;
+
+			std::vector<uint32_t> triangles{};
+			std::vector<uint32_t> indices{};
+			for (uint32_t index{ 0 }; index + 2 < mesh.indices.size(); index += 3)
+			{
+				if (vertexMaterials[mesh.indices[index]] == material)
+				{
+					triangles.push_back(index);
+					indices.insert(indices.end(), mesh.indices.begin() + index, mesh.indices.begin() + index + 3);
+				}
+			}
+
+			TextureData objectSpaceMap{};
+			std::vector<bool> isBaked{};
+			NormalMapBaker::Stats stats{};
+			if (!NormalMapBaker::BakeObjectSpace(mesh.vertices, indices, tangentSpaceMap, objectSpaceMap, isBaked, stats))
+				continue;
+
+			MaterialDesc bakedMaterial{ mesh.materials[material] };
+			bakedMaterial.name += " (object space)";
+			bakedMaterial.objectNormalMap = AssetFormat::GetObjectNormalMapPath(job.source.string(), mesh.materials[material].name);
+
+			BuildMipChain(objectSpaceMap);
+			// No source file of its own, it is re-cooked together with its mesh
+			if (!AssetFormat::WriteTexture(AssetFormat::GetCookedPath(bakedMaterial.objectNormalMap), 0, objectSpaceMap))
+				return false;
+
+			const uint32_t bakedIndex{ static_cast<uint32_t>(mesh.materials.size()) };
+			mesh.materials.push_back(std::move(bakedMaterial));
+
+			// Vertices only used by baked triangles just change material
+			std::unordered_map<uint32_t, uint32_t> unbakedUses{};
+			for (size_t triangle{ 0 }; triangle < triangles.size(); ++triangle)
+			{
+				for (uint32_t corner{ 0 }; corner < 3 && !isBaked[triangle]; ++corner)
+				{
+					++unbakedUses[mesh.indices[triangles[triangle] + corner]];
+				}
+			}
+
+			std::unordered_map<uint32_t, uint32_t> copies{};
+			for (size_t triangle{ 0 }; triangle < triangles.size(); ++triangle)
+			{
+				if (!isBaked[triangle]) continue;
+
+				for (uint32_t corner{ 0 }; corner < 3; ++corner)
+				{
+					uint32_t& index{ mesh.indices[triangles[triangle] + corner] };
+					if (!unbakedUses.contains(index))
+					{
+						vertexMaterials[index] = bakedIndex;
+						continue;
+					}
+
+					const auto [it, isNew] { copies.try_emplace(index, static_cast<uint32_t>(mesh.vertices.size())) };
+					if (isNew)
+					{
+						const Vertex_In vertex{ mesh.vertices[index] };
+						mesh.vertices.push_back(vertex);
+						vertexMaterials.push_back(bakedIndex);
+					}
+					index = it->second;
+				}
+			}
+		}
+		return true;
+	}
+
+	// A touched or checked out source keeps its hash but gets a new write time, the runtime would reject its cook
+	bool IsCookCurrent(const CookJob& job)
+	{
+		const uint64_t sourceTime{ AssetFormat::GetSourceTime(job.source.string()) };
+		if (job.source.extension() != ".obj")
+			return AssetFormat::IsCurrent(job.output.string(), sourceTime);
+
+		// The cooked mesh names the object space normal maps baked for it
+		MeshAsset mesh{};
+		if (!AssetFormat::ReadMesh(job.output.string(), sourceTime, mesh)
+			|| !AssetFormat::IsCurrent(AssetFormat::GetClusteredPath(job.source.string()), sourceTime))
+			return false;
+
+		return std::all_of(mesh.materials.begin(), mesh.materials.end(), [](const MaterialDesc& material)
+			{
+				return material.objectNormalMap.empty() || AssetFormat::IsCurrent(AssetFormat::GetCookedPath(material.objectNormalMap), 0);
+			});
+	}
+
+	bool CookMesh(const CookJob& job)
+	{
+		// Taken before parsing, an edit during the cook leaves the output stale rather than looking current
+		const uint64_t sourceTime{ AssetFormat::GetSourceTime(job.source.string()) };
+		MeshAsset mesh{};
+		std::vector<uint32_t> vertexMaterials{};
+		if (!Utils::ParseOBJ(job.source.string(), mesh.vertices, mesh.indices, vertexMaterials, mesh.materials))
+			return false;
+
+		MeshSimplifier::WeldVertices(mesh.vertices, mesh.indices, vertexMaterials);
+		for (const uint32_t source : TangentSpace::Generate(mesh.vertices, mesh.indices))
+		{
+			vertexMaterials.push_back(vertexMaterials[source]);
+		}
+		if (!BakeObjectNormalMaps(job, mesh, vertexMaterials))
+			return false;
+		mesh.lods = MeshSimplifier::BuildLods(mesh.vertices, mesh.indices);
+		mesh.subMeshes = MeshSimplifier::SortByMaterial(vertexMaterials, static_cast<uint32_t>(mesh.materials.size()), mesh.indices, mesh.lods);
+
+		// Same data again, chunked for out-of-core rendering (see ClusteredMesh), a cluster never mixes materials
+		std::vector<ClusterData> clusters{};
+		for (const SubMesh& subMesh : mesh.subMeshes)
+		{
+			for (uint32_t lodIndex{ 0 }; lodIndex < subMesh.lods.size(); ++lodIndex)
+			{
+				const MeshLod& lod{ subMesh.lods[lodIndex] };
+
+				std::vector<uint32_t> triangles{};
+				for (uint32_t index{ lod.startIndex }; index + 2 < lod.startIndex + lod.indexCount; index += 3)
+				{
+					triangles.push_back(index);
+				}
+
+				if (!triangles.empty())
+				{
+					SplitClusters(mesh, lod, lodIndex, subMesh.material, triangles, 0, triangles.size(), clusters);
+				}
+			}
+		}
+
+		return AssetFormat::WriteMesh(job.output.string(), sourceTime, mesh)
+			&& AssetFormat::WriteClusters(AssetFormat::GetClusteredPath(job.source.string()), sourceTime, clusters);
+	}
+
+	bool CookTexture(const CookJob& job)
+	{
+		const uint64_t sourceTime{ AssetFormat::GetSourceTime(job.source.string()) };
+		TextureData texture{};
+		if (!AssetFormat::DecodeImage(job.source.string(), texture))
+			return false;
+
+		BuildMipChain(texture);
+
+		return AssetFormat::WriteTexture(job.output.string(), sourceTime, texture);
+	}
+}
+
+int main(int argc, char* args[])
+{
+	const fs::path resources{ argc > 1 ? args[1] : "resources" };
+	const fs::path cooked{ resources / "cooked" };
+	const fs::path manifestPath{ cooked / "manifest.txt" };
+
+	if (!fs::is_directory(resources))
+	{
+		std::cout << "Resources folder " << resources << " not found" << std::endl;
+		return 1;
+	}
+
+	fs::create_directories(cooked);
+	IMG_Init(IMG_INIT_PNG);
+
+	std::vector<CookJob> jobs{};
+	for (const fs::directory_entry& entry : fs::directory_iterator{ resources })
+	{
+		const fs::path extension{ entry.path().extension() };
+		if (entry.is_regular_file() && (extension == ".obj" || extension == ".png"))
+		{
+			CookJob job{};
+			job.source = entry.path();
+			job.output = AssetFormat::GetCookedPath(entry.path().string());
+			jobs.push_back(job);
+		}
+	}
+
+	const std::map<std::string, uint64_t> manifest{ ReadManifest(manifestPath) };
+	const auto start{ std::chrono::steady_clock::now() };
+
+	// Every job only touches its own entry, no locking needed
+	std::for_each(std::execution::par, jobs.begin(), jobs.end(), [&manifest](CookJob& job)
+		{
+			const auto jobStart{ std::chrono::steady_clock::now() };
+			job.hash = job.source.extension() == ".obj" ? HashMesh(job.source) : HashFile(job.source);
+
+			const auto cookedEntry{ manifest.find(job.source.filename().string()) };
+			job.isUpToDate = cookedEntry != manifest.end() && cookedEntry->second == job.hash && IsCookCurrent(job);
+
+			if (job.isUpToDate)
+			{
+				job.succeeded = true;
+			}
+			else
+			{
+				job.succeeded = job.source.extension() == ".obj" ? CookMesh(job) : CookTexture(job);
+			}
+
+			job.milliseconds = std::chrono::duration<float, std::milli>(std::chrono::steady_clock::now() - jobStart).count();
+		});
+
+	WriteManifest(manifestPath, jobs);
+
+	int cookedCount{ 0 };
+	int failedCount{ 0 };
+	for (const CookJob& job : jobs)
+	{
+		const char* status{ job.isUpToDate ? "up to date" : job.succeeded ? "cooked" : "FAILED" };
+		std::cout << "  " << job.source.filename().string() << ": " << status << " (" << job.milliseconds << " ms)" << std::endl;
+
+		cookedCount += !job.isUpToDate && job.succeeded;
+		failedCount += !job.succeeded;
+	}
+
+	const float totalMs{ std::chrono::duration<float, std::milli>(std::chrono::steady_clock::now() - start).count() };
+	std::cout << cookedCount << " cooked, " << static_cast<int>(jobs.size()) - cookedCount - failedCount << " up to date, " << failedCount << " failed in " << totalMs << " ms" << std::endl;
+
+	IMG_Quit();
+	return failedCount == 0 ? 0 : 1;
+}